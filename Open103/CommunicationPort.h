@@ -14,6 +14,10 @@ class CommunicationPort {
   virtual int Read(unsigned char* thePacket, int maxlen) = 0;
   virtual int Write(unsigned char* thePacket, int len) = 0;
 
+  /*Limits how long next Read calls may block, in milliseconds. Read must return 0 on expiry.
+  Ports that cannot time out return false and keep blocking.*/
+  virtual bool SetReadTimeout(unsigned int /*Milliseconds*/) { return false; }
+
  protected:
  private:
   string _name;
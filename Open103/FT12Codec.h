@@ -0,0 +1,91 @@
+#ifndef FT12CODEC_H
+#define FT12CODEC_H
+#pragma once
+
+#include <string.h>
+
+#include "IFT12.h"
+
+/*
+Value type FT1.2 frame used by the link layer.
+
+Unlike IFT12 objects it has no virtual functions and owns no memory: user data is a pointer to the caller's buffer (on
+send) or to the deframer buffer (on receive). A frame with user data is encoded with variable length, one without is
+encoded with fixed length.
+*/
+typedef struct FT12Frame_ {
+  FT12Frame_() : Control(0), Address(0), UserData(0), UserDataSize(0) {}
+
+  FT12Frame_(const unsigned char Ctrl, const unsigned char Addr, const void *pData = 0, const size_t Size = 0)
+      : Control(Ctrl), Address(Addr), UserData(static_cast<const unsigned char *>(pData)), UserDataSize(Size) {}
+
+  static const unsigned char FixedStart = 0x10;    /*Fixed field from 870-5-1*/
+  static const unsigned char VariableStart = 0x68; /*Fixed field from 870-5-1*/
+  static const unsigned char End = 0x16;           /*Fixed field from 870-5-1*/
+  static const size_t FixedFrameSize = 5;
+  static const size_t VariableHeaderSize = 8; /*Start, L, L, Start, C, A, CS, End*/
+  static const size_t MaxUserDataSize = 253;  /*L (control, address and user data) is one octet*/
+
+  inline bool IsVariable() const { return UserData != 0; }
+
+  /*Computes the encoded frame size*/
+  inline size_t FrameSize() const { return IsVariable() ? VariableHeaderSize + UserDataSize : FixedFrameSize; }
+
+  /*Gets user data pointer for current frame*/
+  inline void GetUserData(const void **pData, size_t *pSize) const {
+    *pData = UserData;
+    *pSize = UserDataSize;
+  }
+
+  /*User data fits in one frame*/
+  inline bool IsValid() const { return UserDataSize <= MaxUserDataSize; }
+
+  /*Writes the raw frame into p, that must hold FrameSize() bytes. Returns written bytes, 0 if the frame is not valid*/
+  inline size_t Encode(unsigned char *p) const {
+    if (!IsValid()) return 0;
+
+    unsigned char *start = p;
+
+    if (IsVariable()) {
+      p[0] = p[3] = VariableStart;
+      p[1] = p[2] = static_cast<unsigned char>(2 + UserDataSize);
+      p += 3;
+    }
+
+    p[0] = IsVariable() ? VariableStart : FixedStart;
+    p[1] = Control;
+    p[2] = Address;
+    p += 3;
+
+    if (UserDataSize > 0) {
+      memcpy(p, UserData, UserDataSize);
+      p += UserDataSize;
+    }
+
+    p[0] = Checksum(Control, Address, UserData, UserDataSize);
+    p[1] = End;
+
+    return static_cast<size_t>(p + 2 - start);
+  }
+
+  /*Builds a view over an already validated fixed frame*/
+  inline static FT12Frame_ FromFixed(const unsigned char *p) { return FT12Frame_(p[1], p[2]); }
+
+  /*Builds a view over an already validated variable frame*/
+  inline static FT12Frame_ FromVariable(const unsigned char *p) { return FT12Frame_(p[4], p[5], p + 6, p[1] - 2); }
+
+  inline static unsigned char Checksum(unsigned char Control, unsigned char Address, const unsigned char *pData,
+                                       size_t Size) {
+    unsigned char result = Control + Address;
+    for (size_t i = 0; i < Size; i++) result += pData[i];
+    return result;
+  }
+
+  unsigned char Control;
+  unsigned char Address;
+  const unsigned char *UserData;
+  size_t UserDataSize;
+
+} FT12Frame; /*FT1.2 frame from IEC-870-5-1, value type*/
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef FT12DEFRAMER_H
+#define FT12DEFRAMER_H
+#pragma once
+
+#include <string.h>
+
+#include "FT12Codec.h"
+
+/*
+Incremental FT1.2 deframer.
+
+A CommunicationPort read is not guaranteed to return exactly one frame: gateways and serial drivers may split a frame
+across several reads or glue more frames together. Bytes coming from the port are appended to an internal buffer and
+Next() extracts complete and valid frames one by one:
+
+  0x10 C A CS 0x16                 fixed length frame
+  0x68 L L 0x68 C A ... CS 0x16    variable length frame (L = C + A + user data)
+  0xE5                             single control character
+
+Anything that is not a valid frame is dropped one byte at a time until a new start character is found, so the
+deframer resynchronizes by itself after line noise.
+
+Frames are returned as pointers inside the internal buffer (no copy). They stay valid until the next call to
+WritePointer(), Feed() or Reset().
+*/
+typedef class FT12Deframer_ {
+ public:
+  typedef enum FrameKind_ { NoFrame = 0, FixedFrame, VariableFrame, SingleCharFrame } FrameKind;
+
+  static const unsigned char VariableStart = 0x68; /*Fixed field from 870-5-1*/
+  static const unsigned char SingleChar = 0xE5;    /*Single control character from 870-5-1*/
+  static const size_t FixedFrameSize = 5;
+  static const size_t VariableHeaderSize = 6; /*Start, L, L, Start, CS, End*/
+  static const size_t MaxFrameSize = 255 + VariableHeaderSize;
+  static const size_t BufferSize = 4 * MaxFrameSize;
+
+  FT12Deframer_() : head(0), tail(0), discarded(0) {}
+
+  /*Returns the free area where next port read can be stored. Must be followed by Commit()*/
+  unsigned char *WritePointer(size_t *pFree) {
+    if (head == tail) head = tail = 0;
+
+    /* Pending bytes are always less than a frame once Next() returned NoFrame, so moving them is cheap. */
+    if (BufferSize - tail < MaxFrameSize && head > 0) {
+      memmove(buffer, buffer + head, tail - head);
+      tail -= head;
+      head = 0;
+    }
+
+    *pFree = BufferSize - tail;
+    return buffer + tail;
+  }
+
+  /*Confirms that Size bytes have been written at WritePointer()*/
+  void Commit(size_t Size) { tail += Size; }
+
+  /*Appends raw bytes to the buffer. Returns how many bytes have been accepted*/
+  size_t Feed(const void *pData, size_t Size) {
+    size_t free = 0;
+    unsigned char *p = WritePointer(&free);
+    if (Size > free) Size = free;
+
+    memcpy(p, pData, Size);
+    Commit(Size);
+    return Size;
+  }
+
+  /*Extracts next complete frame. pFrame and pSize are valid only if return value is not NoFrame*/
+  FrameKind Next(const unsigned char **pFrame, size_t *pSize) {
+    while (head < tail) {
+      const unsigned char *p = buffer + head;
+      const size_t available = tail - head;
+      size_t size = 0;
+      FrameKind kind = NoFrame;
+
+      switch (p[0]) {
+        case FT12Frame::FixedStart:
+          if (available < FixedFrameSize) return NoFrame;
+          if (static_cast<unsigned char>(p[1] + p[2]) == p[3] && p[4] == FT12Frame::End) {
+            kind = FixedFrame;
+            size = FixedFrameSize;
+          }
+          break;
+
+        case VariableStart:
+          if (available < 4) return NoFrame;
+          if (p[1] == p[2] && p[1] >= 2 && p[3] == VariableStart) {
+            size = p[1] + VariableHeaderSize;
+            if (available < size) return NoFrame;
+            if (ComputeChecksum(p + 4, p[1]) == p[size - 2] && p[size - 1] == FT12Frame::End) kind = VariableFrame;
+          }
+          break;
+
+        case SingleChar:
+          kind = SingleCharFrame;
+          size = 1;
+          break;
+
+        default:
+          break;
+      }
+
+      if (kind != NoFrame) {
+        *pFrame = p;
+        *pSize = size;
+        head += size;
+        return kind;
+      }
+
+      /* Not a valid frame: drop bytes until next candidate start character. */
+      head++;
+      discarded++;
+      while (head < tail && !IsStartCharacter(buffer[head])) {
+        head++;
+        discarded++;
+      }
+    }
+
+    return NoFrame;
+  }
+
+  /*Extracts next complete frame as a value type view. E5 is reported with an empty frame*/
+  FrameKind Next(FT12Frame *frame) {
+    const unsigned char *p = 0;
+    size_t size = 0;
+    FrameKind kind = Next(&p, &size);
+
+    if (kind == FixedFrame)
+      *frame = FT12Frame::FromFixed(p);
+    else if (kind == VariableFrame)
+      *frame = FT12Frame::FromVariable(p);
+    else
+      *frame = FT12Frame();
+
+    return kind;
+  }
+
+  /*Drops any pending byte*/
+  void Reset() { head = tail = 0; }
+
+  /*Bytes that are still waiting for a complete frame*/
+  size_t Pending() const { return tail - head; }
+
+  /*Bytes thrown away during resynchronization, since construction*/
+  size_t DiscardedBytes() const { return discarded; }
+
+ private:
+  inline static bool IsStartCharacter(unsigned char c) {
+    return c == FT12Frame::FixedStart || c == VariableStart || c == SingleChar;
+  }
+
+  inline static unsigned char ComputeChecksum(const unsigned char *p, size_t Size) {
+    unsigned char result = 0;
+    for (size_t i = 0; i < Size; i++) result += p[i];
+    return result;
+  }
+
+  unsigned char buffer[BufferSize];
+  size_t head;
+  size_t tail;
+  size_t discarded;
+
+} FT12Deframer; /*Streaming FT1.2 frame extractor*/
+
+#endif
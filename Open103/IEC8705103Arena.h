@@ -0,0 +1,96 @@
+#ifndef IEC8705103ARENA_H
+#define IEC8705103ARENA_H
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+/*
+Bump allocator for data whose size is only known while it arrives (e.g. a disturbance record).
+
+Memory comes from blocks of BlockSize bytes (or larger for a single bigger request), is zeroed and 8 byte aligned.
+Nothing is freed one by one: Reset() makes every block available again for the next record, keeping them, while
+Release() returns them to the system.
+*/
+typedef class IEC8705103Arena_ {
+ public:
+  IEC8705103Arena_(size_t BlockSize = 64 * 1024) : blockSize(BlockSize), current(0), offset(0), used(0) {}
+
+  ~IEC8705103Arena_() { Release(); }
+
+  /*Size zeroed bytes, 0 if out of memory*/
+  void *Allocate(size_t Size) {
+    Size = (Size + 7) & ~static_cast<size_t>(7);
+
+    while (current < blocks.size() && offset + Size > blocks[current].Size) {
+      current++;
+      offset = 0;
+    }
+
+    if (current == blocks.size()) {
+      Block b;
+      b.Size = Size > blockSize ? Size : blockSize;
+      b.p = static_cast<unsigned char *>(malloc(b.Size));
+      if (b.p == 0) return 0;
+      blocks.push_back(b);
+      offset = 0;
+    }
+
+    unsigned char *p = blocks[current].p + offset;
+    offset += Size;
+    used += Size;
+    memset(p, 0, Size);
+    return p;
+  }
+
+  template <typename T>
+  T *Allocate(size_t Count) {
+    return static_cast<T *>(Allocate(Count * sizeof(T)));
+  }
+
+  /*Everything allocated so far is dropped, the blocks are kept for reuse*/
+  void Reset() {
+    current = 0;
+    offset = 0;
+    used = 0;
+  }
+
+  /*Everything allocated so far is dropped and the blocks freed*/
+  void Release() {
+    for (size_t i = 0; i < blocks.size(); i++) free(blocks[i].p);
+    blocks.clear();
+    std::vector<Block>().swap(blocks);
+    Reset();
+  }
+
+  /*Bytes handed out since the last Reset*/
+  size_t GetUsed() const { return used; }
+
+  /*Bytes held in blocks*/
+  size_t GetReserved() const {
+    size_t reserved = 0;
+    for (size_t i = 0; i < blocks.size(); i++) reserved += blocks[i].Size;
+    return reserved;
+  }
+
+ private:
+  typedef struct Block_ {
+    unsigned char *p;
+    size_t Size;
+  } Block;
+
+  // I won't let you copy this object.
+  IEC8705103Arena_(const IEC8705103Arena_ &);
+  IEC8705103Arena_ &operator=(const IEC8705103Arena_ &);
+
+  const size_t blockSize;
+  std::vector<Block> blocks;
+  size_t current; /*Block allocations come from*/
+  size_t offset;  /*In that block*/
+  size_t used;
+
+} IEC8705103Arena; /*Reusable bump allocator*/
+
+#endif
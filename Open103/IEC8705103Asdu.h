@@ -0,0 +1,391 @@
+#ifndef IEC8705103ASDU_H
+#define IEC8705103ASDU_H
+#pragma once
+
+#include <string.h>
+
+/*
+Zero-copy views over received 103 ASDUs.
+
+A view only keeps a pointer to the received bytes and their length: nothing is copied, and fields are read in place
+(little endian, any alignment) when asked. Each typed view checks in Bind() that the ASDU has the expected type and
+that every field it exposes, repeated elements included, lies inside the ASDU. After a successful Bind() accessors
+need no further checks; a failed Bind() means the ASDU is malformed or of another type.
+The buffer must stay valid while the view is used.
+*/
+typedef class ASDUView_ {
+ public:
+  static const size_t HeaderSize = 6;  /*TYP, VSQ, COT, COMMON ADDRESS, FUN, INF*/
+  static const size_t MaxSize = 253;   /*Longest FT1.2 user data after control and address fields*/
+  static const size_t Cp56Size = 7;    /*CP56Time2a*/
+  static const size_t Cp32Size = 4;    /*CP32Time2a*/
+
+  ASDUView_() : p(0), size(0) {}
+  ASDUView_(const void *pAsdu, size_t Size) : p(static_cast<const unsigned char *>(pAsdu)), size(Size) {}
+
+  /*At least a complete data unit identifier and information object identifier*/
+  bool IsValid() const { return p != 0 && size >= HeaderSize; }
+
+  /*Same interface as the typed views: an ASDU of any type with a complete header*/
+  bool Bind(const ASDUView_ &Asdu) {
+    *this = Asdu;
+    return IsValid();
+  }
+
+  const unsigned char *Data() const { return p; }
+  size_t Size() const { return size; }
+
+  /*Header fields. They read 0 if the view is not valid*/
+  unsigned char TypeIdentification() const { return Header(0); }
+  unsigned char VariableStructureIdentifier() const { return Header(1); }
+  unsigned char Count() const { return Header(1) & 0x7F; }     /*Number of information elements*/
+  bool Sequence() const { return (Header(1) & 0x80) != 0; }    /*SQ bit*/
+  unsigned char CauseOfTransmission() const { return Header(2); }
+  unsigned char CommonAddress() const { return Header(3); }
+  unsigned char FunctionType() const { return Header(4); }
+  unsigned char InformationNumber() const { return Header(5); }
+
+  /*True if Size bytes starting at Offset are inside the ASDU*/
+  bool Has(size_t Offset, size_t Size) const { return p != 0 && Offset <= size && Size <= size - Offset; }
+
+  /*Unchecked little endian readers, for offsets validated with Has()*/
+  unsigned char U8(size_t Offset) const { return p[Offset]; }
+  unsigned short U16(size_t Offset) const {
+    return static_cast<unsigned short>(p[Offset] | (static_cast<unsigned short>(p[Offset + 1]) << 8));
+  }
+  unsigned int U32(size_t Offset) const {
+    return static_cast<unsigned int>(p[Offset]) | (static_cast<unsigned int>(p[Offset + 1]) << 8) |
+           (static_cast<unsigned int>(p[Offset + 2]) << 16) | (static_cast<unsigned int>(p[Offset + 3]) << 24);
+  }
+  float R32(size_t Offset) const {
+    float value;
+    memcpy(&value, p + Offset, sizeof(value)); /* IEEE 754 short real, little endian as the host */
+    return value;
+  }
+  const unsigned char *At(size_t Offset) const { return p + Offset; }
+
+  /*Checks type and length: Length bytes after the header are required*/
+  bool Is(unsigned char Type, size_t Length) const {
+    return IsValid() && p[0] == Type && Has(HeaderSize, Length);
+  }
+
+ private:
+  unsigned char Header(size_t Offset) const { return IsValid() ? p[Offset] : 0; }
+
+  const unsigned char *p;
+  size_t size;
+
+} ASDUView; /*Received ASDU and its header*/
+
+/*ASDU 1 (time-tagged message) and ASDU 2 (time-tagged message with relative time)*/
+typedef class TimeTaggedMessageView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    relative = a.TypeIdentification() == 2;
+    return a.Is(1, 6) || a.Is(2, 10);
+  }
+
+  unsigned char DPI() const { return a.U8(6) & 0x3; } /*1 OFF, 2 ON*/
+  unsigned short RelativeTime() const { return relative ? a.U16(7) : 0; }
+  unsigned short FaultNumber() const { return relative ? a.U16(9) : 0; }
+  const unsigned char *Time() const { return a.At(relative ? 11 : 7); } /*CP32Time2a*/
+  unsigned char SupplementaryInformation() const { return a.U8(relative ? 15 : 11); }
+
+ private:
+  ASDUView a;
+  bool relative;
+} TimeTaggedMessageView;
+
+/*ASDU 3 (measurands I) and ASDU 9 (measurands II): Count() values of 16 bits*/
+typedef class MeasurandsView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return (a.TypeIdentification() == 3 || a.TypeIdentification() == 9) && a.Is(a.TypeIdentification(), 2 * Count());
+  }
+
+  unsigned char Count() const { return a.Count(); }
+  const unsigned char *Values() const { return a.At(6); } /*Count() little endian 16 bit words*/
+  unsigned short Raw(unsigned char i) const { return a.U16(6 + 2 * i); }
+  short Value(unsigned char i) const { return static_cast<short>(Raw(i)) >> 3; } /*13 bit signed value*/
+  bool Overflow(unsigned char i) const { return (Raw(i) & 0x1) != 0; }
+  bool Error(unsigned char i) const { return (Raw(i) & 0x2) != 0; }
+
+ private:
+  ASDUView a;
+} MeasurandsView;
+
+/*ASDU 4: time-tagged measurand with relative time*/
+typedef class TimeTaggedMeasurandView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(4, 12);
+  }
+
+  float ShortCircuitLocation() const { return a.R32(6); }
+  unsigned short RelativeTime() const { return a.U16(10); }
+  unsigned short FaultNumber() const { return a.U16(12); }
+  const unsigned char *Time() const { return a.At(14); } /*CP32Time2a*/
+
+ private:
+  ASDUView a;
+} TimeTaggedMeasurandView;
+
+/*ASDU 5: identification*/
+typedef class IdentificationView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(5, 13);
+  }
+
+  unsigned char CompatibilityLevel() const { return a.U8(6); } /*2 without generic services, 3 with*/
+  const char *Text() const { return reinterpret_cast<const char *>(a.At(7)); } /*8 ASCII characters, no terminator*/
+  unsigned int Manufacturer() const { return a.U32(15); }
+
+ private:
+  ASDUView a;
+} IdentificationView;
+
+/*ASDU 6: time synchronization*/
+typedef class TimeSyncView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(6, ASDUView::Cp56Size);
+  }
+
+  const unsigned char *Time() const { return a.At(6); } /*CP56Time2a*/
+
+ private:
+  ASDUView a;
+} TimeSyncView;
+
+/*ASDU 7 (general interrogation) and ASDU 8 (termination of general interrogation)*/
+typedef class ScanView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(7, 1) || a.Is(8, 1);
+  }
+
+  unsigned char ScanNumber() const { return a.U8(6); }
+
+ private:
+  ASDUView a;
+} ScanView;
+
+/*One data set of ASDU 10 or one descriptive element of ASDU 11*/
+typedef struct GenericElement_ {
+  unsigned char Group;     /*GIN, absent (0) in ASDU 11 elements*/
+  unsigned char Entry;
+  unsigned char KindOfDescription;
+  unsigned char DataType;  /*GDD*/
+  unsigned char DataSize;
+  unsigned char Number;
+  bool More;               /*Continuation bit of GDD*/
+  const unsigned char *Data; /*DataSize * Number octets*/
+  size_t Size;
+} GenericElement;
+
+/*ASDU 10 (generic data) and ASDU 11 (generic identification). Elements are walked with Next()*/
+typedef class GenericDataView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    identification = a.TypeIdentification() == 11;
+    cursor = identification ? 10 : 8;
+    left = 0;
+    if (!(identification ? a.Is(11, 4) : a.Is(10, 2))) return false;
+
+    left = Count();
+    return true;
+  }
+
+  unsigned char ReturnInformationIdentifier() const { return a.U8(6); }
+  /*ASDU 11 only: the entry all descriptions refer to*/
+  unsigned char Group() const { return identification ? a.U8(7) : 0; }
+  unsigned char Entry() const { return identification ? a.U8(8) : 0; }
+  unsigned char Count() const { return a.U8(identification ? 9 : 7) & 0x3F; } /*NGD / NDE*/
+  bool More() const { return (a.U8(identification ? 9 : 7) & 0x80) != 0; }
+
+  /*Next element. Returns false at the end or if the element does not fit in the ASDU*/
+  bool Next(GenericElement *e) {
+    if (left == 0) return false;
+
+    size_t head = identification ? 4 : 6; /* [GIN] KOD GDD */
+    if (!a.Has(cursor, head)) return Stop();
+
+    size_t k = cursor;
+    e->Group = identification ? 0 : a.U8(k++);
+    e->Entry = identification ? 0 : a.U8(k++);
+    e->KindOfDescription = a.U8(k++);
+    e->DataType = a.U8(k++);
+    e->DataSize = a.U8(k++);
+    e->Number = a.U8(k) & 0x7F;
+    e->More = (a.U8(k++) & 0x80) != 0;
+    e->Size = static_cast<size_t>(e->DataSize) * e->Number;
+    if (!a.Has(k, e->Size)) return Stop();
+
+    e->Data = a.At(k);
+    cursor = k + e->Size;
+    left--;
+    return true;
+  }
+
+ private:
+  bool Stop() {
+    left = 0;
+    return false;
+  }
+
+  ASDUView a;
+  bool identification;
+  size_t cursor;
+  unsigned char left;
+} GenericDataView;
+
+/*ASDU 23: list of recorded disturbances, Count() entries*/
+typedef class DisturbanceListView_ {
+ public:
+  static const size_t EntrySize = 3 + ASDUView::Cp56Size;
+
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(23, EntrySize * Count());
+  }
+
+  unsigned char Count() const { return a.Count(); }
+  unsigned short FaultNumber(unsigned char i) const { return a.U16(6 + EntrySize * i); }
+  unsigned char FaultStatus(unsigned char i) const { return a.U8(8 + EntrySize * i); } /*SOF*/
+  const unsigned char *Time(unsigned char i) const { return a.At(9 + EntrySize * i); } /*CP56Time2a*/
+
+ private:
+  ASDUView a;
+} DisturbanceListView;
+
+/*ASDU 26: ready for transmission of disturbance data*/
+typedef class DisturbanceReadyView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(26, 11 + ASDUView::Cp32Size);
+  }
+
+  unsigned char TypeOfValues() const { return a.U8(7); } /*TOV*/
+  unsigned short FaultNumber() const { return a.U16(8); }
+  unsigned short NetworkFault() const { return a.U16(10); } /*NOF*/
+  unsigned char Channels() const { return a.U8(12); }     /*NOC*/
+  unsigned short Elements() const { return a.U16(13); }  /*NOE*/
+  unsigned short Interval() const { return a.U16(15); }  /*INT, microseconds*/
+  const unsigned char *Time() const { return a.At(17); } /*CP32Time2a of first recording*/
+
+ private:
+  ASDUView a;
+} DisturbanceReadyView;
+
+/*ASDU 27: ready for transmission of a channel*/
+typedef class ChannelReadyView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(27, 17);
+  }
+
+  unsigned char TypeOfValues() const { return a.U8(7); }
+  unsigned short FaultNumber() const { return a.U16(8); }
+  unsigned char Channel() const { return a.U8(10); } /*ACC*/
+  float PrimaryRated() const { return a.R32(11); }   /*RPV*/
+  float SecondaryRated() const { return a.R32(15); } /*RSV*/
+  float ReferenceFactor() const { return a.R32(19); } /*RFA*/
+
+ private:
+  ASDUView a;
+} ChannelReadyView;
+
+/*ASDU 28: ready for transmission of tags*/
+typedef class TagsReadyView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(28, 4);
+  }
+
+  unsigned short FaultNumber() const { return a.U16(8); }
+
+ private:
+  ASDUView a;
+} TagsReadyView;
+
+/*ASDU 29: transmission of tags, Count() (FUN, INF, DPI) changes at TagPosition*/
+typedef class TagsView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(29, 5) && a.Has(11, 3 * static_cast<size_t>(Count()));
+  }
+
+  unsigned short FaultNumber() const { return a.U16(6); }
+  unsigned char Count() const { return a.U8(8); } /*NOT*/
+  unsigned short TagPosition() const { return a.U16(9); } /*TAP*/
+  unsigned char FunctionType(unsigned char i) const { return a.U8(11 + 3 * i); }
+  unsigned char InformationNumber(unsigned char i) const { return a.U8(12 + 3 * i); }
+  unsigned char DPI(unsigned char i) const { return a.U8(13 + 3 * i); }
+
+ private:
+  ASDUView a;
+} TagsView;
+
+/*ASDU 30: transmission of disturbance values, Count() samples from FirstElement*/
+typedef class DisturbanceValuesView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(30, 8) && a.Has(14, 2 * static_cast<size_t>(Count()));
+  }
+
+  unsigned char TypeOfValues() const { return a.U8(7); }
+  unsigned short FaultNumber() const { return a.U16(8); }
+  unsigned char Channel() const { return a.U8(10); } /*ACC*/
+  unsigned char Count() const { return a.U8(11); } /*NDV*/
+  unsigned short FirstElement() const { return a.U16(12); } /*NFE*/
+  short Value(unsigned char i) const { return static_cast<short>(a.U16(14 + 2 * i)); } /*SDV*/
+
+ private:
+  ASDUView a;
+} DisturbanceValuesView;
+
+/*ASDU 31: end of transmission*/
+typedef class TransmissionEndView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(31, 5);
+  }
+
+  unsigned char TypeOfOrder() const { return a.U8(6); } /*TOO*/
+  unsigned char TypeOfValues() const { return a.U8(7); }
+  unsigned short FaultNumber() const { return a.U16(8); }
+  unsigned char Channel() const { return a.U8(10); }
+
+ private:
+  ASDUView a;
+} TransmissionEndView;
+
+/*ASDU 205 (private range): energy counter, INF tells which one*/
+typedef class EnergyCounterView_ {
+ public:
+  bool Bind(const ASDUView &Asdu) {
+    a = Asdu;
+    return a.Is(205, 4);
+  }
+
+  unsigned int Value() const { return a.U32(6); }
+
+ private:
+  ASDUView a;
+} EnergyCounterView;
+
+#endif  // IEC8705103ASDU_H
@@ -0,0 +1,468 @@
+#ifndef IEC8705103ASYNC_H
+#define IEC8705103ASYNC_H
+#pragma once
+
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+
+#include <time.h>
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include "IEC87052EventDriver.h"
+#include "IEC8705103Manager.h"
+
+/*
+Result of an asynchronous 103 workflow (C++20 coroutine).
+
+The workflow starts as soon as it is called and runs until its first wait; it then continues on the driver thread that
+owns the line. A task can be awaited by another workflow, or checked with Done()/Result(). Destroying an unfinished task
+detaches it: the workflow goes on and frees itself at the end.
+*/
+class IEC8705103Task {
+ public:
+  struct promise_type {
+    promise_type() : result(false), continuation(0) {}
+
+    IEC8705103Task get_return_object() {
+      return IEC8705103Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+        void *previous = h.promise().continuation.exchange(DoneMark());
+        if (previous == DetachedMark()) {
+          h.destroy();
+          return std::noop_coroutine();
+        }
+        if (previous == 0) return std::noop_coroutine(); /* Owner will read result and destroy */
+        return std::coroutine_handle<>::from_address(previous);
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return FinalAwaiter(); }
+
+    void return_value(bool value) { result = value; }
+    void unhandled_exception() { std::terminate(); }
+
+    bool result;
+    /* 0 while running, then awaiting coroutine, DoneMark or DetachedMark */
+    std::atomic<void *> continuation;
+  };
+
+  IEC8705103Task(IEC8705103Task &&other) : handle(other.handle) { other.handle = 0; }
+
+  ~IEC8705103Task() {
+    if (handle && handle.promise().continuation.exchange(DetachedMark()) == DoneMark()) handle.destroy();
+  }
+
+  bool Done() const { return handle && handle.promise().continuation.load() == DoneMark(); }
+
+  /*Outcome of the workflow, valid once Done()*/
+  bool Result() const { return handle.promise().result; }
+
+  bool await_ready() const { return Done(); }
+  bool await_suspend(std::coroutine_handle<> awaiting) {
+    void *expected = 0;
+    return handle.promise().continuation.compare_exchange_strong(expected, awaiting.address());
+  }
+  bool await_resume() const { return Result(); }
+
+ private:
+  explicit IEC8705103Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+  IEC8705103Task(const IEC8705103Task &);
+  IEC8705103Task &operator=(const IEC8705103Task &);
+
+  static void *DoneMark() { return reinterpret_cast<void *>(1); }
+  static void *DetachedMark() { return reinterpret_cast<void *>(2); }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/*
+A protection equipment on a line of an IEC87052EventDriver, seen by asynchronous workflows.
+
+Frames are queued on the line session and the workflow waits for their confirmation; answers are ASDUs delivered by
+IEC8705103AsyncDispatcher. Every wait for an ASDU has a timeout (milliseconds) that expires on the line ticks, and
+Cancel() ends all pending waits with false. Workflows of the same station must not run concurrently, since they share
+the ASDUs of the station; different stations are independent.
+
+The station must outlive its workflows: cancel them and let them end before destroying it.
+*/
+class IEC8705103AsyncStation {
+ public:
+  IEC8705103AsyncStation(IEC87052LineSession *line, unsigned char address)
+      : line(line), address(address), manager(0, address), identified(false), orphanSends(0) {}
+
+  /*
+  Wait for an ASDU of type FirstType..LastType from this station. It is registered at construction, so an ASDU arriving
+  before the workflow awaits it is not lost. Scan >= 0 only matches ASDU 8 with that scan number.
+  */
+  class AsduWait {
+   public:
+    AsduWait(IEC8705103AsyncStation &station, unsigned char FirstType, unsigned char LastType, int Scan,
+             unsigned int Timeout)
+        : station(station), firstType(FirstType), lastType(LastType), scan(Scan), size(0), done(false), result(false) {
+      deadline = IEC87052EventDriver::Now() + Timeout;
+      std::lock_guard<std::mutex> guard(station.lock);
+      station.asduWaits.push_back(this);
+    }
+
+    ~AsduWait() {
+      std::lock_guard<std::mutex> guard(station.lock);
+      station.Unregister(this);
+    }
+
+    bool await_ready() {
+      std::lock_guard<std::mutex> guard(station.lock);
+      return done;
+    }
+    bool await_suspend(std::coroutine_handle<> h) {
+      std::lock_guard<std::mutex> guard(station.lock);
+      if (done) return false;
+      handle = h;
+      return true;
+    }
+    bool await_resume() const { return result; }
+
+    /*ASDU received (valid after a successful wait)*/
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+   private:
+    friend class IEC8705103AsyncStation;
+    AsduWait(const AsduWait &);
+    AsduWait &operator=(const AsduWait &);
+
+    bool Matches(const unsigned char *pAsdu, size_t Size) const {
+      if (pAsdu[0] < firstType || pAsdu[0] > lastType) return false;
+      if (scan < 0) return true;
+      return pAsdu[0] == 8 && Size > IEC8705103Manager::ASDUHeaderSize &&
+             pAsdu[IEC8705103Manager::ASDUHeaderSize] == scan;
+    }
+
+    IEC8705103AsyncStation &station;
+    unsigned char firstType;
+    unsigned char lastType;
+    int scan;
+    unsigned long long deadline;
+
+    unsigned char data[FT12Deframer::MaxFrameSize];
+    size_t size;
+    bool done;
+    bool result;
+    std::coroutine_handle<> handle;
+  };
+
+  /*Queues user data on the line: awaiting it gives the link layer confirmation*/
+  class SendWait {
+   public:
+    SendWait(IEC8705103AsyncStation &station, const void *pData, size_t Size, bool Confirm)
+        : station(station), pData(pData), size(Size), confirm(Confirm), result(false) {}
+
+    bool await_ready() { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      /* Held while queueing, so confirmation or Cancel() cannot resume the workflow before Send has copied the data. */
+      std::lock_guard<std::mutex> guard(station.lock);
+      station.sendWaits.push_back(this);
+      if (station.line->Send(station.address, pData, size, confirm)) return true;
+
+      station.sendWaits.pop_back(); /* Refused (line down or data too long): resumes at once with false */
+      return false;
+    }
+    bool await_resume() const { return result; }
+
+   private:
+    friend class IEC8705103AsyncStation;
+
+    IEC8705103AsyncStation &station;
+    const void *pData;
+    size_t size;
+    bool confirm;
+    bool result;
+    std::coroutine_handle<> handle;
+  };
+
+  SendWait Send(const void *pData, size_t Size, bool Confirm = true) { return SendWait(*this, pData, Size, Confirm); }
+
+  /*Waits for the identification (ASDU 5) sent by the equipment after the reset of its link*/
+  IEC8705103Task StationInit(unsigned int Timeout) {
+    AsduWait identification(*this, 5, 5, -1, Timeout);
+    if (IsIdentified()) co_return true;
+
+    co_return co_await identification;
+  }
+
+  /*Clock synchronization (ASDU 6)*/
+  IEC8705103Task TimeSync(time_t Time) {
+    unsigned char buffer[IEC8705103Manager::TimeSyncSize];
+    size_t size = manager.BuildTimeSync(&Time, buffer);
+
+    co_return co_await Send(buffer, size);
+  }
+
+  /*General interrogation (ASDU 7), ends when the termination (ASDU 8) with the same scan number arrives*/
+  IEC8705103Task GeneralInterrogation(unsigned char ScanNumber, unsigned int Timeout) {
+    AsduWait termination(*this, 8, 8, ScanNumber, Timeout);
+
+    unsigned char buffer[IEC8705103Manager::GeneralInterrogationSize];
+    size_t size = manager.BuildGeneralInterrogation(ScanNumber, buffer);
+    bool result = co_await Send(buffer, size);
+    if (!result) co_return false;
+
+    co_return co_await termination;
+  }
+
+  /*General command (ASDU 20), see IEC8705103Manager::CommandTrasmission*/
+  IEC8705103Task Command(IEC8705103Manager::Command Command, unsigned char DCO, unsigned char RII) {
+    if (!manager.IsCommandSupported(Command)) {
+      TRACEENDL("This protection does not support current function");
+      co_return false;
+    }
+
+    unsigned char buffer[IEC8705103Manager::CommandSize];
+    size_t size = manager.BuildCommand(Command, DCO, RII, manager.GetFunctionType(), buffer);
+
+    co_return co_await Send(buffer, size);
+  }
+
+  /*Same sequence as IEC8705103Manager::StationStart*/
+  IEC8705103Task StationStart(unsigned int Timeout) {
+    /* Results are stored before testing them: GCC 12 mishandles the temporary of a co_await in a condition. */
+    bool result = co_await StationInit(Timeout);
+    if (result) result = co_await TimeSync(time(0));
+    if (result) result = co_await GeneralInterrogation(address, Timeout);
+    if (result) result = co_await Command(IEC8705103Manager::LedReset, 2, 10);
+
+    co_return result;
+  }
+
+  /*
+  Waits for a list of disturbances (ASDU 23) and follows the transfer of the record up to its end (ASDU 31), answering
+  each step. Timeout applies to every single ASDU. Data is then in GetManager().GetDisturbanceData().
+  */
+  IEC8705103Task DisturbanceUpload(unsigned int Timeout) {
+    unsigned char reply[IEC8705103Manager::DisturbanceReplySize];
+
+    for (;;) {
+      AsduWait next(*this, 23, 31, -1, Timeout);
+      bool received = co_await next;
+      if (!received) co_return false;
+
+      size_t size = 0;
+      bool finished = false;
+      bool result = manager.DisturbanceStep(next.Data(), next.Size(), reply, &size, &finished);
+      if (size != 0) {
+        bool confirmed = co_await Send(reply, size);
+        if (!confirmed) co_return false;
+      }
+
+      if (finished) co_return result;
+      if (!result && next.Data()[0] == 23) co_return false; /* No disturbance recorded */
+    }
+  }
+
+  /*Ends every pending wait of this station with false*/
+  void Cancel() {
+    std::vector<std::coroutine_handle<> > resume;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      /* Their frames are still in the line queue: confirmations to come belong to nobody. */
+      orphanSends += static_cast<unsigned int>(sendWaits.size());
+      for (size_t i = 0; i < sendWaits.size(); i++) resume.push_back(sendWaits[i]->handle);
+      sendWaits.clear();
+
+      for (size_t i = 0; i < asduWaits.size(); i++) {
+        asduWaits[i]->done = true;
+        asduWaits[i]->result = false;
+        if (asduWaits[i]->handle) resume.push_back(asduWaits[i]->handle);
+      }
+      asduWaits.clear();
+    }
+    for (size_t i = 0; i < resume.size(); i++) resume[i].resume();
+  }
+
+  bool IsIdentified() {
+    std::lock_guard<std::mutex> guard(lock);
+    return identified;
+  }
+
+  int GetLine() const { return line->GetId(); }
+
+  unsigned char GetAddress() const { return address; }
+
+  /*Application state (function type, disturbance data). Use it from the workflows of the station only*/
+  IEC8705103Manager &GetManager() { return manager; }
+
+  /*Delivers an ASDU of this station to the waiting workflow. Returns false if nobody waited for it*/
+  bool OnAsdu(const void *pAsdu, size_t Size) {
+    const unsigned char *p = static_cast<const unsigned char *>(pAsdu);
+    if (Size < IEC8705103Manager::ASDUHeaderSize) return false;
+
+    std::coroutine_handle<> resume;
+    bool matched = false;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (p[0] == 5 && manager.ParseIdentification(pAsdu, Size)) identified = true;
+
+      for (size_t i = 0; i < asduWaits.size(); i++) {
+        AsduWait *w = asduWaits[i];
+        if (!w->Matches(p, Size)) continue;
+
+        w->size = Size < sizeof(w->data) ? Size : sizeof(w->data);
+        memcpy(w->data, p, w->size);
+        w->done = true;
+        w->result = true;
+        resume = w->handle;
+        asduWaits.erase(asduWaits.begin() + i);
+        matched = true;
+        break;
+      }
+    }
+    if (resume) resume.resume();
+    return matched;
+  }
+
+  void OnSendComplete(bool Confirmed) {
+    SendWait *w = 0;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (orphanSends > 0) {
+        orphanSends--;
+        return;
+      }
+      if (sendWaits.empty()) return;
+      w = sendWaits.front();
+      sendWaits.pop_front();
+      w->result = Confirmed;
+    }
+    w->handle.resume();
+  }
+
+  void OnStationState(bool Online) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!Online) identified = false; /* A new identification follows the next reset of the link */
+  }
+
+  /*Expires waits whose timeout is over*/
+  void OnTick(unsigned long long Now) {
+    std::vector<std::coroutine_handle<> > resume;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      for (size_t i = 0; i < asduWaits.size();) {
+        AsduWait *w = asduWaits[i];
+        if (w->deadline > Now) {
+          i++;
+          continue;
+        }
+        w->done = true;
+        w->result = false;
+        if (w->handle) resume.push_back(w->handle);
+        asduWaits.erase(asduWaits.begin() + i);
+      }
+    }
+    for (size_t i = 0; i < resume.size(); i++) resume[i].resume();
+  }
+
+ private:
+  IEC8705103AsyncStation(const IEC8705103AsyncStation &);
+  IEC8705103AsyncStation &operator=(const IEC8705103AsyncStation &);
+
+  void Unregister(AsduWait *w) {
+    for (size_t i = 0; i < asduWaits.size(); i++)
+      if (asduWaits[i] == w) {
+        asduWaits.erase(asduWaits.begin() + i);
+        return;
+      }
+  }
+
+  IEC87052LineSession *line;
+  unsigned char address;
+  IEC8705103Manager manager;
+  bool identified;
+
+  std::mutex lock;
+  std::vector<AsduWait *> asduWaits;
+  std::deque<SendWait *> sendWaits; /* In the order of the line queue */
+  unsigned int orphanSends;
+};
+
+/*
+Event sink routing what happens on the lines to the IEC8705103AsyncStation of each (line, address). ASDUs no workflow
+is waiting for, and stations without an IEC8705103AsyncStation, go to Next (if any). Stations must be added before
+the driver starts.
+*/
+class IEC8705103AsyncDispatcher : public IEC87052EventSink {
+ public:
+  IEC8705103AsyncDispatcher(IEC87052EventSink *Next = 0) : next(Next) {}
+
+  void AddStation(IEC8705103AsyncStation *station) {
+    size_t id = static_cast<size_t>(station->GetLine());
+    if (lines.size() <= id) lines.resize(id + 1);
+    Line &l = lines[id];
+    if (l.byAddress.empty()) l.byAddress.resize(256, 0);
+
+    l.byAddress[station->GetAddress()] = station;
+    l.stations.push_back(station);
+  }
+
+  virtual void OnAsdu(int Line, unsigned char Address, const void *pAsdu, size_t Size) {
+    IEC8705103AsyncStation *station = Find(Line, Address);
+    if (station != 0 && station->OnAsdu(pAsdu, Size)) return;
+    if (next != 0) next->OnAsdu(Line, Address, pAsdu, Size);
+  }
+
+  virtual void OnStationState(int Line, unsigned char Address, bool Online) {
+    IEC8705103AsyncStation *station = Find(Line, Address);
+    if (station != 0) station->OnStationState(Online);
+    if (next != 0) next->OnStationState(Line, Address, Online);
+  }
+
+  virtual void OnSendComplete(int Line, unsigned char Address, bool Confirmed) {
+    IEC8705103AsyncStation *station = Find(Line, Address);
+    if (station != 0) station->OnSendComplete(Confirmed);
+    if (next != 0) next->OnSendComplete(Line, Address, Confirmed);
+  }
+
+  virtual void OnTick(int Line, unsigned long long Now) {
+    if (Line >= 0 && static_cast<size_t>(Line) < lines.size()) {
+      std::vector<IEC8705103AsyncStation *> &stations = lines[Line].stations;
+      for (size_t i = 0; i < stations.size(); i++) stations[i]->OnTick(Now);
+    }
+    if (next != 0) next->OnTick(Line, Now);
+  }
+
+  /*No tick will come any more to expire the waits of its stations: they end now*/
+  virtual void OnLineDown(int Line) {
+    if (Line >= 0 && static_cast<size_t>(Line) < lines.size()) {
+      std::vector<IEC8705103AsyncStation *> &stations = lines[Line].stations;
+      for (size_t i = 0; i < stations.size(); i++) stations[i]->Cancel();
+    }
+    if (next != 0) next->OnLineDown(Line);
+  }
+
+ private:
+  struct Line {
+    std::vector<IEC8705103AsyncStation *> byAddress;
+    std::vector<IEC8705103AsyncStation *> stations;
+  };
+
+  IEC8705103AsyncStation *Find(int Line, unsigned char Address) const {
+    if (Line < 0 || static_cast<size_t>(Line) >= lines.size() || lines[Line].byAddress.empty()) return 0;
+    return lines[Line].byAddress[Address];
+  }
+
+  IEC87052EventSink *next;
+  std::vector<Line> lines;
+};
+
+#endif  // __linux__ && __cpp_impl_coroutine
+
+#endif  // IEC8705103ASYNC_H
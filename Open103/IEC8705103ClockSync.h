@@ -0,0 +1,117 @@
+#ifndef IEC8705103CLOCKSYNC_H
+#define IEC8705103CLOCKSYNC_H
+#pragma once
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Manager.h"
+#include "IEC8705103Time.h"
+#include "gettimeofday.h"
+
+/*
+Clock synchronization compensated for the time the ASDU 6 takes to reach the equipment.
+
+The equipment sets its clock when the whole frame has arrived, so the time sent is the time at which the first
+character is written plus the transmission of the frame at the line baud rate plus the latency of the way there
+(port, converters, gateways). That latency is estimated from confirmed transactions: half of their round trip minus
+the transmission of request and answer, smoothed per equipment and for the whole line (used for broadcasts). It also
+includes the turnaround of the equipment, hence it is an upper bound.
+How far the compensation may be off is given by the spread of those one way samples (GetUncertainty). The ASDU 6 the
+equipment sends back only echoes the time it applied, so it tells nothing about the offset left: that is observed
+afterwards from its time-tagged events (IEC8705103SkewEstimator).
+*/
+typedef class IEC8705103ClockSync_ {
+ public:
+  IEC8705103ClockSync_(const IEC8705103TimeConverter &Converter, const LinkTimings &Timings)
+      : converter(Converter), timings(Timings) {
+    for (int i = 0; i < 256; i++) {
+      devices[i].Latency = -1;
+      devices[i].MinOneWay = -1;
+      devices[i].MaxOneWay = -1;
+    }
+    line.Latency = -1;
+    line.MinOneWay = -1;
+    line.MaxOneWay = -1;
+  }
+
+  /*
+  Synchronizes the equipment of Manager, or the whole line with Broadcast. Before a synchronization with confirmation
+  the link status is requested, to refresh the latency of the equipment.
+  */
+  bool Synchronize(IEC8705103Manager &Manager, bool Broadcast = false, bool SummerTime = false) {
+    unsigned char address = Broadcast ? 255 : Manager.GetAddress();
+
+    unsigned int roundTrip;
+    size_t requestSize;
+    size_t answerSize;
+    if (!Broadcast && Manager.MeasureLink(&roundTrip, &requestSize, &answerSize))
+      OnRoundTrip(address, roundTrip, requestSize, answerSize);
+
+    unsigned char time[ASDUView::Cp56Size];
+    converter.ToCp56(Now() + Compensation(address), time, SummerTime);
+    return Manager.SendTimeSync(time, Broadcast);
+  }
+
+  /*Accounts a confirmed transaction: RoundTrip microseconds, frames of RequestSize and AnswerSize bytes on line*/
+  void OnRoundTrip(unsigned char Address, unsigned int RoundTrip, size_t RequestSize, size_t AnswerSize) {
+    long long transmission = static_cast<long long>(timings.FrameTime(RequestSize)) + timings.FrameTime(AnswerSize);
+    long long oneWay = (static_cast<long long>(RoundTrip) - transmission) / 2;
+    if (oneWay < 0) oneWay = 0;
+
+    Account(&devices[Address], oneWay * 1000);
+    Account(&line, oneWay * 1000);
+  }
+
+  /*Nanoseconds to add to the current time in an ASDU 6 for Address (255: broadcast)*/
+  long long Compensation(unsigned char Address) const {
+    long long latency = Address == 255 || devices[Address].Latency < 0 ? line.Latency : devices[Address].Latency;
+    if (latency < 0) latency = 0;
+
+    return static_cast<long long>(timings.FrameTime(SyncFrameSize)) * 1000 + latency;
+  }
+
+  /*
+  Nanoseconds by which the compensation for Address (255: line) may be wrong: largest minus smallest one way latency
+  measured so far. -1 if never measured
+  */
+  long long GetUncertainty(unsigned char Address) const {
+    const Path &path = Address == 255 || devices[Address].Latency < 0 ? line : devices[Address];
+    return path.Latency < 0 ? -1 : path.MaxOneWay - path.MinOneWay;
+  }
+
+  /*Estimated one way latency in nanoseconds (255: line), -1 if never measured*/
+  long long GetLatency(unsigned char Address) const {
+    return Address == 255 ? line.Latency : devices[Address].Latency;
+  }
+
+  /*Local clock, UTC nanoseconds*/
+  static long long Now() {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return static_cast<long long>(tv.tv_sec) * 1000000000LL + static_cast<long long>(tv.tv_usec) * 1000;
+  }
+
+ private:
+  /*ASDU 6 in a variable frame*/
+  static const size_t SyncFrameSize = FT12Frame::VariableHeaderSize + IEC8705103Manager::TimeSyncSize;
+
+  typedef struct Path_ {
+    long long Latency;   /*Nanoseconds, -1 if unknown*/
+    long long MinOneWay; /*Extremes of the one way samples, nanoseconds*/
+    long long MaxOneWay;
+  } Path;
+
+  /*Exponential average with weight 1/8 for the new sample (the first sample is taken as is), and its extremes*/
+  static void Account(Path *path, long long Sample) {
+    path->Latency = path->Latency < 0 ? Sample : path->Latency + (Sample - path->Latency) / 8;
+    if (path->MinOneWay < 0 || Sample < path->MinOneWay) path->MinOneWay = Sample;
+    if (Sample > path->MaxOneWay) path->MaxOneWay = Sample;
+  }
+
+  IEC8705103TimeConverter converter;
+  LinkTimings timings;
+  Path devices[256];
+  Path line;
+
+} IEC8705103ClockSync; /*Latency compensated clock synchronization*/
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef IEC8705103COMMANDS_H
+#define IEC8705103COMMANDS_H
+#pragma once
+
+#include <string.h>
+
+#include <vector>
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Manager.h"
+
+#ifdef __linux__
+#include <future>
+#include <mutex>
+#include "IEC87052EventDriver.h"
+#endif
+
+/*How a general command ended*/
+enum CommandOutcome {
+  CommandPositive = 1, /*ASDU 1, cause of transmission 20*/
+  CommandNegative,     /*ASDU 1, cause of transmission 21*/
+  CommandTimedOut,     /*No acknowledgement within the timeout*/
+  CommandStationLost   /*The link layer lost the station while waiting*/
+};
+
+/*A general command (ASDU 20) and its acknowledgement*/
+typedef struct CommandResult_ {
+  int Bus;
+  unsigned char Address;
+  unsigned char FunctionType;
+  unsigned char InformationNumber;
+  unsigned char DCO; /*1 OFF, 2 ON*/
+  unsigned char RII; /*Return information identifier, repeated by the acknowledgement*/
+  unsigned char Outcome;
+  unsigned char DPI;        /*Of the acknowledgement, 0 if none*/
+  unsigned long long Sent;  /*Milliseconds*/
+  unsigned long long Ended; /*Acknowledgement, timeout or loss*/
+
+  unsigned long long Latency() const { return Ended - Sent; }
+} CommandResult;
+
+/*Round trip of acknowledged commands: bucket 0 counts latencies below 1 ms, bucket i (> 0) [2^(i-1), 2^i) ms*/
+typedef struct CommandLatencyHistogram_ {
+  static const unsigned int BucketCount = 24;
+
+  unsigned int Buckets[BucketCount];
+  unsigned int Count;
+  unsigned long long Total;
+  unsigned long long Min;
+  unsigned long long Max;
+
+  unsigned long long Average() const { return Count != 0 ? Total / Count : 0; }
+
+  /*Upper bound (ms) of the bucket holding the Percent-th percentile, 0 if empty*/
+  unsigned long long Percentile(unsigned int Percent) const {
+    unsigned long long rank = (static_cast<unsigned long long>(Count) * Percent + 99) / 100;
+    unsigned long long seen = 0;
+    for (unsigned int i = 0; i < BucketCount; i++) {
+      seen += Buckets[i];
+      if (Count != 0 && seen >= rank) return 1ULL << i;
+    }
+    return 0;
+  }
+} CommandLatencyHistogram;
+
+/*
+General commands to many devices at once, matched with their acknowledgement.
+
+Track() gives the command a return information identifier (RII) not used by another outstanding command of the same
+device; the caller then sends BuildCommand(Address, FunctionType, InformationNumber, DCO, RII, ...). The equipment
+acknowledges with an ASDU 1 carrying the same function type, information number and RII (as supplementary
+information), cause of transmission 20 (positive) or 21 (negative): OnAsdu() matches it and calls the callback of the
+command. Commands not acknowledged within Timeout, or whose station is lost, end with the callback as well. Latencies
+of acknowledged commands go into a histogram.
+Times are milliseconds of any monotonic clock. The tracker does no I/O and is not synchronized.
+*/
+typedef class IEC8705103CommandTracker_ {
+ public:
+  typedef void (*Callback)(void *Context, const CommandResult &Result);
+
+  IEC8705103CommandTracker_(unsigned long long Timeout = 10000) : timeout(Timeout) {
+    memset(&histogram, 0, sizeof(histogram));
+  }
+
+  /*
+  Registers a command about to be sent to Address of Bus. Returns false if the device has 256 commands outstanding.
+  *RII is the identifier to send.
+  */
+  bool Track(int Bus, unsigned char Address, unsigned char FunctionType, unsigned char InformationNumber,
+             unsigned char DCO, Callback callback, void *Context, unsigned long long Now, unsigned char *RII) {
+    if (Bus < 0) return false;
+    Device &d = DeviceOf(Bus, Address);
+
+    unsigned int rii = d.next;
+    for (unsigned int n = 0; n < 256 && (d.used[rii >> 5] & (1u << (rii & 31))) != 0; n++) rii = (rii + 1) & 0xFF;
+    if ((d.used[rii >> 5] & (1u << (rii & 31))) != 0) return false;
+    d.used[rii >> 5] |= 1u << (rii & 31);
+    d.next = static_cast<unsigned char>(rii + 1);
+
+    Pending p;
+    p.Result.Bus = Bus;
+    p.Result.Address = Address;
+    p.Result.FunctionType = FunctionType;
+    p.Result.InformationNumber = InformationNumber;
+    p.Result.DCO = DCO;
+    p.Result.RII = static_cast<unsigned char>(rii);
+    p.Result.Outcome = 0;
+    p.Result.DPI = 0;
+    p.Result.Sent = Now;
+    p.Result.Ended = 0;
+    p.Deadline = Now + timeout;
+    p.callback = callback;
+    p.Context = Context;
+    pending.push_back(p);
+
+    *RII = static_cast<unsigned char>(rii);
+    return true;
+  }
+
+  /*Forgets a command that could not be sent after all, without calling its callback. Returns false if unknown*/
+  bool Untrack(int Bus, unsigned char Address, unsigned char RII) {
+    for (size_t i = 0; i < pending.size(); i++) {
+      const CommandResult &r = pending[i].Result;
+      if (r.Bus != Bus || r.Address != Address || r.RII != RII) continue;
+
+      Device &d = devices[Bus][Address];
+      d.used[RII >> 5] &= ~(1u << (RII & 31));
+      pending[i] = pending.back();
+      pending.pop_back();
+      return true;
+    }
+    return false;
+  }
+
+  /*Accounts a received ASDU. Returns true if it acknowledged an outstanding command*/
+  bool OnAsdu(int Bus, unsigned char Address, const void *pAsdu, size_t Size, unsigned long long Now) {
+    ASDUView asdu(pAsdu, Size);
+    TimeTaggedMessageView ack;
+    unsigned char cot = asdu.CauseOfTransmission();
+    if ((cot != 20 && cot != 21) || asdu.TypeIdentification() != 1 || !ack.Bind(asdu)) return false;
+
+    for (size_t i = 0; i < pending.size(); i++) {
+      const CommandResult &r = pending[i].Result;
+      if (r.Bus != Bus || r.Address != Address || r.RII != ack.SupplementaryInformation() ||
+          r.FunctionType != asdu.FunctionType() || r.InformationNumber != asdu.InformationNumber())
+        continue;
+
+      pending[i].Result.DPI = ack.DPI();
+      Account(Now - r.Sent);
+      End(i, cot == 20 ? CommandPositive : CommandNegative, Now);
+      return true;
+    }
+    return false;
+  }
+
+  /*The link layer lost the station: its outstanding commands end now*/
+  void OnStationLost(int Bus, unsigned char Address, unsigned long long Now) {
+    for (size_t i = pending.size(); i-- > 0;) /*End() moves the last one here: already checked*/
+      if (pending[i].Result.Bus == Bus && pending[i].Result.Address == Address) End(i, CommandStationLost, Now);
+  }
+
+  /*The bus is gone for good: all its outstanding commands end now*/
+  void OnBusLost(int Bus, unsigned long long Now) {
+    for (size_t i = pending.size(); i-- > 0;)
+      if (pending[i].Result.Bus == Bus) End(i, CommandStationLost, Now);
+  }
+
+  /*Expires commands not acknowledged in time*/
+  void OnTick(unsigned long long Now) {
+    for (size_t i = pending.size(); i-- > 0;)
+      if (pending[i].Deadline <= Now) End(i, CommandTimedOut, Now);
+  }
+
+  /*Commands waiting for their acknowledgement*/
+  size_t GetOutstanding() const { return pending.size(); }
+
+  size_t GetOutstanding(int Bus, unsigned char Address) const {
+    size_t count = 0;
+    for (size_t i = 0; i < pending.size(); i++)
+      count += pending[i].Result.Bus == Bus && pending[i].Result.Address == Address;
+    return count;
+  }
+
+  const CommandLatencyHistogram &GetHistogram() const { return histogram; }
+
+  void ResetHistogram() { memset(&histogram, 0, sizeof(histogram)); }
+
+ private:
+  typedef struct Pending_ {
+    CommandResult Result;
+    unsigned long long Deadline;
+    Callback callback;
+    void *Context;
+  } Pending;
+
+  typedef struct Device_ {
+    unsigned int used[8]; /*RIIs outstanding*/
+    unsigned char next;   /*Next RII to try*/
+  } Device;
+
+  Device &DeviceOf(int Bus, unsigned char Address) {
+    if (static_cast<size_t>(Bus) >= devices.size()) devices.resize(Bus + 1);
+    std::vector<Device> &bus = devices[Bus];
+    if (bus.empty()) {
+      Device d;
+      memset(&d, 0, sizeof(d));
+      bus.resize(256, d);
+    }
+    return bus[Address];
+  }
+
+  void Account(unsigned long long Latency) {
+    unsigned int bucket = 0;
+    while (bucket + 1 < CommandLatencyHistogram::BucketCount && (Latency >> bucket) != 0) bucket++;
+
+    histogram.Buckets[bucket]++;
+    if (histogram.Count == 0 || Latency < histogram.Min) histogram.Min = Latency;
+    if (Latency > histogram.Max) histogram.Max = Latency;
+    histogram.Count++;
+    histogram.Total += Latency;
+  }
+
+  /*Frees the RII, removes the command and calls its callback*/
+  void End(size_t i, unsigned char Outcome, unsigned long long Now) {
+    Pending p = pending[i];
+    pending[i] = pending.back();
+    pending.pop_back();
+
+    Device &d = devices[p.Result.Bus][p.Result.Address];
+    d.used[p.Result.RII >> 5] &= ~(1u << (p.Result.RII & 31));
+
+    p.Result.Outcome = Outcome;
+    p.Result.Ended = Now;
+    if (p.callback != 0) p.callback(p.Context, p.Result);
+  }
+
+  const unsigned long long timeout;
+  std::vector<Pending> pending;
+  std::vector<std::vector<Device> > devices; /*Per bus, per address*/
+  CommandLatencyHistogram histogram;
+
+} IEC8705103CommandTracker; /*Outstanding general commands and their acknowledgements*/
+
+#ifdef __linux__
+
+/*
+Runs an IEC8705103CommandTracker on the lines of an IEC87052EventDriver: the bus of a device is the id of its line.
+Commands are queued on the line at once, so commands to different devices (and lines) are in flight together; every
+event is also forwarded to Next (if any). The tracker is shared by the driver threads, hence guarded by a mutex.
+Callbacks run on a driver thread with that mutex held: they must not call the engine.
+*/
+class IEC8705103CommandEngine : public IEC87052EventSink {
+ public:
+  IEC8705103CommandEngine(unsigned long long Timeout = 10000, IEC87052EventSink *Next = 0)
+      : tracker(Timeout), next(Next) {}
+
+  /*Adds a line. Must be called before the driver starts*/
+  void AddLine(IEC87052LineSession *line) {
+    size_t id = static_cast<size_t>(line->GetId());
+    if (lines.size() <= id) lines.resize(id + 1, 0);
+    lines[id] = line;
+  }
+
+  /*Sends a general command; callback is called with its outcome. Returns false if it could not be sent*/
+  bool Command(int Line, unsigned char Address, unsigned char FunctionType, unsigned char InformationNumber,
+               unsigned char DCO, IEC8705103CommandTracker::Callback callback, void *Context) {
+    if (Line < 0 || static_cast<size_t>(Line) >= lines.size() || lines[Line] == 0) return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned char rii;
+    if (!tracker.Track(Line, Address, FunctionType, InformationNumber, DCO, callback, Context,
+                       IEC87052EventDriver::Now(), &rii))
+      return false;
+
+    unsigned char buffer[IEC8705103Manager::CommandSize];
+    size_t size = IEC8705103Manager::BuildCommand(Address, FunctionType, InformationNumber, DCO, rii, buffer);
+    if (lines[Line]->Send(Address, buffer, size)) return true;
+
+    /* Line down: the command would only time out later. */
+    tracker.Untrack(Line, Address, rii);
+    return false;
+  }
+
+  /*Same, the outcome is delivered through a future (Outcome 0: the command could not be sent)*/
+  std::future<CommandResult> Command(int Line, unsigned char Address, unsigned char FunctionType,
+                                     unsigned char InformationNumber, unsigned char DCO) {
+    std::promise<CommandResult> *promise = new std::promise<CommandResult>();
+    std::future<CommandResult> result = promise->get_future();
+
+    if (!Command(Line, Address, FunctionType, InformationNumber, DCO, Resolve, promise)) {
+      CommandResult failed;
+      memset(&failed, 0, sizeof(failed));
+      failed.Bus = Line;
+      failed.Address = Address;
+      Resolve(promise, failed);
+    }
+    return result;
+  }
+
+  size_t GetOutstanding() {
+    std::lock_guard<std::mutex> guard(lock);
+    return tracker.GetOutstanding();
+  }
+
+  CommandLatencyHistogram GetHistogram() {
+    std::lock_guard<std::mutex> guard(lock);
+    return tracker.GetHistogram();
+  }
+
+  virtual void OnAsdu(int Line, unsigned char Address, const void *pAsdu, size_t Size) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      tracker.OnAsdu(Line, Address, pAsdu, Size, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnAsdu(Line, Address, pAsdu, Size);
+  }
+
+  virtual void OnStationState(int Line, unsigned char Address, bool Online) {
+    if (!Online) {
+      std::lock_guard<std::mutex> guard(lock);
+      tracker.OnStationLost(Line, Address, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnStationState(Line, Address, Online);
+  }
+
+  virtual void OnSendComplete(int Line, unsigned char Address, bool Confirmed) {
+    if (next != 0) next->OnSendComplete(Line, Address, Confirmed);
+  }
+
+  virtual void OnTick(int Line, unsigned long long Now) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      tracker.OnTick(Now);
+    }
+    if (next != 0) next->OnTick(Line, Now);
+  }
+
+  virtual void OnLineDown(int Line) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      tracker.OnBusLost(Line, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnLineDown(Line);
+  }
+
+ private:
+  static void Resolve(void *Context, const CommandResult &Result) {
+    std::promise<CommandResult> *promise = static_cast<std::promise<CommandResult> *>(Context);
+    promise->set_value(Result);
+    delete promise;
+  }
+
+  IEC8705103CommandTracker tracker;
+  IEC87052EventSink *next;
+  std::vector<IEC87052LineSession *> lines;
+  std::mutex lock;
+};
+
+#endif  // __linux__
+
+#endif  // IEC8705103COMMANDS_H
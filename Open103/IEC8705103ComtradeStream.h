@@ -0,0 +1,243 @@
+#ifndef IEC8705103COMTRADESTREAM_H
+#define IEC8705103COMTRADESTREAM_H
+#pragma once
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Manager.h"
+
+/*
+COMTRADE export of a disturbance record while it is being transferred, instead of SaveToComtrade once it is over.
+
+Every disturbance ASDU is given to OnAsdu() after the manager has processed it, with the record of the manager:
+storing the samples there can be turned off (SetDisturbanceValuesStored(false)), since they go straight to the file.
+ASDU 26 creates the .dat sized for the announced samples, memory mapped, and writes the .cfg; each ASDU 27 rewrites
+the .cfg with the factors of its channel. The .dat is BINARY: records have a fixed size, so each value of an ASDU 30
+is written in its place as soon as it arrives, whatever the order of the channels. At the end of the transfer (ASDU
+31) the digital channels are filled from the tags in one pass and the .cfg gets the range of each analog channel.
+The export ends with the transfer and needs no memory for the samples: one ASDU at a time.
+*/
+typedef class IEC8705103ComtradeStream_ {
+ public:
+  /*Same descriptions as SaveToComtrade: achannels[i].channelCode is the ACC of analog channel i*/
+  IEC8705103ComtradeStream_(const std::string &filename, const std::string &StationName, unsigned short StNum,
+                            const IEC8705103Manager::AnalogChannel *achannels, unsigned short AChannelCount,
+                            const IEC8705103Manager::DigitalChannel *dchannels, unsigned short DChannelCount,
+                            const std::string &linefreq)
+      : filename(filename), stationName(StationName), stNum(StNum), linefreq(linefreq),
+        analog(achannels, achannels + AChannelCount), digital(dchannels, dchannels + DChannelCount),
+        recordSize(8 + 2 * AChannelCount + 2 * ((DChannelCount + 15) / 16)), fd(-1), base(0), size(0), samples(0),
+        running(false), finished(false) {
+    std::fill(column, column + 256, static_cast<unsigned short>(NoChannel));
+    for (unsigned short i = 0; i < AChannelCount; i++)
+      if (achannels[i].channelCode < 256 && column[achannels[i].channelCode] == NoChannel)
+        column[achannels[i].channelCode] = i;
+  }
+
+  ~IEC8705103ComtradeStream_() { Abort(); }
+
+  /*
+  Record: GetDisturbanceData() of the manager that has just processed the ASDU. ASDUs other than 26, 27, 30 and 31
+  are ignored. Returns false if the ASDU is malformed or the files cannot be written: the export is then abandoned.
+  */
+  bool OnAsdu(const IEC8705103Manager::Disturbance &Record, const void *pAsdu, size_t Size) {
+    ASDUView asdu(pAsdu, Size);
+    switch (asdu.TypeIdentification()) {
+      case 26:
+        return Begin(Record);
+      case 27:
+        return !running || WriteConfig(Record);
+      case 30:
+        return !running || Values(asdu);
+      case 31: {
+        TransmissionEndView A31;
+        if (!A31.Bind(asdu)) return false;
+        if (!running) return true;
+        if (A31.TypeOfOrder() == 32) return Finish(Record);
+        if (A31.TypeOfOrder() == 33 || A31.TypeOfOrder() == 34) Abort(); /*Aborted by the master or by protection*/
+        return true;
+      }
+      default:
+        return true;
+    }
+  }
+
+  /*Stops the export in progress, if any, and removes its files (e.g. the transfer has been aborted by the master)*/
+  void Abort() {
+    if (!running) return;
+    Unmap();
+    unlink((filename + ".dat").c_str());
+    unlink((filename + ".cfg").c_str());
+    running = false;
+  }
+
+  /*A record is being exported*/
+  bool IsRunning() const { return running; }
+
+  /*The last record has been exported completely*/
+  bool IsFinished() const { return finished; }
+
+ private:
+  static const unsigned short NoChannel = 0xFFFF;
+
+  bool Begin(const IEC8705103Manager::Disturbance &Record) {
+    Abort();
+    finished = false;
+    samples = Record.ChannelList.ChannelElements;
+    size = static_cast<size_t>(samples) * recordSize;
+    min.assign(analog.size(), 0);
+    max.assign(analog.size(), 0);
+
+    fd = open((filename + ".dat").c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      TRACEENDL("Unable to open file dat");
+      return false;
+    }
+    running = true;
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      TRACEENDL("Unable to size file dat");
+      Abort();
+      return false;
+    }
+
+    if (size != 0) {
+      void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED) {
+        TRACEENDL("Unable to map file dat");
+        Abort();
+        return false;
+      }
+      base = static_cast<unsigned char *>(p);
+    }
+
+    /*Sample number and time stamp (microseconds) of each record; values stay 0 until they arrive*/
+    for (unsigned int i = 0; i < samples; i++) {
+      unsigned int number = i + 1;
+      unsigned int stamp = static_cast<unsigned int>(Record.SamplingTime) * i;
+      memcpy(base + static_cast<size_t>(i) * recordSize, &number, 4);
+      memcpy(base + static_cast<size_t>(i) * recordSize + 4, &stamp, 4);
+    }
+
+    return WriteConfig(Record);
+  }
+
+  bool Values(const ASDUView &asdu) {
+    DisturbanceValuesView A30;
+    if (!A30.Bind(asdu)) {
+      TRACEENDL("Malformed disturbance values");
+      return false;
+    }
+
+    unsigned short c = column[A30.Channel()];
+    if (c == NoChannel) return true; /*Channel not exported*/
+
+    for (unsigned char i = 0; i < A30.Count(); i++) {
+      unsigned int element = A30.FirstElement() + i;
+      if (element >= samples) {
+        TRACEENDL("Overflow with values!");
+        break;
+      }
+
+      short value = A30.Value(i);
+      memcpy(base + static_cast<size_t>(element) * recordSize + 8 + 2 * c, &value, 2);
+      if (value < min[c]) min[c] = value;
+      if (value > max[c]) max[c] = value;
+    }
+    return true;
+  }
+
+  bool Finish(const IEC8705103Manager::Disturbance &Record) {
+    if (!digital.empty()) WriteDigital(Record);
+
+    bool result = WriteConfig(Record);
+    if (size != 0 && msync(base, size, MS_SYNC) != 0) result = false;
+    Unmap();
+    running = false;
+    finished = result;
+    if (!result) TRACEENDL("Unable to complete COMTRADE files");
+    return result;
+  }
+
+  /*
+  Status words of every record from the tags: the changes sorted by position, then one pass over the samples. As in
+  SaveToComtrade, channels start from their currVal
+  */
+  void WriteDigital(const IEC8705103Manager::Disturbance &Record) {
+    std::vector<IEC8705103Manager::DigitalChange> changes;
+    IEC8705103Manager::GetDigitalChanges(Record, &digital[0], static_cast<unsigned short>(digital.size()), &changes);
+
+    std::vector<unsigned short> words((digital.size() + 15) / 16, 0);
+    for (size_t k = 0; k < digital.size(); k++)
+      if (digital[k].currVal == 1) words[k / 16] |= static_cast<unsigned short>(1 << (k % 16));
+    const size_t offset = 8 + 2 * analog.size();
+    size_t next = 0;
+    for (unsigned int i = 0; i < samples; i++) {
+      for (; next < changes.size() && changes[next].TAP <= i; next++) {
+        unsigned short bit = static_cast<unsigned short>(1 << (changes[next].Channel % 16));
+        if (changes[next].Value == 1)
+          words[changes[next].Channel / 16] |= bit;
+        else
+          words[changes[next].Channel / 16] &= ~bit;
+      }
+      memcpy(base + static_cast<size_t>(i) * recordSize + offset, &words[0], 2 * words.size());
+    }
+  }
+
+  bool WriteConfig(const IEC8705103Manager::Disturbance &Record) {
+    if (IEC8705103Manager::WriteComtradeConfig(filename, stationName, stNum, Record, analog.empty() ? 0 : &analog[0],
+                                               static_cast<unsigned short>(analog.size()),
+                                               digital.empty() ? 0 : &digital[0],
+                                               static_cast<unsigned short>(digital.size()), linefreq,
+                                               min.empty() ? 0 : &min[0], max.empty() ? 0 : &max[0],
+                                               IEC8705103Manager::ComtradeBinary))
+      return true;
+
+    Abort();
+    return false;
+  }
+
+  void Unmap() {
+    if (base != 0) munmap(base, size);
+    if (fd >= 0) close(fd);
+    base = 0;
+    fd = -1;
+  }
+
+  // I won't let you copy this object.
+  IEC8705103ComtradeStream_(const IEC8705103ComtradeStream_ &);
+  IEC8705103ComtradeStream_ &operator=(const IEC8705103ComtradeStream_ &);
+
+  const std::string filename;
+  const std::string stationName;
+  const unsigned short stNum;
+  const std::string linefreq;
+  const std::vector<IEC8705103Manager::AnalogChannel> analog;
+  const std::vector<IEC8705103Manager::DigitalChannel> digital;
+  unsigned short column[256]; /*Analog channel of each ACC*/
+  const size_t recordSize;    /*Bytes of one sample in the .dat*/
+
+  int fd;
+  unsigned char *base; /*.dat mapping*/
+  size_t size;
+  unsigned int samples;
+  std::vector<short> min; /*Range of each analog channel so far*/
+  std::vector<short> max;
+  bool running;
+  bool finished;
+
+} IEC8705103ComtradeStream; /*Disturbance record to COMTRADE files while it arrives*/
+
+#endif
+
+#endif
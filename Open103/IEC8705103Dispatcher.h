@@ -0,0 +1,186 @@
+#ifndef IEC8705103DISPATCHER_H
+#define IEC8705103DISPATCHER_H
+#pragma once
+
+#include <vector>
+#include "IEC8705103Asdu.h"
+#include "IFT12.h"
+
+/*
+Typed view bound for each type identification before its handlers are called.
+Types without a dedicated view (private ranges included) get the plain ASDUView: only the header is checked.
+*/
+template <unsigned char Type>
+struct ASDUBody {
+  typedef ASDUView View;
+};
+template <> struct ASDUBody<1> { typedef TimeTaggedMessageView View; };
+template <> struct ASDUBody<2> { typedef TimeTaggedMessageView View; };
+template <> struct ASDUBody<3> { typedef MeasurandsView View; };
+template <> struct ASDUBody<4> { typedef TimeTaggedMeasurandView View; };
+template <> struct ASDUBody<5> { typedef IdentificationView View; };
+template <> struct ASDUBody<6> { typedef TimeSyncView View; };
+template <> struct ASDUBody<7> { typedef ScanView View; };
+template <> struct ASDUBody<8> { typedef ScanView View; };
+template <> struct ASDUBody<9> { typedef MeasurandsView View; };
+template <> struct ASDUBody<10> { typedef GenericDataView View; };
+template <> struct ASDUBody<11> { typedef GenericDataView View; };
+template <> struct ASDUBody<23> { typedef DisturbanceListView View; };
+template <> struct ASDUBody<26> { typedef DisturbanceReadyView View; };
+template <> struct ASDUBody<27> { typedef ChannelReadyView View; };
+template <> struct ASDUBody<28> { typedef TagsReadyView View; };
+template <> struct ASDUBody<29> { typedef TagsView View; };
+template <> struct ASDUBody<30> { typedef DisturbanceValuesView View; };
+template <> struct ASDUBody<31> { typedef TransmissionEndView View; };
+template <> struct ASDUBody<205> { typedef EnergyCounterView View; };
+
+/*
+Routes received ASDUs to the handlers registered for their type identification.
+
+The dispatcher is a table of 256 slots indexed by type: reaching the handlers of an ASDU is one indexed load. The
+code run for a slot is selected at compile time by Register<Type>(): it binds the typed view of ASDUBody<Type> once
+and passes it to every handler of the slot whose function type / information number filter matches, so handlers
+receive an already checked view and never parse the header again. ASDUs that fail to bind are counted as malformed
+and reach no handler; valid ASDUs no handler took go to the default handler, if any.
+
+Registration is not synchronized with Dispatch(): register every handler before ASDUs start flowing.
+*/
+typedef class IEC8705103Dispatcher_ {
+ public:
+  static const int Any = -1; /*Filter accepting every function type or information number*/
+
+  typedef void (*Handler)(void *Context, const ASDUView &Asdu); /*Default handler*/
+
+  IEC8705103Dispatcher_() : defaultHandler(0), defaultContext(0), malformed(0), unhandled(0) {}
+
+  /*
+  Registers handler for ASDUs of Type, optionally only for one function type and/or information number.
+  Body is a private copy of the bound view for this handler (walking a GenericDataView does not affect other handlers).
+  Example: Register<1>(OnTrip, this, 128, 68) receives ASDU 1 of FUN 128 / INF 68 as a TimeTaggedMessageView.
+  */
+  template <unsigned char Type>
+  bool Register(void (*handler)(void *Context, const ASDUView &Asdu, typename ASDUBody<Type>::View &Body),
+                void *Context, int FunctionType = Any, int InformationNumber = Any) {
+    if (handler == 0) return false;
+    if (FunctionType < Any || FunctionType > 255 || InformationNumber < Any || InformationNumber > 255) {
+      TRACEENDL("Function type and information number filters must be Any or 0..255");
+      return false;
+    }
+
+    Slot &slot = slots[Type];
+    slot.deliver = &Deliver<Type>;
+
+    Route route;
+    route.handler = reinterpret_cast<AnyFunction>(handler);
+    route.context = Context;
+    route.functionType = static_cast<short>(FunctionType);
+    route.informationNumber = static_cast<short>(InformationNumber);
+    slot.routes.push_back(route);
+    return true;
+  }
+
+  /*Removes every handler registered with Context*/
+  void Unregister(void *Context) {
+    for (int i = 0; i < 256; i++) {
+      std::vector<Route> &routes = slots[i].routes;
+      for (size_t r = routes.size(); r-- > 0;)
+        if (routes[r].context == Context) routes.erase(routes.begin() + r);
+      if (routes.empty()) slots[i].deliver = 0;
+    }
+  }
+
+  /*Receives valid ASDUs no registered handler took (0 to drop them)*/
+  void SetDefaultHandler(Handler handler, void *Context) {
+    defaultHandler = handler;
+    defaultContext = Context;
+  }
+
+  /*Delivers one received ASDU. Returns true if at least one registered handler (default excluded) received it*/
+  bool Dispatch(const void *pAsdu, size_t Size) {
+    ASDUView asdu(pAsdu, Size);
+    if (!asdu.IsValid()) {
+      malformed++;
+      return false;
+    }
+
+    const Slot &slot = slots[asdu.TypeIdentification()];
+    Result result = slot.deliver != 0 ? slot.deliver(slot, asdu) : Unmatched;
+    if (result == Delivered) return true;
+
+    if (result == Malformed) {
+      malformed++;
+      return false;
+    }
+
+    unhandled++;
+    if (defaultHandler != 0) defaultHandler(defaultContext, asdu);
+    return false;
+  }
+
+  /*ASDUs dropped because they were truncated or inconsistent with their type*/
+  unsigned long long GetMalformedCount() const { return malformed; }
+
+  /*Valid ASDUs no registered handler took*/
+  unsigned long long GetUnhandledCount() const { return unhandled; }
+
+ private:
+  enum Result { Delivered, Unmatched, Malformed };
+
+  typedef void (*AnyFunction)();
+
+  typedef struct Route_ {
+    AnyFunction handler; /*Typed handler of the slot, cast back by Deliver<Type>*/
+    void *context;
+    short functionType;
+    short informationNumber;
+
+    bool Matches(unsigned char FunctionType, unsigned char InformationNumber) const {
+      return (functionType == Any || functionType == FunctionType) &&
+             (informationNumber == Any || informationNumber == InformationNumber);
+    }
+  } Route;
+
+  struct Slot;
+  typedef Result (*Deliverer)(const Slot &slot, const ASDUView &Asdu);
+
+  struct Slot {
+    Slot() : deliver(0) {}
+
+    Deliverer deliver;
+    std::vector<Route> routes;
+  };
+
+  template <unsigned char Type>
+  static Result Deliver(const Slot &slot, const ASDUView &Asdu) {
+    typedef typename ASDUBody<Type>::View View;
+    typedef void (*TypedHandler)(void *Context, const ASDUView &Asdu, View &Body);
+
+    View body;
+    if (!body.Bind(Asdu)) return Malformed;
+
+    unsigned char fun = Asdu.FunctionType();
+    unsigned char inf = Asdu.InformationNumber();
+    Result result = Unmatched;
+
+    for (size_t i = 0; i < slot.routes.size(); i++) {
+      const Route &route = slot.routes[i];
+      if (!route.Matches(fun, inf)) continue;
+
+      View copy = body;
+      reinterpret_cast<TypedHandler>(route.handler)(route.context, Asdu, copy);
+      result = Delivered;
+    }
+    return result;
+  }
+
+  Slot slots[256];
+
+  Handler defaultHandler;
+  void *defaultContext;
+
+  unsigned long long malformed;
+  unsigned long long unhandled;
+
+} IEC8705103Dispatcher; /*Per-type routing of received ASDUs*/
+
+#endif
@@ -0,0 +1,458 @@
+#ifndef IEC8705103DISTURBANCEPOOL_H
+#define IEC8705103DISTURBANCEPOOL_H
+#pragma once
+
+#include <vector>
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Manager.h"
+#include "IEC8705103Time.h"
+
+#ifdef __linux__
+#include <mutex>
+#include "IEC87052EventDriver.h"
+#endif
+
+/*Upload of one disturbance record*/
+typedef struct DisturbanceUpload_ {
+  enum State { Running = 1, Completed, Failed };
+
+  int Bus;
+  unsigned char Address;
+  unsigned char State;
+  unsigned short FaultNumber; /*FAN*/
+  long long FaultTime;        /*From the list of disturbances (ASDU 23), nanoseconds*/
+  unsigned long long Started; /*Milliseconds: selection sent*/
+  unsigned long long Finished;
+  size_t Bytes; /*Memory of the record*/
+} DisturbanceUpload;
+
+/*
+Uploads disturbance records of many devices at once, within a bounded pool.
+
+Every device has its own transfer state (an IEC8705103Manager used only for its disturbance data), so uploads run in
+parallel across devices and buses. The pool learns the recorded faults from the lists (ASDU 23) the devices send and
+starts uploads while fewer than MaxUploads are running and the memory of running uploads plus that of the record
+stays within MaxBytes. A record counts ExpectedBytes (or the size an earlier attempt learnt) until its announcement
+(ASDU 26) tells its real size; if the pool then holds more than MaxBytes, the upload is aborted (ASDU 24, TOO 3) and
+its fault waits, with its size known, until it fits (a record larger than MaxBytes by itself is given up). Among the
+faults that fit, the newest goes first. Orders (ASDU 24/25) go out through Sender; once an upload ends, Listener
+gets the record and its memory is released. A device silent for Timeout during its upload is told to abort and the
+fault is tried again later, up to MaxAttempts times. After an abort the device gets no new order until it ends the
+transfer (ASDU 31) or Timeout passes.
+Times are milliseconds of any monotonic clock. The pool is not synchronized.
+*/
+typedef class IEC8705103DisturbancePool_ {
+ public:
+  typedef void (*Sender)(void *Context, int Bus, unsigned char Address, const void *pAsdu, size_t Size);
+  /*Data is 0 when the upload failed; otherwise it is only valid during the call*/
+  typedef void (*Listener)(void *Context, const DisturbanceUpload &Upload, const IEC8705103Manager::Disturbance *Data);
+
+  IEC8705103DisturbancePool_(Sender sender, void *SenderContext, unsigned int MaxUploads = 4,
+                             size_t MaxBytes = 64 << 20, size_t ExpectedBytes = 1 << 20,
+                             unsigned long long Timeout = 60000, unsigned int MaxAttempts = 2)
+      : sender(sender),
+        senderContext(SenderContext),
+        maxUploads(MaxUploads != 0 ? MaxUploads : 1),
+        maxBytes(MaxBytes),
+        expectedBytes(ExpectedBytes),
+        timeout(Timeout),
+        maxAttempts(MaxAttempts != 0 ? MaxAttempts : 1),
+        running(0),
+        listener(0),
+        listenerContext(0) {}
+
+  ~IEC8705103DisturbancePool_() {
+    for (size_t i = 0; i < devices.size(); i++) delete devices[i].manager;
+  }
+
+  void SetListener(Listener listener, void *Context) {
+    this->listener = listener;
+    listenerContext = Context;
+  }
+
+  /*Accounts a received ASDU. Returns true if it was disturbance data*/
+  bool OnAsdu(int Bus, unsigned char Address, const void *pAsdu, size_t Size, unsigned long long Now) {
+    ASDUView asdu(pAsdu, Size);
+    unsigned char type = asdu.TypeIdentification();
+    if (type < 23 || type > 31 || Bus < 0) return false;
+
+    if (type == 23) {
+      DisturbanceListView list;
+      if (!list.Bind(asdu)) return false;
+      Offer(DeviceOf(Bus, Address), pAsdu, Size);
+      Admit(Now);
+      return true;
+    }
+
+    int i = IndexOf(Bus, Address);
+    if (i >= 0 && type == 31 && devices[i].abortedAt != 0) {
+      devices[i].abortedAt = 0; /* End of the transfer aborted by us */
+      Admit(Now);
+      return true;
+    }
+    if (i < 0 || devices[i].upload.State != DisturbanceUpload::Running) return false;
+
+    Device &d = devices[i];
+    unsigned char reply[IEC8705103Manager::DisturbanceReplySize];
+    size_t size = 0;
+    bool finished = false;
+    bool result = d.manager->DisturbanceStep(pAsdu, Size, reply, &size, &finished);
+    if (size != 0) sender(senderContext, Bus, Address, reply, size);
+    d.lastActivity = Now;
+
+    if (type == 26 && result) {
+      const IEC8705103Manager::Disturbance &data = d.manager->GetDisturbanceData();
+      d.upload.Bytes = static_cast<size_t>(data.ChannelList.Count) * data.ChannelList.ChannelElements * sizeof(int) +
+                       MAX_DIST_COUNT * sizeof(IEC8705103Manager::DisturbanceChannelValues);
+      if (GetMemory() > maxBytes) {
+        Abort(static_cast<size_t>(i), Now);
+        Defer(static_cast<size_t>(i), Now);
+        Admit(Now);
+        return true;
+      }
+    }
+
+    if (finished || (!result && type != 29 && type != 30)) Finish(static_cast<size_t>(i), finished && result, Now);
+    return true;
+  }
+
+  /*The link layer lost the station: its upload fails now, it will be tried again*/
+  void OnStationLost(int Bus, unsigned char Address, unsigned long long Now) {
+    int i = IndexOf(Bus, Address);
+    if (i >= 0 && devices[i].upload.State == DisturbanceUpload::Running) Finish(static_cast<size_t>(i), false, Now);
+    Admit(Now);
+  }
+
+  /*The bus is gone for good: its uploads fail now and the faults of its devices are forgotten*/
+  void OnBusLost(int Bus, unsigned long long Now) {
+    for (size_t i = 0; i < devices.size(); i++) {
+      Device &d = devices[i];
+      if (d.upload.Bus != Bus) continue;
+      if (d.upload.State == DisturbanceUpload::Running) Finish(i, false, Now);
+      d.faults.clear();
+    }
+    Admit(Now);
+  }
+
+  /*Aborts silent uploads and starts waiting ones*/
+  void OnTick(unsigned long long Now) {
+    for (size_t i = 0; i < devices.size(); i++) {
+      Device &d = devices[i];
+      if (d.upload.State != DisturbanceUpload::Running || d.lastActivity + timeout > Now) continue;
+
+      Abort(i, Now);
+      Finish(i, false, Now);
+    }
+    Admit(Now);
+  }
+
+  unsigned int GetRunning() const { return running; }
+
+  /*Faults known and not uploaded yet*/
+  size_t GetWaiting() const {
+    size_t waiting = 0;
+    for (size_t i = 0; i < devices.size(); i++) {
+      const Device &d = devices[i];
+      for (size_t f = 0; f < d.faults.size(); f++)
+        waiting += IsWaiting(d.faults[f]) &&
+                   !(d.upload.State == DisturbanceUpload::Running && d.upload.FaultNumber == d.faults[f].FaultNumber);
+    }
+    return waiting;
+  }
+
+  /*Memory accounted to running uploads*/
+  size_t GetMemory() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < devices.size(); i++)
+      if (devices[i].upload.State == DisturbanceUpload::Running) bytes += Footprint(devices[i]);
+    return bytes;
+  }
+
+ private:
+  typedef struct Fault_ {
+    unsigned short FaultNumber;
+    unsigned char Index; /*In the last list*/
+    unsigned char Attempts;
+    bool Listed; /*Still in the last list, not being transmitted to another master*/
+    bool Done;
+    long long Time;
+    size_t Bytes; /*Memory of the record, 0 until an announcement (ASDU 26) has told it*/
+  } Fault;
+
+  typedef struct Device_ {
+    IEC8705103Manager *manager; /*Transfer state*/
+    std::vector<unsigned char> list; /*Last ASDU 23*/
+    std::vector<Fault> faults;
+    DisturbanceUpload upload;
+    unsigned long long lastActivity;
+    unsigned long long abortedAt; /*An abort is waiting for its end of transfer (ASDU 31), 0 if none*/
+  } Device;
+
+  /*Takes the faults of a list. Faults no longer listed are forgotten*/
+  void Offer(size_t i, const void *pAsdu, size_t Size) {
+    Device &d = devices[i];
+    d.list.assign(static_cast<const unsigned char *>(pAsdu), static_cast<const unsigned char *>(pAsdu) + Size);
+
+    DisturbanceListView list;
+    list.Bind(ASDUView(&d.list[0], d.list.size()));
+
+    std::vector<Fault> faults;
+    for (unsigned char e = 0; e < list.Count(); e++) {
+      Fault f;
+      f.FaultNumber = list.FaultNumber(e);
+      f.Index = e;
+      f.Attempts = 0;
+      f.Done = false;
+      f.Bytes = 0;
+      f.Listed = (list.FaultStatus(e) & 0x2) == 0; /*TM: being transmitted*/
+      if (!converter.FromCp56(list.Time(e), &f.Time)) f.Time = 0;
+
+      for (size_t k = 0; k < d.faults.size(); k++) {
+        if (d.faults[k].FaultNumber != f.FaultNumber) continue;
+        f.Attempts = d.faults[k].Attempts;
+        f.Done = d.faults[k].Done;
+        f.Bytes = d.faults[k].Bytes;
+      }
+      faults.push_back(f);
+    }
+    d.faults.swap(faults);
+  }
+
+  /*Starts uploads, newest fault first, while the pool has room*/
+  void Admit(unsigned long long Now) {
+    while (running < maxUploads) {
+      size_t memory = GetMemory();
+      int best = -1;
+      size_t bestFault = 0;
+      for (size_t i = 0; i < devices.size(); i++) {
+        if (devices[i].upload.State == DisturbanceUpload::Running) continue;
+        if (devices[i].abortedAt != 0 && devices[i].abortedAt + timeout > Now) continue;
+        for (size_t f = 0; f < devices[i].faults.size(); f++) {
+          const Fault &fault = devices[i].faults[f];
+          if (!IsWaiting(fault) || memory + (fault.Bytes != 0 ? fault.Bytes : expectedBytes) > maxBytes) continue;
+          if (best < 0 || fault.Time > devices[best].faults[bestFault].Time) {
+            best = static_cast<int>(i);
+            bestFault = f;
+          }
+        }
+      }
+      if (best < 0) return;
+
+      Device &d = devices[best];
+      Fault &fault = d.faults[bestFault];
+      fault.Attempts++;
+
+      unsigned char order[IEC8705103Manager::DisturbanceReplySize];
+      size_t size = 0;
+      if (!d.manager->SelectDisturbance(&d.list[0], d.list.size(), fault.Index, order, &size)) {
+        fault.Done = true;
+        continue;
+      }
+
+      d.upload.State = DisturbanceUpload::Running;
+      d.upload.FaultNumber = fault.FaultNumber;
+      d.upload.FaultTime = fault.Time;
+      d.upload.Started = Now;
+      d.upload.Finished = 0;
+      d.upload.Bytes = fault.Bytes;
+      d.lastActivity = Now;
+      d.abortedAt = 0;
+      running++;
+      sender(senderContext, d.upload.Bus, d.upload.Address, order, size);
+    }
+  }
+
+  /*Tells the device to abort its transfer (ASDU 24, TOO 3)*/
+  void Abort(size_t i, unsigned long long Now) {
+    Device &d = devices[i];
+    unsigned char abort[IEC8705103Manager::DisturbanceReplySize];
+    size_t size = d.manager->BuildDisturbanceOrder(3, 0, d.upload.FaultNumber, 0, abort);
+    sender(senderContext, d.upload.Bus, d.upload.Address, abort, size);
+    d.abortedAt = Now;
+  }
+
+  /*
+  The pool cannot hold the record now: the fault waits again with its size known, the attempt is not counted. A record
+  that never fits is given up
+  */
+  void Defer(size_t i, unsigned long long Now) {
+    Device &d = devices[i];
+    for (size_t f = 0; f < d.faults.size(); f++) {
+      Fault &fault = d.faults[f];
+      if (fault.FaultNumber != d.upload.FaultNumber) continue;
+      fault.Bytes = d.upload.Bytes;
+      fault.Attempts = static_cast<unsigned char>(d.upload.Bytes > maxBytes ? maxAttempts : fault.Attempts - 1u);
+    }
+    if (d.upload.Bytes > maxBytes) {
+      Finish(i, false, Now);
+      return;
+    }
+
+    d.upload.State = 0;
+    d.upload.Finished = Now;
+    running--;
+    d.manager->ReleaseDisturbanceData();
+  }
+
+  void Finish(size_t i, bool Completed, unsigned long long Now) {
+    Device &d = devices[i];
+    d.upload.State = Completed ? DisturbanceUpload::Completed : DisturbanceUpload::Failed;
+    d.upload.Finished = Now;
+    running--;
+
+    for (size_t f = 0; f < d.faults.size(); f++)
+      if (d.faults[f].FaultNumber == d.upload.FaultNumber && (Completed || d.faults[f].Attempts >= maxAttempts))
+        d.faults[f].Done = true;
+
+    if (listener != 0) listener(listenerContext, d.upload, Completed ? &d.manager->GetDisturbanceData() : 0);
+    d.manager->ReleaseDisturbanceData();
+  }
+
+  bool IsWaiting(const Fault &f) const { return f.Listed && !f.Done && f.Attempts < maxAttempts; }
+
+  size_t Footprint(const Device &d) const {
+    size_t bytes = d.upload.Bytes != 0 ? d.upload.Bytes : expectedBytes;
+    size_t held = d.manager->GetDisturbanceMemory();
+    return held > bytes ? held : bytes;
+  }
+
+  size_t DeviceOf(int Bus, unsigned char Address) {
+    int i = IndexOf(Bus, Address);
+    if (i >= 0) return static_cast<size_t>(i);
+
+    if (static_cast<size_t>(Bus) >= index.size()) index.resize(Bus + 1);
+    if (index[Bus].empty()) index[Bus].resize(256, -1);
+    index[Bus][Address] = static_cast<int>(devices.size());
+
+    Device d;
+    d.manager = new IEC8705103Manager(0, Address);
+    d.upload.Bus = Bus;
+    d.upload.Address = Address;
+    d.upload.State = 0;
+    d.upload.FaultNumber = 0;
+    d.upload.FaultTime = 0;
+    d.upload.Started = 0;
+    d.upload.Finished = 0;
+    d.upload.Bytes = 0;
+    d.lastActivity = 0;
+    d.abortedAt = 0;
+    devices.push_back(d);
+    return devices.size() - 1;
+  }
+
+  int IndexOf(int Bus, unsigned char Address) const {
+    if (Bus < 0 || static_cast<size_t>(Bus) >= index.size() || index[Bus].empty()) return -1;
+    return index[Bus][Address];
+  }
+
+  // I won't let you copy this object.
+  IEC8705103DisturbancePool_(const IEC8705103DisturbancePool_ &);
+  IEC8705103DisturbancePool_ &operator=(const IEC8705103DisturbancePool_ &);
+
+  Sender sender;
+  void *senderContext;
+  const unsigned int maxUploads;
+  const size_t maxBytes;
+  const size_t expectedBytes;
+  const unsigned long long timeout;
+  const unsigned int maxAttempts;
+
+  std::vector<Device> devices;
+  std::vector<std::vector<int> > index; /*Device of each bus and address, -1 if none*/
+  unsigned int running;
+  IEC8705103TimeConverter converter;
+
+  Listener listener;
+  void *listenerContext;
+
+} IEC8705103DisturbancePool; /*Bounded concurrent disturbance uploads*/
+
+#ifdef __linux__
+
+/*
+Runs an IEC8705103DisturbancePool on the lines of an IEC87052EventDriver: the bus of a device is the id of its line.
+Orders are queued on the line of the device; every event is also forwarded to Next (if any). The pool is shared by the
+driver threads, hence guarded by a mutex; the listener runs with it held and must not call the engine.
+*/
+class IEC8705103DisturbanceEngine : public IEC87052EventSink {
+ public:
+  IEC8705103DisturbanceEngine(unsigned int MaxUploads = 4, size_t MaxBytes = 64 << 20,
+                              size_t ExpectedBytes = 1 << 20, unsigned long long Timeout = 60000,
+                              IEC87052EventSink *Next = 0)
+      : pool(Send, this, MaxUploads, MaxBytes, ExpectedBytes, Timeout), next(Next) {}
+
+  /*Adds a line. Must be called before the driver starts*/
+  void AddLine(IEC87052LineSession *line) {
+    size_t id = static_cast<size_t>(line->GetId());
+    if (lines.size() <= id) lines.resize(id + 1, 0);
+    lines[id] = line;
+  }
+
+  void SetListener(IEC8705103DisturbancePool::Listener listener, void *Context) {
+    std::lock_guard<std::mutex> guard(lock);
+    pool.SetListener(listener, Context);
+  }
+
+  unsigned int GetRunning() {
+    std::lock_guard<std::mutex> guard(lock);
+    return pool.GetRunning();
+  }
+
+  size_t GetWaiting() {
+    std::lock_guard<std::mutex> guard(lock);
+    return pool.GetWaiting();
+  }
+
+  virtual void OnAsdu(int Line, unsigned char Address, const void *pAsdu, size_t Size) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      pool.OnAsdu(Line, Address, pAsdu, Size, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnAsdu(Line, Address, pAsdu, Size);
+  }
+
+  virtual void OnStationState(int Line, unsigned char Address, bool Online) {
+    if (!Online) {
+      std::lock_guard<std::mutex> guard(lock);
+      pool.OnStationLost(Line, Address, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnStationState(Line, Address, Online);
+  }
+
+  virtual void OnSendComplete(int Line, unsigned char Address, bool Confirmed) {
+    if (next != 0) next->OnSendComplete(Line, Address, Confirmed);
+  }
+
+  virtual void OnTick(int Line, unsigned long long Now) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      pool.OnTick(Now);
+    }
+    if (next != 0) next->OnTick(Line, Now);
+  }
+
+  virtual void OnLineDown(int Line) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      pool.OnBusLost(Line, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnLineDown(Line);
+  }
+
+ private:
+  static void Send(void *Context, int Bus, unsigned char Address, const void *pAsdu, size_t Size) {
+    IEC8705103DisturbanceEngine *engine = static_cast<IEC8705103DisturbanceEngine *>(Context);
+    if (Bus >= 0 && static_cast<size_t>(Bus) < engine->lines.size() && engine->lines[Bus] != 0)
+      engine->lines[Bus]->Send(Address, pAsdu, Size);
+  }
+
+  IEC8705103DisturbancePool pool;
+  IEC87052EventSink *next;
+  std::vector<IEC87052LineSession *> lines;
+  std::mutex lock;
+};
+
+#endif  // __linux__
+
+#endif  // IEC8705103DISTURBANCEPOOL_H
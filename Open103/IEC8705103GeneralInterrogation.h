@@ -0,0 +1,437 @@
+#ifndef IEC8705103GENERALINTERROGATION_H
+#define IEC8705103GENERALINTERROGATION_H
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Manager.h"
+
+#ifdef __linux__
+#include <mutex>
+#include "IEC87052EventDriver.h"
+#endif
+
+/*General interrogation of one device*/
+typedef struct GIDevice_ {
+  enum State { Idle, Queued, Running, Completed, TimedOut };
+
+  int Bus;
+  unsigned char Address;
+  unsigned char State;
+  unsigned char Scan;           /*Scan number of the running (or last) attempt*/
+  unsigned int Attempts;        /*ASDU 7 sent for the last request*/
+  unsigned int Responses;       /*ASDUs with cause of transmission 9 received for the last request*/
+  unsigned long long Requested; /*Milliseconds: request queued*/
+  unsigned long long Started;   /*First ASDU 7 sent*/
+  unsigned long long Finished;  /*Termination received or last attempt given up*/
+
+  /*Milliseconds from the first ASDU 7 to termination*/
+  unsigned long long Duration() const { return Finished - Started; }
+} GIDevice;
+
+/*Fleet-wide outcome of the interrogations requested so far*/
+typedef struct GIStatistics_ {
+  unsigned int Devices;
+  unsigned int Queued;
+  unsigned int Running;
+  unsigned int Completed;
+  unsigned int TimedOut;
+  unsigned long long Duration;    /*First request to last completion or give up (0 while any is pending)*/
+  unsigned long long MinDuration; /*Of completed devices*/
+  unsigned long long MaxDuration;
+  unsigned long long AverageDuration;
+} GIStatistics;
+
+/*
+General interrogation of many devices at once.
+
+The tracker decides who is interrogated and when; it does no I/O. For each bus at most ConcurrencyPerBus
+interrogations run together, the others wait in request order. NextToSend() hands out the device and scan number of
+the next ASDU 7 to send; every received ASDU goes to OnAsdu(): those with cause of transmission 9 from a running
+device are counted, and the ASDU 8 with the same scan number ends its interrogation (a termination with another scan
+number belongs to an earlier attempt and is ignored). An interrogation not ended within Timeout, or whose station is
+lost, is tried again up to MaxAttempts times, then given up.
+Times are milliseconds of any monotonic clock. The tracker is not synchronized.
+*/
+typedef class IEC8705103GITracker_ {
+ public:
+  typedef void (*Listener)(void *Context, const GIDevice &Device); /*Called when a device completes or is given up*/
+
+  IEC8705103GITracker_(unsigned int ConcurrencyPerBus = 4, unsigned long long Timeout = 30000,
+                       unsigned int MaxAttempts = 2)
+      : concurrency(ConcurrencyPerBus != 0 ? ConcurrencyPerBus : 1),
+        timeout(Timeout),
+        maxAttempts(MaxAttempts != 0 ? MaxAttempts : 1),
+        scan(0),
+        fleetStart(0),
+        listener(0),
+        listenerContext(0) {}
+
+  void SetListener(Listener listener, void *Context) {
+    this->listener = listener;
+    listenerContext = Context;
+  }
+
+  /*Adds a device to the fleet. Returns false if it is already known*/
+  bool AddDevice(int Bus, unsigned char Address) {
+    if (Bus < 0) return false;
+    if (static_cast<size_t>(Bus) >= buses.size()) buses.resize(Bus + 1);
+
+    BusState &b = buses[Bus];
+    if (b.index.empty()) b.index.resize(256, -1);
+    if (b.index[Address] >= 0) return false;
+
+    GIDevice d;
+    d.Bus = Bus;
+    d.Address = Address;
+    d.State = GIDevice::Idle;
+    d.Scan = 0;
+    d.Attempts = 0;
+    d.Responses = 0;
+    d.Requested = 0;
+    d.Started = 0;
+    d.Finished = 0;
+
+    b.index[Address] = static_cast<int>(devices.size());
+    devices.push_back(d);
+    deadlines.push_back(0);
+    return true;
+  }
+
+  /*Queues the interrogation of a device. Returns false if unknown or already queued / running*/
+  bool Request(int Bus, unsigned char Address, unsigned long long Now) {
+    int i = IndexOf(Bus, Address);
+    if (i < 0) return false;
+    if (!AnyPending()) fleetStart = Now;
+    return Queue(static_cast<size_t>(i), Now);
+  }
+
+  /*Queues every device that is not already queued or running (e.g. after a restart). Fleet statistics restart*/
+  void RequestAll(unsigned long long Now) {
+    if (!AnyPending()) fleetStart = Now;
+    for (size_t i = 0; i < devices.size(); i++) Queue(i, Now);
+  }
+
+  /*
+  Next ASDU 7 to send on Bus, if the bus has a free slot and a queued device.
+  The caller sends BuildGeneralInterrogation(*Address, *Scan, ...) to the device.
+  */
+  bool NextToSend(int Bus, unsigned long long Now, unsigned char *Address, unsigned char *Scan) {
+    BusState *b = BusOf(Bus);
+    if (b == 0 || b->queue.empty() || b->running.size() >= concurrency) return false;
+
+    size_t i = b->queue.front();
+    b->queue.pop_front();
+    b->running.push_back(i);
+
+    GIDevice &d = devices[i];
+    if (d.Attempts == 0) d.Started = Now;
+    d.Attempts++;
+    d.State = GIDevice::Running;
+    d.Scan = scan++;
+    deadlines[i] = Now + timeout;
+
+    *Address = d.Address;
+    *Scan = d.Scan;
+    return true;
+  }
+
+  /*Accounts a received ASDU. Returns true if it belongs to a running interrogation*/
+  bool OnAsdu(int Bus, unsigned char Address, const void *pAsdu, size_t Size, unsigned long long Now) {
+    int i = IndexOf(Bus, Address);
+    if (i < 0 || devices[i].State != GIDevice::Running) return false;
+
+    GIDevice &d = devices[i];
+    ASDUView asdu(pAsdu, Size);
+    ScanView termination;
+
+    if (asdu.TypeIdentification() == 8 && termination.Bind(asdu)) {
+      if (termination.ScanNumber() != d.Scan) return false;
+      Finish(static_cast<size_t>(i), GIDevice::Completed, Now);
+      return true;
+    }
+
+    if (asdu.CauseOfTransmission() != 9) return false;
+    d.Responses++;
+    return true;
+  }
+
+  /*The link layer lost the station: its running interrogation fails now instead of at timeout*/
+  void OnStationLost(int Bus, unsigned char Address, unsigned long long Now) {
+    int i = IndexOf(Bus, Address);
+    if (i >= 0 && devices[i].State == GIDevice::Running) Retry(static_cast<size_t>(i), Now);
+  }
+
+  /*The bus is gone for good: its queued and running interrogations are given up now*/
+  void OnBusLost(int Bus, unsigned long long Now) {
+    BusState *b = BusOf(Bus);
+    if (b == 0) return;
+
+    std::vector<size_t> lost(b->running.begin(), b->running.end());
+    lost.insert(lost.end(), b->queue.begin(), b->queue.end());
+    b->running.clear();
+    b->queue.clear();
+    for (size_t k = 0; k < lost.size(); k++) Finish(lost[k], GIDevice::TimedOut, Now);
+  }
+
+  /*Expires running interrogations*/
+  void OnTick(unsigned long long Now) {
+    for (size_t b = 0; b < buses.size(); b++) {
+      std::vector<size_t> &running = buses[b].running;
+      for (size_t r = running.size(); r-- > 0;) /*Retry() moves the last one here: already checked*/
+        if (deadlines[running[r]] <= Now) Retry(running[r], Now);
+    }
+  }
+
+  const GIDevice *Find(int Bus, unsigned char Address) const {
+    int i = IndexOf(Bus, Address);
+    return i < 0 ? 0 : &devices[i];
+  }
+
+  /*True when nothing is queued or running*/
+  bool IsIdle() const { return !AnyPending(); }
+
+  GIStatistics GetStatistics() const {
+    GIStatistics s;
+    memset(&s, 0, sizeof(s));
+    s.Devices = static_cast<unsigned int>(devices.size());
+
+    unsigned long long last = fleetStart;
+    unsigned long long total = 0;
+    for (size_t i = 0; i < devices.size(); i++) {
+      const GIDevice &d = devices[i];
+      switch (d.State) {
+        case GIDevice::Queued:
+          s.Queued++;
+          break;
+        case GIDevice::Running:
+          s.Running++;
+          break;
+        case GIDevice::Completed:
+          s.Completed++;
+          total += d.Duration();
+          if (s.Completed == 1 || d.Duration() < s.MinDuration) s.MinDuration = d.Duration();
+          if (d.Duration() > s.MaxDuration) s.MaxDuration = d.Duration();
+          if (d.Finished > last) last = d.Finished;
+          break;
+        case GIDevice::TimedOut:
+          s.TimedOut++;
+          if (d.Finished > last) last = d.Finished;
+          break;
+      }
+    }
+
+    if (s.Completed != 0) s.AverageDuration = total / s.Completed;
+    if (s.Queued == 0 && s.Running == 0) s.Duration = last - fleetStart;
+    return s;
+  }
+
+ private:
+  typedef struct BusState_ {
+    std::vector<int> index;   /*Device of each address, -1 if none*/
+    std::deque<size_t> queue; /*Waiting for a free slot*/
+    std::vector<size_t> running;
+  } BusState;
+
+  bool Queue(size_t i, unsigned long long Now) {
+    GIDevice &d = devices[i];
+    if (IsPending(d)) return false;
+
+    d.State = GIDevice::Queued;
+    d.Attempts = 0;
+    d.Responses = 0;
+    d.Requested = Now;
+    d.Started = 0;
+    d.Finished = 0;
+    buses[d.Bus].queue.push_back(i);
+    return true;
+  }
+
+  /*Failed attempt: queued again (at the front, it already waited its turn) or given up*/
+  void Retry(size_t i, unsigned long long Now) {
+    GIDevice &d = devices[i];
+    if (d.Attempts >= maxAttempts) {
+      Finish(i, GIDevice::TimedOut, Now);
+      return;
+    }
+
+    Release(i);
+    d.State = GIDevice::Queued;
+    buses[d.Bus].queue.push_front(i);
+  }
+
+  void Finish(size_t i, unsigned char State, unsigned long long Now) {
+    Release(i);
+
+    GIDevice &d = devices[i];
+    d.State = State;
+    d.Finished = Now;
+    if (listener != 0) listener(listenerContext, d);
+  }
+
+  void Release(size_t i) {
+    std::vector<size_t> &running = buses[devices[i].Bus].running;
+    for (size_t r = 0; r < running.size(); r++) {
+      if (running[r] != i) continue;
+      running[r] = running.back();
+      running.pop_back();
+      return;
+    }
+  }
+
+  static bool IsPending(const GIDevice &d) { return d.State == GIDevice::Queued || d.State == GIDevice::Running; }
+
+  bool AnyPending() const {
+    for (size_t b = 0; b < buses.size(); b++)
+      if (!buses[b].queue.empty() || !buses[b].running.empty()) return true;
+    return false;
+  }
+
+  BusState *BusOf(int Bus) {
+    if (Bus < 0 || static_cast<size_t>(Bus) >= buses.size()) return 0;
+    return &buses[Bus];
+  }
+
+  int IndexOf(int Bus, unsigned char Address) const {
+    if (Bus < 0 || static_cast<size_t>(Bus) >= buses.size() || buses[Bus].index.empty()) return -1;
+    return buses[Bus].index[Address];
+  }
+
+  const unsigned int concurrency;
+  const unsigned long long timeout;
+  const unsigned int maxAttempts;
+
+  std::vector<GIDevice> devices;
+  std::vector<unsigned long long> deadlines; /*Of the running attempt of each device*/
+  std::vector<BusState> buses;
+  unsigned char scan; /*Next scan number, shared by every device*/
+  unsigned long long fleetStart;
+
+  Listener listener;
+  void *listenerContext;
+
+} IEC8705103GITracker; /*Concurrent general interrogation of a fleet*/
+
+#ifdef __linux__
+
+/*
+Runs an IEC8705103GITracker on the lines of an IEC87052EventDriver: the bus of a device is the id of its line.
+ASDU 7 are queued on the line between two transactions (OnTick) and as soon as a slot frees up; every event is also
+forwarded to Next (if any). The tracker is shared by the driver threads, hence guarded by a mutex.
+*/
+class IEC8705103GIEngine : public IEC87052EventSink {
+ public:
+  IEC8705103GIEngine(unsigned int ConcurrencyPerBus = 4, unsigned long long Timeout = 30000,
+                     unsigned int MaxAttempts = 2, IEC87052EventSink *Next = 0)
+      : tracker(ConcurrencyPerBus, Timeout, MaxAttempts), next(Next) {}
+
+  /*Adds a device of a line. Must be called before the driver starts*/
+  bool AddStation(IEC87052LineSession *line, unsigned char Address) {
+    size_t id = static_cast<size_t>(line->GetId());
+    if (lines.size() <= id) lines.resize(id + 1, 0);
+    lines[id] = line;
+
+    std::lock_guard<std::mutex> guard(lock);
+    return tracker.AddDevice(line->GetId(), Address);
+  }
+
+  /*Interrogates every device (e.g. after a restart)*/
+  void RequestAll() {
+    std::lock_guard<std::mutex> guard(lock);
+    tracker.RequestAll(IEC87052EventDriver::Now());
+  }
+
+  bool Request(int Line, unsigned char Address) {
+    std::lock_guard<std::mutex> guard(lock);
+    return tracker.Request(Line, Address, IEC87052EventDriver::Now());
+  }
+
+  void SetListener(IEC8705103GITracker::Listener listener, void *Context) {
+    std::lock_guard<std::mutex> guard(lock);
+    tracker.SetListener(listener, Context);
+  }
+
+  bool IsIdle() {
+    std::lock_guard<std::mutex> guard(lock);
+    return tracker.IsIdle();
+  }
+
+  GIStatistics GetStatistics() {
+    std::lock_guard<std::mutex> guard(lock);
+    return tracker.GetStatistics();
+  }
+
+  /*Copy of the state of a device. Returns false if unknown*/
+  bool GetDevice(int Line, unsigned char Address, GIDevice *Device) {
+    std::lock_guard<std::mutex> guard(lock);
+    const GIDevice *d = tracker.Find(Line, Address);
+    if (d == 0) return false;
+    *Device = *d;
+    return true;
+  }
+
+  virtual void OnAsdu(int Line, unsigned char Address, const void *pAsdu, size_t Size) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      unsigned long long now = IEC87052EventDriver::Now();
+      if (tracker.OnAsdu(Line, Address, pAsdu, Size, now)) SendNext(Line, now);
+    }
+    if (next != 0) next->OnAsdu(Line, Address, pAsdu, Size);
+  }
+
+  virtual void OnStationState(int Line, unsigned char Address, bool Online) {
+    if (!Online) {
+      std::lock_guard<std::mutex> guard(lock);
+      unsigned long long now = IEC87052EventDriver::Now();
+      tracker.OnStationLost(Line, Address, now);
+      SendNext(Line, now);
+    }
+    if (next != 0) next->OnStationState(Line, Address, Online);
+  }
+
+  virtual void OnSendComplete(int Line, unsigned char Address, bool Confirmed) {
+    if (next != 0) next->OnSendComplete(Line, Address, Confirmed);
+  }
+
+  virtual void OnTick(int Line, unsigned long long Now) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      tracker.OnTick(Now);
+      SendNext(Line, Now);
+    }
+    if (next != 0) next->OnTick(Line, Now);
+  }
+
+  virtual void OnLineDown(int Line) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      tracker.OnBusLost(Line, IEC87052EventDriver::Now());
+    }
+    if (next != 0) next->OnLineDown(Line);
+  }
+
+ private:
+  /*Queues ASDU 7 on the line for every slot free. Called with lock held*/
+  void SendNext(int Line, unsigned long long Now) {
+    if (Line < 0 || static_cast<size_t>(Line) >= lines.size() || lines[Line] == 0) return;
+
+    unsigned char address;
+    unsigned char scan;
+    while (tracker.NextToSend(Line, Now, &address, &scan)) {
+      unsigned char buffer[IEC8705103Manager::GeneralInterrogationSize];
+      size_t size = IEC8705103Manager::BuildGeneralInterrogation(address, scan, buffer);
+      lines[Line]->Send(address, buffer, size);
+    }
+  }
+
+  IEC8705103GITracker tracker;
+  IEC87052EventSink *next;
+  std::vector<IEC87052LineSession *> lines;
+  std::mutex lock;
+};
+
+#endif  // __linux__
+
+#endif  // IEC8705103GENERALINTERROGATION_H
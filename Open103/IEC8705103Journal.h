@@ -0,0 +1,639 @@
+#ifndef IEC8705103JOURNAL_H
+#define IEC8705103JOURNAL_H
+#pragma once
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IEC8705103Soe.h"
+#include "IFT12.h"
+
+/*What a journal record holds*/
+enum JournalKind { JournalEvent = 1, JournalAsdu = 2 };
+
+/*A record read back from the journal. Payload is only valid during the Reader call*/
+typedef struct JournalRecord_ {
+  unsigned long long Sequence; /*1 for the first record ever written, then +1*/
+  long long Time;              /*Device time (events) or reception time (ASDUs), UTC nanoseconds*/
+  long long Received;
+  unsigned char Address;
+  unsigned char Kind; /*JournalKind*/
+  const unsigned char *Payload;
+  size_t Size;
+} JournalRecord;
+
+/*
+Durable append only journal of decoded events and raw ASDUs, to survive a power cycle between the link layer
+acknowledging an ASDU and the application processing it.
+
+Records are copied into a memory mapped segment file (preallocated, SegmentSize bytes); when one is full the next
+one, created in advance by the flusher thread, takes its place. Appending is a copy under a mutex and never waits for
+the disk: a flusher thread syncs everything written so far at once (group commit) when the oldest unsynced record is
+LatencyBudget milliseconds old, or earlier when MaxPending bytes are waiting. WaitDurable() blocks until a record is
+on disk.
+Each record carries its sequence number and a CRC32: Open() scans the segments and resumes after the last intact
+record, discarding a torn tail. The same scan rebuilds the sparse index kept in memory: one entry per IndexInterval
+records with the time range and the equipment they contain, so Query() reads only the blocks that can match.
+*/
+typedef class IEC8705103Journal_ {
+ public:
+  typedef void (*Reader)(void *Context, const JournalRecord &Record);
+
+  IEC8705103Journal_(const std::string &Directory, size_t SegmentSize = 64 << 20, unsigned int LatencyBudget = 10,
+                     size_t MaxPending = 1 << 20, unsigned int IndexInterval = 1024)
+      : directory(Directory), segmentSize(SegmentSize), latencyBudget(LatencyBudget), maxPending(MaxPending),
+        indexInterval(IndexInterval), opened(false), stopping(false), failed(false), preparing(false),
+        spareFailed(false), nextSequence(1), written(0), durable(0) {
+    for (unsigned int i = 0; i < 256; i++) {
+      unsigned int c = i;
+      for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      crcTable[i] = c;
+    }
+    current.fd = -1;
+    current.base = 0;
+    spare.fd = -1;
+    spare.base = 0;
+  }
+
+  ~IEC8705103Journal_() { Close(); }
+
+  /*Recovers the segments found in the directory (created if missing) and starts the flusher*/
+  bool Open() {
+    if (opened) return true;
+    mkdir(directory.c_str(), 0755);
+
+    std::vector<unsigned long long> numbers;
+    if (!ListSegments(&numbers)) {
+      TRACEENDL("Unable to read journal directory");
+      return false;
+    }
+
+    for (size_t i = 0; i < numbers.size(); i++)
+      if (!Recover(numbers[i], i + 1 == numbers.size())) return false;
+
+    if (current.base == 0 && !Rotate(numbers.empty() ? 1 : numbers.back() + 1)) return false;
+
+    durable = nextSequence - 1;
+    written = durable;
+    opened = true;
+    stopping = false;
+    failed = false;
+    preparing = false;
+    spareFailed = false;
+    flusher = std::thread(&IEC8705103Journal_::Flusher, this);
+    return true;
+  }
+
+  /*Syncs what is pending, stops the flusher and releases the segments. Open() can then recover them again*/
+  void Close() {
+    if (!opened) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wakeFlusher.notify_one();
+    flusher.join();
+
+    for (size_t i = 0; i < retired.size(); i++) Unmap(retired[i]);
+    retired.clear();
+    Unmap(current);
+    if (spare.base != 0) {
+      Unmap(spare);
+      unlink(SegmentPath(spare.number).c_str()); /*Empty: not worth recovering*/
+    }
+
+    index.clear();
+    nextSequence = 1;
+    written = 0;
+    durable = 0;
+    opened = false;
+  }
+
+  /*Appends an event. Returns its sequence number, 0 on failure*/
+  unsigned long long AppendEvent(const SoeEvent &Event) {
+    unsigned char payload[EventPayloadSize];
+    payload[0] = Event.Type;
+    payload[1] = Event.CauseOfTransmission;
+    payload[2] = Event.FunctionType;
+    payload[3] = Event.InformationNumber;
+    payload[4] = Event.DPI;
+    payload[5] = Event.SupplementaryInformation;
+    payload[6] = static_cast<unsigned char>(Event.RelativeTime);
+    payload[7] = static_cast<unsigned char>(Event.RelativeTime >> 8);
+    payload[8] = static_cast<unsigned char>(Event.FaultNumber);
+    payload[9] = static_cast<unsigned char>(Event.FaultNumber >> 8);
+    return Append(JournalEvent, Event.Address, Event.Time, Event.Received, payload, sizeof(payload));
+  }
+
+  /*Appends an ASDU as received from Address (e.g. straight from GetNextADSU)*/
+  unsigned long long AppendAsdu(unsigned char Address, const void *pAsdu, size_t Size, long long ReceivedNs) {
+    return Append(JournalAsdu, Address, ReceivedNs, ReceivedNs, pAsdu, Size);
+  }
+
+  /*Size must not be 0: a record with size 0 ends its segment*/
+  unsigned long long Append(unsigned char Kind, unsigned char Address, long long Time, long long Received,
+                            const void *pPayload, size_t Size) {
+    if (Size == 0) {
+      TRACEENDL("Empty journal record");
+      return 0;
+    }
+
+    size_t length = Align(HeaderSize + Size);
+    if (length > segmentSize - SegmentHeaderSize) {
+      TRACEENDL("Record larger than a journal segment");
+      return 0;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!opened || failed) return 0;
+    if (current.written + length > current.size && !NextSegment(lock)) return 0;
+    if (!opened || failed) return 0;
+
+    unsigned long long sequence = nextSequence++;
+    unsigned char *p = current.base + current.written;
+    Put(p + 8, sequence);
+    Put(p + 16, static_cast<unsigned long long>(Time));
+    Put(p + 24, static_cast<unsigned long long>(Received));
+    p[32] = Address;
+    p[33] = Kind;
+    memset(p + 34, 0, 6);
+    memcpy(p + HeaderSize, pPayload, Size);
+    memset(p + HeaderSize + Size, 0, length - HeaderSize - Size);
+    Put32(p + 4, Crc(p + 8, HeaderSize - 8 + Size));
+    Put32(p, static_cast<unsigned int>(Size)); /*Written last: a record with Size 0 ends the segment*/
+
+    Index(current.number, current.written, length, Time, Address);
+    current.written += length;
+    written = sequence;
+
+    bool first = current.written - current.synced == length;
+    if (first) pendingSince = std::chrono::steady_clock::now();
+    bool urgent = current.written - current.synced >= maxPending;
+    lock.unlock();
+
+    if (first || urgent) wakeFlusher.notify_one();
+    return sequence;
+  }
+
+  /*Waits until Sequence is on disk, at most Timeout milliseconds. False on timeout or I/O error*/
+  bool WaitDurable(unsigned long long Sequence, unsigned int Timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return synced.wait_for(lock, std::chrono::milliseconds(Timeout),
+                           [&] { return durable >= Sequence || failed; }) &&
+           !failed;
+  }
+
+  /*Last sequence number on disk*/
+  unsigned long long GetDurable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return durable;
+  }
+
+  /*
+  Calls Reader for every record with From <= Time <= To, of Address (or of every equipment with Address < 0), in
+  the order they were written. Returns how many.
+  */
+  size_t Query(long long From, long long To, int Address, Reader Read, void *Context) {
+    if (Address > 255) return 0;
+
+    std::vector<Block> blocks;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 0; i < index.size(); i++) {
+        const Block &b = index[i];
+        if (b.MaxTime < From || b.MinTime > To) continue;
+        if (Address >= 0 && (b.Devices[Address >> 5] & (1u << (Address & 31))) == 0) continue;
+        blocks.push_back(b);
+      }
+    }
+
+    size_t count = 0;
+    int fd = -1;
+    unsigned long long number = 0;
+    std::vector<unsigned char> buffer;
+    for (size_t i = 0; i < blocks.size(); i++) {
+      const Block &b = blocks[i];
+      if (fd < 0 || number != b.Segment) {
+        if (fd >= 0) close(fd);
+        number = b.Segment;
+        fd = open(SegmentPath(number).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+      }
+
+      buffer.resize(b.Length);
+      if (pread(fd, &buffer[0], b.Length, static_cast<off_t>(b.Offset)) != static_cast<ssize_t>(b.Length)) continue;
+
+      for (size_t offset = 0; offset < b.Length;) {
+        JournalRecord record;
+        size_t length = Parse(&buffer[offset], b.Length - offset, 0, &record);
+        if (length == 0) break;
+        offset += length;
+
+        if (record.Time < From || record.Time > To) continue;
+        if (Address >= 0 && record.Address != Address) continue;
+        Read(Context, record);
+        count++;
+      }
+    }
+    if (fd >= 0) close(fd);
+    return count;
+  }
+
+  /*Event of a JournalEvent record*/
+  static bool DecodeEvent(const JournalRecord &Record, SoeEvent *Event) {
+    if (Record.Kind != JournalEvent || Record.Size < EventPayloadSize) return false;
+
+    const unsigned char *p = Record.Payload;
+    memset(Event, 0, sizeof(SoeEvent));
+    Event->Time = Record.Time;
+    Event->Received = Record.Received;
+    Event->Address = Record.Address;
+    Event->Type = p[0];
+    Event->CauseOfTransmission = p[1];
+    Event->FunctionType = p[2];
+    Event->InformationNumber = p[3];
+    Event->DPI = p[4];
+    Event->SupplementaryInformation = p[5];
+    Event->RelativeTime = static_cast<unsigned short>(p[6] | (p[7] << 8));
+    Event->FaultNumber = static_cast<unsigned short>(p[8] | (p[9] << 8));
+    return true;
+  }
+
+ private:
+  /*
+  Segment: 8 bytes magic, 8 bytes number, then records. Record (little endian, 8 byte aligned):
+  payload size (4), CRC32 of the rest (4), sequence (8), time (8), received (8), address (1), kind (1), reserved (6),
+  payload.
+  */
+  static const size_t SegmentHeaderSize = 16;
+  static const size_t HeaderSize = 40;
+  static const size_t EventPayloadSize = 10;
+
+  typedef struct Segment_ {
+    int fd;
+    unsigned char *base;
+    unsigned long long number;
+    size_t size;
+    size_t written;
+    size_t synced;
+  } Segment;
+
+  typedef struct Block_ {
+    unsigned long long Segment;
+    size_t Offset;
+    size_t Length;
+    long long MinTime;
+    long long MaxTime;
+    unsigned int Records;
+    unsigned int Devices[8]; /*Bit set of the addresses in the block*/
+  } Block;
+
+  static size_t Align(size_t Size) { return (Size + 7) & ~static_cast<size_t>(7); }
+
+  static void Put32(unsigned char *p, unsigned int v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<unsigned char>(v >> (8 * i));
+  }
+
+  static void Put(unsigned char *p, unsigned long long v) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<unsigned char>(v >> (8 * i));
+  }
+
+  static unsigned int Get32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24);
+  }
+
+  static unsigned long long Get(const unsigned char *p) {
+    unsigned long long v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+  }
+
+  unsigned int Crc(const unsigned char *p, size_t Size) const {
+    unsigned int c = 0xFFFFFFFF;
+    for (size_t i = 0; i < Size; i++) c = crcTable[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFF;
+  }
+
+  /*
+  Record at p with Available bytes after it. Sequence: expected sequence number, 0 for any.
+  Returns the record length, 0 if there is no intact record.
+  */
+  size_t Parse(const unsigned char *p, size_t Available, unsigned long long Sequence, JournalRecord *Record) const {
+    if (Available < HeaderSize) return 0;
+
+    size_t size = Get32(p);
+    size_t length = Align(HeaderSize + size);
+    if (size == 0 || length > Available) return 0;
+    if (Sequence != 0 && Get(p + 8) != Sequence) return 0;
+    if (Crc(p + 8, HeaderSize - 8 + size) != Get32(p + 4)) return 0;
+
+    Record->Sequence = Get(p + 8);
+    Record->Time = static_cast<long long>(Get(p + 16));
+    Record->Received = static_cast<long long>(Get(p + 24));
+    Record->Address = p[32];
+    Record->Kind = p[33];
+    Record->Payload = p + HeaderSize;
+    Record->Size = size;
+    return length;
+  }
+
+  void Index(unsigned long long Number, size_t Offset, size_t Length, long long Time, unsigned char Address) {
+    if (index.empty() || index.back().Segment != Number || index.back().Records == indexInterval) {
+      Block b;
+      memset(&b, 0, sizeof(b));
+      b.Segment = Number;
+      b.Offset = Offset;
+      b.MinTime = Time;
+      b.MaxTime = Time;
+      index.push_back(b);
+    }
+
+    Block &b = index.back();
+    b.Length = Offset + Length - b.Offset;
+    b.MinTime = std::min(b.MinTime, Time);
+    b.MaxTime = std::max(b.MaxTime, Time);
+    b.Records++;
+    b.Devices[Address >> 5] |= 1u << (Address & 31);
+  }
+
+  std::string SegmentPath(unsigned long long Number) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/journal-%010llu.log", Number);
+    return directory + name;
+  }
+
+  bool ListSegments(std::vector<unsigned long long> *Numbers) const {
+    DIR *dir = opendir(directory.c_str());
+    if (dir == 0) return false;
+
+    while (dirent *entry = readdir(dir)) {
+      unsigned long long number;
+      char end;
+      if (sscanf(entry->d_name, "journal-%llu.lo%c", &number, &end) == 2 && end == 'g') Numbers->push_back(number);
+    }
+    closedir(dir);
+    std::sort(Numbers->begin(), Numbers->end());
+    return true;
+  }
+
+  bool Map(Segment &s, unsigned long long Number, bool Create) const {
+    std::string path = SegmentPath(Number);
+    s.fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (Create ? O_CREAT | O_EXCL : 0), 0644);
+    if (s.fd < 0) {
+      TRACEENDL("Unable to open journal segment");
+      return false;
+    }
+
+    if (Create && posix_fallocate(s.fd, 0, static_cast<off_t>(segmentSize)) != 0) {
+      TRACEENDL("Unable to allocate journal segment");
+      close(s.fd);
+      unlink(path.c_str());
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(s.fd, &st) != 0 || static_cast<size_t>(st.st_size) < SegmentHeaderSize) {
+      TRACEENDL("Journal segment is truncated");
+      close(s.fd);
+      return false;
+    }
+
+    void *base = mmap(0, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, 0);
+    if (base == MAP_FAILED) {
+      TRACEENDL("Unable to map journal segment");
+      close(s.fd);
+      return false;
+    }
+
+    s.base = static_cast<unsigned char *>(base);
+    s.number = Number;
+    s.size = static_cast<size_t>(st.st_size);
+    s.written = SegmentHeaderSize;
+    s.synced = SegmentHeaderSize;
+    return true;
+  }
+
+  static void Unmap(Segment &s) {
+    if (s.base == 0) return;
+    munmap(s.base, s.size);
+    close(s.fd);
+    s.base = 0;
+    s.fd = -1;
+  }
+
+  /*Scans a segment found at Open, rebuilding the index. The last one becomes the current segment*/
+  bool Recover(unsigned long long Number, bool Last) {
+    /*A spare the crash left before its allocation (see Create) holds nothing*/
+    struct stat st;
+    if (stat(SegmentPath(Number).c_str(), &st) == 0 && static_cast<size_t>(st.st_size) < SegmentHeaderSize) {
+      TRACEENDL("Journal segment without header, skipped");
+      return true;
+    }
+
+    Segment s;
+    if (!Map(s, Number, false)) return false;
+
+    if (memcmp(s.base, Magic(), 8) != 0 || Get(s.base + 8) != Number) {
+      TRACEENDL("Journal segment without header, skipped");
+      Unmap(s);
+      return true;
+    }
+
+    JournalRecord record;
+    size_t length;
+    while ((length = Parse(s.base + s.written, s.size - s.written, nextSequence, &record)) != 0) {
+      Index(Number, s.written, length, record.Time, record.Address);
+      s.written += length;
+      nextSequence++;
+    }
+    s.synced = s.written;
+
+    if (!Last) {
+      Unmap(s);
+      return true;
+    }
+
+    /*Clears a torn record, so that an older record behind it can never look intact*/
+    size_t tail = std::min(s.size - s.written, static_cast<size_t>(HeaderSize));
+    memset(s.base + s.written, 0, tail);
+    current = s;
+    return true;
+  }
+
+  /*Creates, preallocates and maps segment Number with its header on disk. Touches no shared state*/
+  bool Create(Segment &s, unsigned long long Number) const {
+    if (!Map(s, Number, true)) return false;
+
+    memcpy(s.base, Magic(), 8);
+    Put(s.base + 8, Number);
+    if (msync(s.base, SegmentHeaderSize, MS_SYNC) != 0) {
+      TRACEENDL("Unable to sync journal segment header");
+      Unmap(s);
+      unlink(SegmentPath(Number).c_str());
+      return false;
+    }
+
+    int dir = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+      fsync(dir);
+      close(dir);
+    }
+    return true;
+  }
+
+  /*Starts segment Number, with the mutex held (or before the flusher runs)*/
+  bool Rotate(unsigned long long Number) {
+    Segment s;
+    if (!Create(s, Number)) {
+      failed = true;
+      return false;
+    }
+
+    if (current.base != 0) retired.push_back(current);
+    current = s;
+    spareFailed = false;
+    return true;
+  }
+
+  /*
+  Replaces the full current segment, with the mutex held: by the spare one the flusher has prepared, waiting for it if
+  it is being created. Only if there is none (the flusher could not create it) the segment is created here.
+  */
+  bool NextSegment(std::unique_lock<std::mutex> &lock) {
+    spareReady.wait(lock, [&] { return !preparing; });
+    if (!opened || failed) return false;
+
+    if (spare.base == 0 || spare.number != current.number + 1) return Rotate(current.number + 1);
+
+    retired.push_back(current);
+    current = spare;
+    spare.base = 0;
+    spare.fd = -1;
+    wakeFlusher.notify_one(); /*Prepare the next one*/
+    return true;
+  }
+
+  static const char *Magic() { return "O103JNL\1"; }
+
+  /*False on I/O error*/
+  static bool Sync(const Segment &s, size_t From, size_t To) {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = From & ~(page - 1);
+    if (To > start && msync(s.base + start, To - start, MS_SYNC) != 0) {
+      TRACEENDL("Unable to sync journal");
+      return false;
+    }
+    return true;
+  }
+
+  /*No spare segment and nothing against creating one*/
+  bool SpareNeeded() const { return spare.base == 0 && !spareFailed && !failed && !stopping; }
+
+  void Flusher() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wakeFlusher.wait(lock, [&] { return stopping || (written > durable && !failed) || SpareNeeded(); });
+      if (stopping && (written == durable || failed)) return;
+
+      /*The next segment is created here, so that appenders never wait for its allocation*/
+      if (SpareNeeded()) {
+        unsigned long long number = current.number + 1;
+        preparing = true;
+        lock.unlock();
+
+        Segment s;
+        bool created = Create(s, number);
+
+        lock.lock();
+        preparing = false;
+        if (created)
+          spare = s;
+        else
+          spareFailed = true;
+        spareReady.notify_all();
+        continue;
+      }
+
+      if (failed) continue;
+
+      /*Group commit: let more records in until the oldest has waited its budget*/
+      std::chrono::steady_clock::time_point deadline = pendingSince + std::chrono::milliseconds(latencyBudget);
+      wakeFlusher.wait_until(lock, deadline,
+                             [&] { return stopping || current.written - current.synced >= maxPending; });
+
+      std::vector<Segment> done;
+      done.swap(retired);
+      Segment segment = current;
+      size_t from = current.synced;
+      size_t to = current.written;
+      unsigned long long target = written;
+      current.synced = to;
+      lock.unlock();
+
+      bool ok = true;
+      for (size_t i = 0; i < done.size(); i++) {
+        ok = Sync(done[i], done[i].synced, done[i].written) && ok;
+        Unmap(done[i]);
+      }
+      ok = Sync(segment, from, to) && ok;
+
+      lock.lock();
+      if (ok)
+        durable = target;
+      else
+        failed = true; /*Those records may not be on disk: nothing is durable past them*/
+      synced.notify_all();
+    }
+  }
+
+  const std::string directory;
+  const size_t segmentSize;
+  const unsigned int latencyBudget;
+  const size_t maxPending;
+  const unsigned int indexInterval;
+  unsigned int crcTable[256];
+
+  bool opened;
+  bool stopping;
+  bool failed;
+  bool preparing;   /*The flusher is creating the spare segment*/
+  bool spareFailed; /*It could not: no more attempts until a segment is created by Rotate*/
+
+  std::mutex mutex;
+  std::condition_variable wakeFlusher;
+  std::condition_variable synced;
+  std::condition_variable spareReady;
+  std::thread flusher;
+  std::chrono::steady_clock::time_point pendingSince;
+
+  Segment current;
+  Segment spare; /*Next segment, created in advance by the flusher*/
+  std::vector<Segment> retired; /*Full segments the flusher has still to sync and unmap*/
+  std::vector<Block> index;
+
+  unsigned long long nextSequence;
+  unsigned long long written; /*Last sequence appended*/
+  unsigned long long durable; /*Last sequence synced*/
+
+} IEC8705103Journal; /*Write ahead journal of events and ASDUs*/
+
+#endif
+
+#endif
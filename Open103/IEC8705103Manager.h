@@ -5,12 +5,15 @@
 #include <algorithm>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "IEC8705103Arena.h"
+#include "IEC8705103Asdu.h"
 #include "IEC87052Manager.h"
 #include "gettimeofday.h"
 
-#define TRACEENDL(x) OutputDebugStringA(x)
 /*
 Some notes on 103 that may be useful to know during implementation:
 
@@ -47,7 +50,6 @@ Additionally, four application functions are defined within this companion stand
 */
 
 #define MAX_DIST_COUNT 255
-#define MAX_SDV_COUNT 5000
 
 /* IEC 870-5-103 protocol manager. */
 class IEC8705103Manager {
@@ -133,19 +135,26 @@ class IEC8705103Manager {
       this->Year = pDate[6];
     }
 
-    /*Constructs a date object from single values*/
+    /*Constructs a date object from a four octet time (CP32Time2a): day, month and year are left empty*/
+    cp56Time2A_(const unsigned char *pDate, size_t Octets) : Minutes(0), Hours(0), Day(0), Month(0), Year(0) {
+      this->Milliseconds = static_cast<unsigned short>(pDate[0] | (pDate[1] << 8));
+      this->Minutes = pDate[2];
+      this->Hours = pDate[3];
+      if (Octets < 7) return;
+
+      this->Day = pDate[4];
+      this->Month = pDate[5];
+      this->Year = pDate[6];
+    }
+
+    /*Constructs a date object from single values (dayweek 1 Monday .. 7 Sunday, years since 1900, SU summer time)*/
     cp56Time2A_(unsigned short milliseconds, unsigned char minutes, unsigned char hours, unsigned char dayweek,
                 unsigned char daymonth, unsigned char month, unsigned char years, unsigned char SU)
-        : Minutes(0), Hours(0), Day(0), Month(0), Year(0) {
-      unsigned short *tmpVal = &(this->Milliseconds);
-      unsigned char *pDate = (unsigned char *)&milliseconds;
-      tmpVal[0] = pDate[1];
-      tmpVal[1] = pDate[0];
-
+        : Milliseconds(milliseconds), Minutes(0), Hours(0), Day(0), Month(0), Year(0) {
       Minutes = (minutes & 0x3F);
       Hours = (hours & 0x1F);
 
-      if (SU == 0) Hours |= 0x80;
+      if (SU != 0) Hours |= 0x80;
 
       Day = ((daymonth & 0x1F));
       if (dayweek & 1) Day |= 0x20;
@@ -155,6 +164,17 @@ class IEC8705103Manager {
       Year = ((years - 100) & 0x7F);
     }
 
+    /*Writes the seven octets of the time, as the constructor from raw data reads them*/
+    inline void GetOctets(unsigned char *pDate) const {
+      pDate[0] = static_cast<unsigned char>(this->Milliseconds);
+      pDate[1] = static_cast<unsigned char>(this->Milliseconds >> 8);
+      pDate[2] = this->Minutes;
+      pDate[3] = this->Hours;
+      pDate[4] = this->Day;
+      pDate[5] = this->Month;
+      pDate[6] = this->Year;
+    }
+
     inline void AddMilliseconds(unsigned short add) { this->Milliseconds += add; }
 
     inline unsigned short GetMilliseconds() const { return this->Milliseconds; }
@@ -233,24 +253,33 @@ class IEC8705103Manager {
     unsigned short NFE;
   };
 
+  typedef struct DisturbanceTagSet_ {
+    unsigned short NOT;
+    unsigned short TAP;
+    TAG *TagsValue;  // NOT tags
+  } DisturbanceTagSet;  // Tags of one ASDU 29
+
+  typedef struct DisturbanceChannelValues_ {
+    ASDU30 Header;
+    int *SDV;  // Sign required! ChannelElements values, 0 if the channel has not been announced (ASDU 27)
+    float RPV;
+    float RSV;
+    float RFA;
+  } DisturbanceChannelValues;
+
+  /*
+  Last disturbance record. Tags and values are allocated while the record arrives, sized by the counts announced in
+  ASDU 26 (NOC, NOE) and 29 (NOT), in an arena of the manager: they stay valid until the next transfer starts or
+  ReleaseDisturbanceData() is called.
+  */
   typedef struct Disturbance_ {
     struct {
-      struct {
-        unsigned short NOT;
-        unsigned short TAP;
-        TAG TagsValue[MAX_SDV_COUNT];
-      } TagsHeader[MAX_DIST_COUNT];  // Number of Tags
-
+      DisturbanceTagSet *TagsHeader;  // TagsCount used
       unsigned short TagsCount;
+      unsigned short TagsCapacity;
     } TagsList;
     struct {
-      struct {
-        ASDU30 Header;
-        int SDV[MAX_SDV_COUNT];  // Sign required!f
-        float RPV;
-        float RSV;
-        float RFA;
-      } Channels[MAX_DIST_COUNT];
+      DisturbanceChannelValues *Channels;  // MAX_DIST_COUNT, indexed by ACC. 0 until ASDU 26
 
       unsigned short Count;            // Number of channels
       unsigned short ChannelElements;  // Channel elements
@@ -293,10 +322,24 @@ class IEC8705103Manager {
     unsigned char Ifi;
   } DigitalChannel;
 
+  typedef struct DigitalChange_ {
+    unsigned short TAP;      // Sample of the change
+    unsigned short Channel;  // Index in the digital channels
+    int Value;               // DPI - 1, as currVal
+  } DigitalChange;  // A digital channel taking a new value
+
+  /*Layout of the COMTRADE .dat file*/
+  enum ComtradeFormat {
+    ComtradeAscii,    /*Text, 1999*/
+    ComtradeBinary,   /*16 bit samples, 1999*/
+    ComtradeBinary32, /*32 bit samples, 2013*/
+    ComtradeFloat32   /*Single precision samples, 2013*/
+  };
+
   /*better ctor than the void one from ProtocolManager super class.*/
-  IEC8705103Manager() {}
+  IEC8705103Manager() : storeValues(true) {}
   IEC8705103Manager(CommunicationPort *p, const unsigned char address)
-      : linklayermanager(DBG_NEW IEC87052Manager(p, address)), _address(address), fType(None) {
+      : linklayermanager(DBG_NEW IEC87052Manager(p, address)), _address(address), fType(None), storeValues(true) {
     memset(&this->DCurrent, 0, sizeof(Disturbance));
   }
 
@@ -307,15 +350,26 @@ class IEC8705103Manager {
 
   void SetFCB(unsigned char FCB) { linklayermanager->SetFCB(FCB); }
 
+  unsigned char GetAddress() const { return this->_address; }
+
+  /*Function type announced by the equipment identification (0 until StationInit)*/
+  unsigned char GetFunctionType() const { return static_cast<unsigned char>(this->fType); }
+
+  /*Response timeout, repetitions and baud rate used by the link layer*/
+  void SetLinkTimings(const IEC87052Manager::LinkTimings &Timings) { linklayermanager->SetTimings(Timings); }
+
   /*Waits on the port for next message ADUS using Class request*/
   bool GetNextADSU(const void **pAdsu, size_t *Size, unsigned char Class) {
     bool result = linklayermanager->UserDataClass(Class);
     if (result == false) return false;
 
-    this->linklayermanager->VLastReceivedFrame->GetUserData(pAdsu, Size);
+    this->linklayermanager->GetLastReceivedFrame()->GetUserData(pAdsu, Size);
     return true;
   }
 
+  /*When the last ASDU returned by GetNextADSU was received: UTC nanoseconds, taken by the link layer*/
+  long long GetLastReceiveTime() const { return linklayermanager->GetLastReceiveTime() * 1000; }
+
   /*Sends a custom message on current link layer. Answers will be delivered using GetNextASDU() function*/
   bool CustomMessage(const void *pData, const size_t Size, const bool Confirm) {
     return linklayermanager->UserData(pData, Size, Confirm);
@@ -333,103 +387,155 @@ class IEC8705103Manager {
     if (!this->linklayermanager->ResetRemoteLink()) return false;
     if (!this->linklayermanager->StatusLink()) return false;
 
-    void *pData = 0;
+    const void *pData = 0;
     size_t size = 0;
+    unsigned int polls = 0;
 
     do {
-      linklayermanager->VLastReceivedFrame->GetUserData(const_cast<const void **>(&pData), &size);
-      this->linklayermanager->UserDataClass(1);
+      if (++polls > MaxInitPolls || !this->linklayermanager->UserDataClass(1)) {
+        TRACEENDL("No identification message from the equipment.");
+        return false;
+      }
+      linklayermanager->GetLastReceivedFrame()->GetUserData(&pData, &size);
     } while (size == 0);
 
-    memcpy((void *)&lastHeader, pData, ASDUHeaderSize);
-    pData = static_cast<char *>(pData) + ASDUHeaderSize;
+    ASDUView asdu(pData, size);
 
     // Since is a Init, i already know response type. It's a good thing to make response checking.
 
-    if (lastHeader.DataUnitIdentifier.SepDui.TypeIdentification != 5) {
-      if (lastHeader.DataUnitIdentifier.SepDui.CauseOfTrasmission >= 3 &&
-          lastHeader.DataUnitIdentifier.SepDui.CauseOfTrasmission <= 5) {
+    if (asdu.TypeIdentification() != 5) {
+      if (asdu.CauseOfTransmission() >= 3 && asdu.CauseOfTransmission() <= 5) {
         TRACEENDL("Communication reset");
         if (!this->linklayermanager->UserDataClass(1)) return false;
         return true;
       } else {
         TRACEENDL("This is not an identification message.");
-        // TRACEENDL(Logger::ToString(lastHeader.DataUnitIdentifier.SepDui.TypeIdentification));
+        // TRACEENDL(Logger::ToString(asdu.TypeIdentification()));
         return false;
       }
     }
 
-    if (lastHeader.DataUnitIdentifier.SepDui.CommonAddress != linklayermanager->address) {
+    if (!ParseIdentification(pData, size)) return false;
+
+    if (!this->linklayermanager->UserDataClass(1)) return false;
+
+    return true;
+  }
+  /*Checks an identification message (ASDU 5) of this equipment and takes its function type*/
+  bool ParseIdentification(const void *pAsdu, size_t Size) {
+    ASDUView asdu(pAsdu, Size);
+    IdentificationView identification;
+
+    if (!identification.Bind(asdu)) {
+      TRACEENDL("This is not an identification message.");
+      return false;
+    }
+
+    if (asdu.CommonAddress() != this->_address) {
       TRACEENDL("Common address is not the right one. This frame should be discarded.");
       return false;
     }
 
-    if (lastHeader.DataUnitIdentifier.SepDui.CauseOfTrasmission != 4 &&
-        lastHeader.DataUnitIdentifier.SepDui.CauseOfTrasmission != 3) {
+    if (asdu.CauseOfTransmission() != 4 && asdu.CauseOfTransmission() != 3) {
       // TRACEENDL("Cause of trasmission is not due to a communication link reset. This frame should be discarded.");
       // return false;
     }
 
-    if (lastHeader.InformationObjectIdentifier.SepIfi.InformationNumber != 3) {
+    if (asdu.InformationNumber() != 3) {
       // TRACEENDL("Cause of trasmission is not due to a communication link reset. This frame should be discarded.");
       // return false;
     }
 
-    // unsigned char Sq =
-    // ADSUHeader::extractBitRange(lastHeader.DataUnitIdentifier.SepDui.VariableStructureIdentifier,0,7);
-    unsigned char numInfo =
-        ASDUHeader::extractBitRange(lastHeader.DataUnitIdentifier.SepDui.VariableStructureIdentifier, 7, 1);
+    // unsigned char Sq = ADSUHeader::extractBitRange(asdu.VariableStructureIdentifier(),0,7);
+    unsigned char numInfo = ASDUHeader::extractBitRange(asdu.VariableStructureIdentifier(), 7, 1);
 
     if (numInfo != 1) {
       TRACEENDL("Welcome message should be with only 1 information number. This frame is not a good one");
       return false;
     }
 
-    this->fType = static_cast<FunctionType>(lastHeader.InformationObjectIdentifier.SepIfi.FunctionType);
-    // TRACEENDL("Function type for this protection:" +
-    // Logger::ToString(lastHeader.InformationObjectIdentifier.SepIfi.FunctionType))
+    this->fType = static_cast<FunctionType>(asdu.FunctionType());
+    // TRACEENDL("Function type for this protection:" + Logger::ToString(asdu.FunctionType()))
 
-    char *str = static_cast<char *>(pData);
-    if (str[0] == 2) {
+    if (identification.CompatibilityLevel() == 2) {
       TRACEENDL("This equipment has no support for generic services.");
     } else {
       TRACEENDL("This equipment has got support for generic services.");
     }
 
-    str++;
-    str[13] = 0;
+    return true;
+  }
+  inline bool TimeSync(const time_t *time, timeval *tz) {
+    unsigned char buffer[TimeSyncSize];
+    return linklayermanager->UserData(buffer, BuildTimeSync(time, buffer), true);
 
-    // TRACEENDL(std::string("Information element:") + str);
+    // After clock sync, shoud (do not know when) arrive an ADSU 6 message for OK of clock sync.
+  }
+  /*
+  Sends ASDU 6 with a time already encoded (7 octets). Broadcast: to every equipment of the line (address 255) with
+  send/no reply, so a single frame synchronizes the whole bus.
+  */
+  bool SendTimeSync(const unsigned char *pCp56, bool Broadcast = false) {
+    unsigned char buffer[TimeSyncSize];
+    if (!Broadcast) return linklayermanager->UserData(buffer, BuildTimeSync(pCp56, buffer), true);
 
-    if (!this->linklayermanager->UserDataClass(1)) return false;
+    linklayermanager->SetAddress(255);
+    bool result = linklayermanager->UserData(buffer, BuildTimeSync(255, pCp56, buffer), false);
+    linklayermanager->SetAddress(this->_address);
+    return result;
+  }
+  /*Request of link status, to measure the round trip to the equipment (see IEC87052Manager_::GetLastRoundTrip)*/
+  bool MeasureLink(unsigned int *RoundTrip, size_t *RequestSize, size_t *AnswerSize) {
+    if (!linklayermanager->StatusLink()) return false;
 
+    *RoundTrip = linklayermanager->GetLastRoundTrip();
+    *RequestSize = linklayermanager->GetLastRoundTripRequestSize();
+    *AnswerSize = linklayermanager->GetLastRoundTripAnswerSize();
     return true;
   }
-  inline bool TimeSync(const time_t *time, timeval *tz) {
+  /*Writes the clock synchronization ASDU (6) in buffer (TimeSyncSize bytes). Returns its size*/
+  size_t BuildTimeSync(const time_t *time, unsigned char *buffer) const {
     tm t;
+#ifdef _WIN32
     localtime_s(&t, time);
+#else
+    localtime_r(time, &t);
+#endif
 
     cp56Time2A t2a(static_cast<unsigned short>(t.tm_sec * 1000), static_cast<unsigned char>(t.tm_min),
-                   static_cast<unsigned char>(t.tm_hour), static_cast<unsigned char>(t.tm_wday),
+                   static_cast<unsigned char>(t.tm_hour), static_cast<unsigned char>(t.tm_wday == 0 ? 7 : t.tm_wday),
                    static_cast<unsigned char>(t.tm_mday), static_cast<unsigned char>(1 + t.tm_mon),
                    static_cast<unsigned char>(t.tm_year), static_cast<unsigned char>(t.tm_isdst));
 
-    char buffer[ASDUHeaderSize + cp56TimeSize] = {0};
-
-    *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(6, 129, 8, this->_address), IFI(GlobalFunctionType, 0));
+    PutHeader(buffer, DUI(6, 129, 8, this->_address), IFI(GlobalFunctionType, 0));
     memcpy(buffer + ASDUHeaderSize, &t2a, cp56TimeSize);
-
-    return linklayermanager->UserData(buffer, ASDUHeaderSize + cp56TimeSize, true);
-
-    // After clock sync, shoud (do not know when) arrive an ADSU 6 message for OK of clock sync.
+    return TimeSyncSize;
+  }
+  /*Same with a time already encoded (7 octets, e.g. by IEC8705103TimeConverter::ToCp56)*/
+  size_t BuildTimeSync(const unsigned char *pCp56, unsigned char *buffer) const {
+    return BuildTimeSync(this->_address, pCp56, buffer);
+  }
+  /*Same for any equipment (255 for broadcast), without a manager*/
+  static size_t BuildTimeSync(unsigned char Address, const unsigned char *pCp56, unsigned char *buffer) {
+    PutHeader(buffer, DUI(6, 129, 8, Address), IFI(GlobalFunctionType, 0));
+    memcpy(buffer + ASDUHeaderSize, pCp56, cp56TimeSize);
+    return TimeSyncSize;
   }
 
   /*Use the scan number to check return ADSU values*/
   inline bool GeneralInterrogation(unsigned char ScanNumber) {
-    unsigned char buffer[ASDUHeaderSize + 1];
-    *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(7, 129, 9, this->_address), IFI(GlobalFunctionType, 0));
+    unsigned char buffer[GeneralInterrogationSize];
+    return linklayermanager->UserData(buffer, BuildGeneralInterrogation(ScanNumber, buffer));
+  }
+  /*Writes the general interrogation ASDU (7) in buffer (GeneralInterrogationSize bytes). Returns its size*/
+  size_t BuildGeneralInterrogation(unsigned char ScanNumber, unsigned char *buffer) const {
+    return BuildGeneralInterrogation(this->_address, ScanNumber, buffer);
+  }
+  /*Same for any equipment, without a manager*/
+  static size_t BuildGeneralInterrogation(unsigned char Address, unsigned char ScanNumber, unsigned char *buffer) {
+    PutHeader(buffer, DUI(7, 129, 9, Address), IFI(GlobalFunctionType, 0));
     buffer[ASDUHeaderSize] = ScanNumber;
-    return linklayermanager->UserData(buffer, ASDUHeaderSize + 1);
+    return GeneralInterrogationSize;
   }
   /*
   Sends a command to the equipment.
@@ -446,26 +552,13 @@ class IEC8705103Manager {
   RII: Numbert to check command execution in ADSU return messages.
   */
   inline bool CommandTrasmission(Command Command, unsigned char DCO, unsigned char RII, int FTYPE) {
-    switch (this->fType) {
-      case DistanceProtection:
-        break;  // it supports any function.
-      case OvercurrentProtection:
-        if (Command >= 16 && Command <= 19) break;
-      case LineDifferentialProtection:
-        if (Command == 16 || Command == 18 || Command == 19) break;
-      case TrasformerDifferentialProtection:
-        if (Command == 18 || Command == 19) break;
-      default:
-        TRACEENDL("This protection does not support current function");
-        return false;
-        break;
+    if (!IsCommandSupported(Command)) {
+      TRACEENDL("This protection does not support current function");
+      return false;
     }
 
-    unsigned char buffer[ASDUHeaderSize + 2] = {0};
-    *(reinterpret_cast<ASDUHeader *>(buffer)) =
-        ASDUHeader(DUI(20, 129, 20, this->_address), IFI((FunctionType)FTYPE, Command));
-    buffer[ASDUHeaderSize] = DCO;
-    buffer[ASDUHeaderSize + 1] = RII;
+    unsigned char buffer[CommandSize];
+    size_t size = BuildCommand(Command, DCO, RII, FTYPE, buffer);
     /*
     TRACEENDL("B.Address:"+Logger::ToString(this->_address)+" AsduHeaderSize:"+Logger::ToString(ASDUHeaderSize));
     std::string buf;
@@ -477,47 +570,112 @@ class IEC8705103Manager {
 
     TRACEENDL("B.Address:"+Logger::ToString(this->_address)+" Buffer content:" + buf)
     */
-    return linklayermanager->UserData(buffer, ASDUHeaderSize + 2);
+    return linklayermanager->UserData(buffer, size);
+  }
+  /*
+  Tells if the function type of the equipment (from its identification) accepts Command. Characteristics (23..26) can
+  be activated on every protection type.
+  */
+  bool IsCommandSupported(Command Command) const {
+    bool characteristic = Command >= Activate_Char_1 && Command <= Activate_Char_4;
+    switch (this->fType) {
+      case DistanceProtection:
+        return true;  // it supports any function.
+      case OvercurrentProtection:
+        return characteristic || (Command >= AutoRecloser_On_Off && Command <= LedReset);
+      case LineDifferentialProtection:
+        return characteristic || Command == AutoRecloser_On_Off || Command == Protection_On_Off || Command == LedReset;
+      case TrasformerDifferentialProtection:
+        return characteristic || Command == Protection_On_Off || Command == LedReset;
+      default:
+        return false;
+    }
+  }
+  /*Writes the general command ASDU (20) in buffer (CommandSize bytes). Returns its size*/
+  size_t BuildCommand(Command Command, unsigned char DCO, unsigned char RII, int FTYPE, unsigned char *buffer) const {
+    return BuildCommand(this->_address, static_cast<unsigned char>(FTYPE), Command, DCO, RII, buffer);
+  }
+  /*Same for any equipment, without a manager*/
+  static size_t BuildCommand(unsigned char Address, unsigned char FTYPE, unsigned char INF, unsigned char DCO,
+                             unsigned char RII, unsigned char *buffer) {
+    PutHeader(buffer, DUI(20, 129, 20, Address), IFI((FunctionType)FTYPE, INF));
+    buffer[ASDUHeaderSize] = DCO;
+    buffer[ASDUHeaderSize + 1] = RII;
+    return CommandSize;
   }
   /*Enable/Disable Test mode for current equipment*/
   inline bool EnableTestMode() { return false; }  // Siprotec cannot handle this.
   /*Retrieves Disturbance data using current aviable value from a valid ASDU23 message.*/
-  inline bool DisturbanceData(const void *pAsdu) {
-    memcpy((void *)&lastHeader, pAsdu, ASDUHeaderSize);
-    switch (lastHeader.DataUnitIdentifier.SepDui.TypeIdentification) {
+  inline bool DisturbanceData(const void *pAsdu, size_t Size) {
+    unsigned char buffer[DisturbanceReplySize];
+    size_t size = 0;
+    bool finished = false;
+
+    bool result = DisturbanceStep(pAsdu, Size, buffer, &size, &finished);
+    if (size != 0 && !linklayermanager->UserData(buffer, size, true)) return false;
+    return result;
+  }
+  /*
+  Stores one disturbance ASDU (23, 26..31) and writes in pReply (DisturbanceReplySize bytes) the ASDU 24/25 the
+  equipment expects back. Nothing has been written when *ReplySize is 0. Finished is set by ASDU 31, end of transfer.
+  Returns false for ASDUs that are not disturbance data, for empty ASDU 23 and for transfers not ended positively.
+  */
+  bool DisturbanceStep(const void *pAsdu, size_t Size, unsigned char *pReply, size_t *ReplySize, bool *Finished) {
+    *ReplySize = 0;
+    *Finished = false;
+
+    ASDUView asdu(pAsdu, Size);
+    switch (asdu.TypeIdentification()) {
       case 23:
-        DisturbanceRequest(pAsdu);
-        break;
+        return DisturbanceRequest(asdu, pReply, ReplySize);
       case 26:
-        DisturbanceTransfer(pAsdu);
-        break;
+        return DisturbanceTransfer(asdu, pReply, ReplySize);
       case 27:
-        DisturbanceChannel(pAsdu);
-        break;
+        return DisturbanceChannel(asdu, pReply, ReplySize);
       case 28:
-        DisturbanceTags(pAsdu);
-        break;
+        return DisturbanceTags(asdu, pReply, ReplySize);
       case 29:
-        DisturbanceTagsGet(pAsdu);
-        break;
+        return DisturbanceTagsGet(asdu);
       case 30:
-        DisturbanceChannelGet(pAsdu);
-        break;
+        return DisturbanceChannelGet(asdu);
       case 31:
-        return DisturbanceEnd(pAsdu);
-        break;
+        *Finished = true;
+        return DisturbanceEnd(asdu, pReply, ReplySize);
       default:
         return false;
-        break;
-
-        return false;
     }
   }
+  /*
+  Writes in pReply (DisturbanceReplySize bytes) the selection (ASDU 24) of fault Index of a list of disturbances
+  (ASDU 23), as DisturbanceStep does for the first one, whatever its status. The function type of the list is taken
+  for the replies if the equipment has not been identified. Returns false if the list has no such fault.
+  */
+  bool SelectDisturbance(const void *pAsdu, size_t Size, unsigned char Index, unsigned char *pReply,
+                         size_t *ReplySize) {
+    ASDUView asdu(pAsdu, Size);
+    DisturbanceListView list;
+    if (!list.Bind(asdu) || Index >= list.Count()) return false;
+
+    if (this->fType == None) this->fType = static_cast<FunctionType>(asdu.FunctionType());
+    this->DCurrent.EventTime = cp56Time2A(list.Time(Index));
+    *ReplySize = BuildDisturbanceOrder(1, 0, list.FaultNumber(Index), 0, pReply);
+    return true;
+  }
+  /*Writes an order for disturbance data (ASDU 24: TOO, TOV, FAN, ACC) in buffer. Returns its size*/
+  size_t BuildDisturbanceOrder(unsigned char TOO, unsigned char TOV, unsigned short FAN, unsigned char ACC,
+                               unsigned char *buffer) const {
+    PutHeader(buffer, DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
+    buffer[6] = TOO;
+    buffer[7] = TOV;
+    buffer[8] = FAN & 0xFF;
+    buffer[9] = FAN >> 8;
+    buffer[10] = ACC;
+    return DisturbanceReplySize;
+  }
   /*Determines if current ASDU is due to a Disturbance Message*/
-  inline bool IsDisturbanceMessage(const void *pAsdu) {
-    memcpy((void *)&lastHeader, pAsdu, ASDUHeaderSize);
-    return lastHeader.DataUnitIdentifier.SepDui.TypeIdentification >= 23 &&
-           lastHeader.DataUnitIdentifier.SepDui.TypeIdentification <= 31;
+  inline bool IsDisturbanceMessage(const void *pAsdu, size_t Size) const {
+    ASDUView asdu(pAsdu, Size);
+    return asdu.TypeIdentification() >= 23 && asdu.TypeIdentification() <= 31;
   }
   /*Query protection for generic service and data/write functions*/
   inline bool GenericService() { return false; }  // Siprotec cannot handle this.
@@ -536,11 +694,14 @@ class IEC8705103Manager {
 
     return this->CommandTrasmission(IEC8705103Manager::LedReset, 2, 10, this->fType);
   }
-  /*Loops on StationStart function checking return value. Will try and retry until station will be aviable.*/
-  inline void BlockingStationStart() {
-    while (this->StationStart() == false) {
-      continue;
+  /*Loops on StationStart function checking return value. Will try and retry until station will be aviable.
+  RetryDelay: milliseconds to wait between two attempts. MaxAttempts: 0 means retry forever.*/
+  inline bool BlockingStationStart(unsigned int RetryDelay = 1000, unsigned int MaxAttempts = 0) {
+    for (unsigned int attempt = 1; this->StationStart() == false; attempt++) {
+      if (MaxAttempts != 0 && attempt >= MaxAttempts) return false;
+      WaitMilliseconds(RetryDelay);
     }
+    return true;
   }
 
   /*Returns last disturbance data (if any)*/
@@ -551,23 +712,39 @@ class IEC8705103Manager {
     return this->DCurrent;
   }
 
-  /*Saves disturbance values as a Comtrade file
-  PARAMETERS:
-  filename: Filename in which save. You will find a .cfg and a .dat file
-  StationName: Name of the station. Choose the one you like
-  StNum: Number of station. Choose the one you like
-  data: Disturbance data retrieved using 103 functions.
-  achannels: Analog channel description. 8, as 103 requires
-  dchannels: Digital channels description. The one not contained here will be discarded
-  DChannelCount: How many digital channels have we got
-  linefreq: Line Frequency
-  nsamples: number of samples
+  /*Frees the memory of the last disturbance (e.g. once exported): its tags and values are no longer available*/
+  void ReleaseDisturbanceData() {
+    this->arena.Release();
+    this->DCurrent.TagsList.TagsHeader = 0;
+    this->DCurrent.TagsList.TagsCount = 0;
+    this->DCurrent.TagsList.TagsCapacity = 0;
+    this->DCurrent.ChannelList.Channels = 0;
+  }
 
+  /*Bytes held for disturbance data*/
+  size_t GetDisturbanceMemory() const { return this->arena.GetReserved(); }
+
+  /*
+  When Store is false the samples of ASDU 30 are checked and acknowledged but not kept (SDV stays 0): headers, factors
+  and tags are still recorded, for a writer that exports the values as they arrive (see IEC8705103ComtradeStream).
   */
-  static bool SaveToComtrade(std::string filename, std::string StationName, unsigned short StNum,
-                             const LPDISTURBANCE data, const AnalogChannel achannels[8], unsigned short AChannelCount,
-                             DigitalChannel *dchannels, unsigned short DChannelCount, std::string linefreq,
-                             std::string nsamples = "1") {
+  void SetDisturbanceValuesStored(bool Store) { this->storeValues = Store; }
+
+  /*
+  Writes filename.cfg describing data in a .dat of the given Format: revision 1999, or 2013 for the 32 bit formats.
+  min and max are the range of the values of each of the AChannelCount analog channels. UtcOffset (2013 only) is how
+  many minutes the record times, i.e. the clock of the equipment, are ahead of UTC: TimeSync sets it to the local time
+  of the master, so it is usually the local offset of the master (summer time included if the record was taken in
+  summer time).
+  */
+  static bool WriteComtradeConfig(const std::string &filename, const std::string &StationName, unsigned short StNum,
+                                  const Disturbance &data, const AnalogChannel *achannels, unsigned short AChannelCount,
+                                  const DigitalChannel *dchannels, unsigned short DChannelCount,
+                                  const std::string &linefreq, const short *min, const short *max,
+                                  ComtradeFormat Format, int UtcOffset = 0) {
+    static const char *const Names[] = {"ASCII", "BINARY", "BINARY32", "FLOAT32"};
+    const bool revision2013 = Format == ComtradeBinary32 || Format == ComtradeFloat32;
+
     std::ofstream file((filename + ".cfg").c_str(), std::ios::out);
 
     if (!file) {
@@ -575,438 +752,484 @@ class IEC8705103Manager {
       return false;
     }
 
-    file << StationName << "," << StNum << ",1999" << std::endl;
-    file << AChannelCount + DChannelCount << "," << AChannelCount << "A," << DChannelCount << "D" << std::endl;
+    file << StationName << "," << StNum << (revision2013 ? ",2013\n" : ",1999\n");
+    file << AChannelCount + DChannelCount << "," << AChannelCount << "A," << DChannelCount << "D\n";
 
     for (unsigned short i = 0; i < AChannelCount; i++) {
-      short max = *std::max_element(
-          data->ChannelList.Channels[achannels[i].channelCode].SDV,
-          data->ChannelList.Channels[achannels[i].channelCode].SDV + data->ChannelList.ChannelElements);
-      short min = *std::min_element(
-          data->ChannelList.Channels[achannels[i].channelCode].SDV,
-          data->ChannelList.Channels[achannels[i].channelCode].SDV + data->ChannelList.ChannelElements);
-
+      const DisturbanceChannelValues &channel = data.ChannelList.Channels[achannels[i].channelCode];
       file << i + 1 << "," << achannels[i].ch_id << "," << achannels[i].ph << "," << achannels[i].ccbm << ","
-           << achannels[i].uu << "," << 1 / (32768) * data->ChannelList.Channels[achannels[i].channelCode].RFA << ","
-           << 0 << "," << 0 << "," << min << "," << max << ","
-           << data->ChannelList.Channels[achannels[i].channelCode].RPV << ","
-           << data->ChannelList.Channels[achannels[i].channelCode].RSV << ",S" << std::endl;
+           << achannels[i].uu << "," << channel.RFA / 32768.f << ",0,0," << min[i] << "," << max[i] << ","
+           << channel.RPV << "," << channel.RSV << ",S\n";
     }
 
     for (unsigned short i = 0; i < DChannelCount; i++)
-      file << i << "," << dchannels[i].ch_id << "," << dchannels[i].ph << "," << dchannels[i].ccbm << ","
-           << dchannels[i].y << std::endl;
-
-    file << linefreq << std::endl;  // Frequency.?
-    file << "1" << std::endl;       // Sampling frequency is the same in all measures.
-    file << 1 / (static_cast<float>(data->SamplingTime) / 1000000.f) << "," << data->ChannelList.ChannelElements
-         << std::endl;
-    file << data->startTime << std::endl;
-    file << data->EventTime << std::endl;
-    file << "ASCII" << std::endl << "1.0"; /*ASCII file format - multiplication factor for the time differential */
+      file << i + 1 << "," << dchannels[i].ch_id << "," << dchannels[i].ph << "," << dchannels[i].ccbm << ","
+           << dchannels[i].y << "\n";
+
+    file << linefreq << "\n";
+    file << "1\n";  // Sampling frequency is the same in all measures.
+    file << 1 / (static_cast<float>(data.SamplingTime) / 1000000.f) << "," << data.ChannelList.ChannelElements << "\n";
+    file << data.startTime << "\n";
+    file << data.EventTime << "\n";
+    file << Names[Format] << "\n1.0\n"; /*file format - multiplication factor for the time differential */
+    if (revision2013) {
+      /*Record times and local time are both the equipment clock*/
+      std::string offset = ComtradeTimeCode(UtcOffset);
+      file << offset << "," << offset << "\n";
+      file << "F,3\n"; /*Time quality unknown (F: clock failure) - no leap second information in the equipment*/
+    }
 
     file.close();
+    return !file.fail();
+  }
 
-    file.open((filename + ".dat").c_str(), std::ios::out);
+  /*Saves disturbance values as a Comtrade file
+  PARAMETERS:
+  filename: Filename in which save. You will find a .cfg and a .dat file
+  StationName: Name of the station. Choose the one you like
+  StNum: Number of station. Choose the one you like
+  data: Disturbance data retrieved using 103 functions.
+  achannels: Analog channel description. 8, as 103 requires
+  dchannels: Digital channels description. The one not contained here will be discarded
+  DChannelCount: How many digital channels have we got
+  linefreq: Line Frequency
+  nsamples: number of samples
+  Format: layout of the .dat file. The binary ones are several times smaller and faster to write and read
+  UtcOffset: minutes the equipment clock is ahead of UTC, written in the .cfg of the 2013 formats
 
-    if (!file) {
-      TRACEENDL("Unable to open file cfg");
+  */
+  static bool SaveToComtrade(std::string filename, std::string StationName, unsigned short StNum,
+                             const LPDISTURBANCE data, const AnalogChannel achannels[8], unsigned short AChannelCount,
+                             DigitalChannel *dchannels, unsigned short DChannelCount, std::string linefreq,
+                             std::string nsamples = "1", ComtradeFormat Format = ComtradeAscii,
+                             int UtcOffset = 0) {
+    if (data->ChannelList.Channels == 0) {
+      TRACEENDL("No disturbance data to save");
       return false;
     }
 
-    for (int k = 0; k < DChannelCount; k++) {
-      if (k != 0) file << ",";
-      int theval = 0;
-
-      for (int j = 0; j < data->TagsList.TagsCount; j++) {
-        if (data->TagsList.TagsHeader[j].TAP == 0) {
-          for (int w = 0; w < data->TagsList.TagsHeader[j].NOT; w++) {
-            if (data->TagsList.TagsHeader[j].TagsValue[w].FType == dchannels[k].FType &&
-                data->TagsList.TagsHeader[j].TagsValue[w].In == dchannels[k].Ifi) {
-              dchannels[k].currVal = data->TagsList.TagsHeader[j].TagsValue[w].DIP - 1;
-              // TRACEENDL(Logger::ToString(dchannels[k].FType)+"-"+ Logger::ToString(dchannels[k].Ifi) + std::string("
-              // initial value:") + Logger::ToString(dchannels[k].currVal));
-            }
-          }
-        }
+    std::vector<short> min(AChannelCount + 1, 0);
+    std::vector<short> max(AChannelCount + 1, 0);
+    for (unsigned short i = 0; i < AChannelCount; i++) {
+      const int *values = data->ChannelList.Channels[achannels[i].channelCode].SDV;
+      if (values != 0 && data->ChannelList.ChannelElements != 0) {
+        max[i] = *std::max_element(values, values + data->ChannelList.ChannelElements);
+        min[i] = *std::min_element(values, values + data->ChannelList.ChannelElements);
       }
     }
 
-    for (int i = 0; i < data->ChannelList.ChannelElements; i++) {
-      file << i + 1 << "," << data->SamplingTime * i << ",";
-
-      for (int x = 0; x < 255; x++) {
-        int k = achannels[x].channelCode;
+    if (!WriteComtradeConfig(filename, StationName, StNum, *data, achannels, AChannelCount, dchannels, DChannelCount,
+                             linefreq, &min[0], &max[0], Format, UtcOffset))
+      return false;
 
-        if (k == 0) continue;
+    std::ofstream file((filename + ".dat").c_str(), std::ios::out | std::ios::binary);
 
-        if (x != 0) file << ",";
+    if (!file) {
+      TRACEENDL("Unable to open file dat");
+      return false;
+    }
 
-        short sdv = data->ChannelList.Channels[k].SDV[i];
+    /*Tags at position 0 give the initial values, the others are applied when their sample is reached*/
+    std::vector<DigitalChange> changes;
+    GetDigitalChanges(*data, dchannels, DChannelCount, &changes);
+    size_t next = 0;
 
-        if ((data->ChannelList.Channels[k].SDV[i] & 0x8000) == 0x8000) {
-          sdv = (-32768) + (data->ChannelList.Channels[k].SDV[i] & 0x7FFF);
-        }
+    /*Records are gathered and written ComtradeBlockSize bytes at a time*/
+    std::vector<char> block;
+    block.reserve(ComtradeBlockSize + 64 + 16 * (AChannelCount + DChannelCount));
+    std::vector<short> values(AChannelCount + 1, 0);
 
-        file << sdv;
+    for (int i = 0; i < data->ChannelList.ChannelElements; i++) {
+      for (unsigned short x = 0; x < AChannelCount; x++) {
+        const int *SDV = data->ChannelList.Channels[achannels[x].channelCode].SDV;
+        values[x] = static_cast<short>(SDV != 0 ? SDV[i] : 0);
       }
 
-      if (i != 0) {
-        for (int j = 0; j < data->TagsList.TagsCount; j++) {
-          if (data->TagsList.TagsHeader[j].TAP == i) {
-            for (int k = 0; k < DChannelCount; k++) {
-              for (int w = 0; w < data->TagsList.TagsHeader[j].NOT; w++) {
-                if (data->TagsList.TagsHeader[j].TagsValue[w].FType == dchannels[k].FType &&
-                    data->TagsList.TagsHeader[j].TagsValue[w].In == dchannels[k].Ifi) {
-                  dchannels[k].currVal = data->TagsList.TagsHeader[j].TagsValue[w].DIP - 1;
-                  // TRACEENDL(Logger::ToString(dchannels[k].FType)+"-"+ Logger::ToString(dchannels[k].Ifi) +
-                  // std::string(" updated to:") + Logger::ToString(dchannels[k].currVal));
-                }
-              }
-            }
-          }
-        }
-      }
+      for (; next < changes.size() && changes[next].TAP <= i; next++)
+        dchannels[changes[next].Channel].currVal = changes[next].Value;
 
-      for (int z = 0; z < DChannelCount; z++) {
-        file << "," << dchannels[z].currVal;
+      AppendComtradeRecord(&block, Format, i + 1, data->SamplingTime * i, &values[0], AChannelCount, dchannels,
+                           DChannelCount);
+      if (block.size() >= ComtradeBlockSize) {
+        file.write(&block[0], block.size());
+        block.clear();
       }
-
-      file << std::endl;
     }
 
+    if (!block.empty()) file.write(&block[0], block.size());
     file.close();
 
+    if (file.fail()) {
+      TRACEENDL("Unable to write file dat");
+      return false;
+    }
     return true;
   }
-  static unsigned short GetDPI(const void *pAsdu) {
-    SkipBytes(&pAsdu);
-    unsigned short *ret;
-    ret = (unsigned short *)(pAsdu);
-    return *ret;
-  }
+  /*
+  Writes in changes the values taken by the DChannelCount digital channels according to the tags of data, sorted by
+  position (TAP), in time proportional to the number of tags: (FUN, INF) of each tag is looked up in a table of the
+  channels, and tags arrive in position order so sorting seldom has work to do.
+  */
+  static void GetDigitalChanges(const Disturbance &data, const DigitalChannel *dchannels, unsigned short DChannelCount,
+                                std::vector<DigitalChange> *changes) {
+    const unsigned short NoChannel = 0xFFFF;
+    std::vector<unsigned short> first(65536, NoChannel);         // First channel of each (FUN << 8 | INF)
+    std::vector<unsigned short> same(DChannelCount, NoChannel);  // Next channel with the same (FUN, INF)
+    for (unsigned short k = DChannelCount; k-- > 0;) {
+      unsigned short &index = first[(dchannels[k].FType << 8) | dchannels[k].Ifi];
+      same[k] = index;
+      index = k;
+    }
 
-  static void GetMeasurandsII(const void *pAsdu, unsigned short *measures) {
-    ASDUHeader *h = (ASDUHeader *)pAsdu;
-    SkipBytes(&pAsdu);
-    unsigned short data[16] = {0};
-    memcpy(data, pAsdu, 16 * sizeof(unsigned short));
+    changes->clear();
+    for (unsigned short j = 0; j < data.TagsList.TagsCount; j++) {
+      const DisturbanceTagSet &set = data.TagsList.TagsHeader[j];
+      for (unsigned short w = 0; w < set.NOT; w++) {
+        DigitalChange change;
+        change.TAP = set.TAP;
+        change.Value = set.TagsValue[w].DIP - 1;
+        for (change.Channel = first[(set.TagsValue[w].FType << 8) | set.TagsValue[w].In]; change.Channel != NoChannel;
+             change.Channel = same[change.Channel])
+          changes->push_back(change);
+      }
+    }
 
-    for (unsigned int i = 0; i < h->DataUnitIdentifier.SepDui.VariableStructureIdentifier; i++)
-      measures[i] = data[i] >> 3;
+    if (!std::is_sorted(changes->begin(), changes->end(), EarlierChange))
+      std::stable_sort(changes->begin(), changes->end(), EarlierChange);
   }
 
-  static void GetEnergy(const void *pAsdu, Energy *pEnergy) {
-    SkipBytes(&pAsdu, 5);
-    memcpy(&pEnergy->IFI, pAsdu, 1);
-    SkipBytes(&pAsdu, 1);
-    memcpy(&pEnergy->value, pAsdu, 4);
+  /*Double point information of a time-tagged message (ASDU 1, 2). 0 if the ASDU is not one of them*/
+  static unsigned short GetDPI(const void *pAsdu, size_t Size) {
+    TimeTaggedMessageView message;
+    if (!message.Bind(ASDUView(pAsdu, Size))) return 0;
+    return message.DPI();
   }
 
-  static void GetTimeFromTaggedMessage(const void *pAsdu, cp56Time2A *time, unsigned short *Rel) {
-    IEC8705103Manager::ASDUHeader *h = (IEC8705103Manager::ASDUHeader *)pAsdu;
-    const void *pt = pAsdu;
+  /*Raw measurands of ASDU 3, 9 without quality bits. Returns how many values have been written*/
+  static unsigned char GetMeasurandsII(const void *pAsdu, unsigned short *measures, size_t Size) {
+    MeasurandsView values;
+    if (!values.Bind(ASDUView(pAsdu, Size))) return 0;
 
-    unsigned short skip = 0;
-    unsigned short relPos = 0;
+    for (unsigned char i = 0; i < values.Count(); i++) measures[i] = values.Raw(i) >> 3;
+    return values.Count();
+  }
 
-    SkipBytes(&pt);
-    if (h->DataUnitIdentifier.SepDui.TypeIdentification == 1) {
-      *Rel = 0;
-      relPos = 0;
-      skip = 1;
-    }
+  static bool GetEnergy(const void *pAsdu, Energy *pEnergy, size_t Size) {
+    ASDUView asdu(pAsdu, Size);
+    EnergyCounterView counter;
+    if (!counter.Bind(asdu)) return false;
 
-    else if (h->DataUnitIdentifier.SepDui.TypeIdentification == 2) {
-      relPos = 1;
-      skip = 5;
-    }
+    pEnergy->IFI = asdu.InformationNumber();
+    pEnergy->value = counter.Value();
+    return true;
+  }
 
-    else if (h->DataUnitIdentifier.SepDui.TypeIdentification == 4) {
-      relPos = 4;
-      skip = 8;
-    }
+  /*Time (four octets: no date) and relative time of ASDU 1, 2, 4*/
+  static bool GetTimeFromTaggedMessage(const void *pAsdu, cp56Time2A *time, unsigned short *Rel, size_t Size) {
+    ASDUView asdu(pAsdu, Size);
+    TimeTaggedMessageView message;
+    TimeTaggedMeasurandView measurand;
 
-    SkipBytes(&pt, skip);
-    *time = cp56Time2A((const unsigned char *)pt);
+    if (message.Bind(asdu)) {
+      *time = cp56Time2A(message.Time(), ASDUView::Cp32Size);
+      *Rel = message.RelativeTime();
+      return true;
+    }
 
-    if (relPos != 0) {
-      pt = pAsdu;
-      SkipBytes(&pt, relPos + 6);
-      memcpy(Rel, pt, 2);
+    if (measurand.Bind(asdu)) {
+      *time = cp56Time2A(measurand.Time(), ASDUView::Cp32Size);
+      *Rel = measurand.RelativeTime();
+      return true;
     }
+
+    return false;
   }
 
  private:
+  const static unsigned int MaxInitPolls = 16; /*Class 1 polls waiting for identification during StationInit*/
   const static char cp56TimeSize = 7;
-  const static char ASDU26Size = 10;
-  const static char ASDU29Size = 5;
-  const static char ASDU27Size = 16;
-  const static char ASDU30Size = 7;
   const static char DUISize = 4;
   const static char IFISize = 2;
 
  public:
   const static char ASDUHeaderSize = DUISize + IFISize;
+  const static char TimeSyncSize = ASDUHeaderSize + cp56TimeSize;
+  const static char GeneralInterrogationSize = ASDUHeaderSize + 1;
+  const static char CommandSize = ASDUHeaderSize + 2;
+  const static char DisturbanceReplySize = ASDUHeaderSize + 5; /*ASDU 24 and 25*/
 
  private:
+  const static size_t ComtradeBlockSize = 1 << 20; /*Bytes of .dat records written at once*/
+
   IEC87052Manager *linklayermanager;
-  const ASDUHeader lastHeader;
   FunctionType fType;
   Disturbance DCurrent;
+  IEC8705103Arena arena; /*Tags and values of DCurrent*/
   unsigned char _address;
+  bool storeValues; /*Samples of ASDU 30 are kept in DCurrent*/
 
-  inline bool DisturbanceRequest(const void *pAsdu) {
-    memcpy((void *)&lastHeader, pAsdu, ASDUHeaderSize);
+  inline bool DisturbanceRequest(const ASDUView &asdu, unsigned char *buffer, size_t *size) {
+    DisturbanceListView list;
+    if (!list.Bind(asdu)) {
+      TRACEENDL("Malformed list of disturbances");
+      return false;
+    }
 
-    if (lastHeader.DataUnitIdentifier.SepDui.VariableStructureIdentifier == 0) {
+    if (list.Count() == 0) {
       TRACEENDL("There is no disturbance data in this message");
       return false;
     }
 
-    unsigned char VSQ = lastHeader.DataUnitIdentifier.SepDui.VariableStructureIdentifier;
+    const unsigned char SOF = list.FaultStatus(0);  // Fault informations
+    this->DCurrent.EventTime = cp56Time2A(list.Time(0));
 
-    SkipBytes(&pAsdu);
-    static unsigned char buffer[ASDUHeaderSize + 5];
-
-    unsigned char FAN[2]; /* = static_cast<const unsigned short*>(pAsdu)[0];  */  // Fault number
-    memcpy(&FAN, pAsdu, 2);
-    SkipBytes(&pAsdu, 2);
-    const unsigned char SOF = static_cast<const unsigned char *>(pAsdu)[0];  // Fault informations
-    SkipBytes(&pAsdu, 1);
-    this->DCurrent.EventTime = cp56Time2A(static_cast<const unsigned char *>(pAsdu));
-    SkipBytes(&pAsdu, cp56TimeSize);
-
-    // TRACEENDL("Fault record found. FAN: "+Logger::ToString((*(unsigned short *)&FAN))+"
-    // SOF:"+Logger::ToString((int)SOF));
+    // TRACEENDL("Fault record found. FAN: "+Logger::ToString(FAN)+" SOF:"+Logger::ToString((int)SOF));
 
     // Ask for disturbance only if no another transfer is going on.
     if ((SOF & 0x2) != 0x2) {
-      *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
-      buffer[6] = 1;
-      buffer[7] = 0;
-      buffer[8] = FAN[0];
-      buffer[9] = FAN[1];
-      buffer[10] = 0;
-
-      this->linklayermanager->UserData(buffer, ASDUHeaderSize + 5, true);
-
+      *size = BuildDisturbanceOrder(1, 0, list.FaultNumber(0), 0, buffer);
     } else
       TRACEENDL("Disturbance already in trasmission");
     return true;
   }
-  inline bool DisturbanceTransfer(const void *pAsdu) {
-    SkipBytes(&pAsdu, ASDUHeaderSize + 1);
-
-    struct {
-      unsigned char TOV;
-      unsigned char FAN[2];
-      unsigned short NOF;
-      unsigned char NOC;
-      unsigned short NOE;
-      unsigned short INT;
-    } A26;
-
-    unsigned char bf[10];
-
-    memcpy((void *)bf, pAsdu, ASDU26Size);
-
-    // TRACEENDL("A26 message content:");
-
-    A26.TOV = bf[0];
-    A26.FAN[0] = bf[1];
-    A26.FAN[1] = bf[2];
-    A26.NOF = *((unsigned short *)(&bf[3]));
-    A26.NOC = bf[5];
-    A26.NOE = *((unsigned short *)(&bf[6]));
-    A26.INT = *((unsigned short *)(&bf[8]));
+  inline bool DisturbanceTransfer(const ASDUView &asdu, unsigned char *buffer, size_t *size) {
+    DisturbanceReadyView A26;
+    if (!A26.Bind(asdu)) {
+      TRACEENDL("Malformed disturbance data announcement");
+      return false;
+    }
 
-    this->DCurrent.FaultNumber = (*(unsigned char *)&A26.FAN);
+    this->DCurrent.FaultNumber = A26.FaultNumber() & 0xFF;
     /*
-    TRACEENDL("TOV:"+Logger::ToString((int)A26.TOV));
-    TRACEENDL("FAN:"+Logger::ToString((*(ushort_t*)&A26.FAN)));
-    TRACEENDL("NOF:"+Logger::ToString((int)A26.NOF));
-    TRACEENDL("NOC:"+Logger::ToString((int)A26.NOC));
-    TRACEENDL("NOE:"+Logger::ToString((int)A26.NOE));
-    TRACEENDL("INT:"+Logger::ToString((int)A26.INT));
+    TRACEENDL("TOV:"+Logger::ToString((int)A26.TypeOfValues()));
+    TRACEENDL("FAN:"+Logger::ToString(A26.FaultNumber()));
+    TRACEENDL("NOF:"+Logger::ToString((int)A26.NetworkFault()));
+    TRACEENDL("NOC:"+Logger::ToString((int)A26.Channels()));
+    TRACEENDL("NOE:"+Logger::ToString((int)A26.Elements()));
+    TRACEENDL("INT:"+Logger::ToString((int)A26.Interval()));
     */
-    SkipBytes(&pAsdu, ASDU26Size);
 
-    this->DCurrent.startTime = cp56Time2A(static_cast<const unsigned char *>(pAsdu));
+    this->DCurrent.startTime = cp56Time2A(A26.Time(), ASDUView::Cp32Size);
     this->DCurrent.startTime.Day = this->DCurrent.EventTime.Day;
     this->DCurrent.startTime.Month = this->DCurrent.EventTime.Month;
     this->DCurrent.startTime.Year = this->DCurrent.EventTime.Year;
 
-    static unsigned char buffer[ASDUHeaderSize + 5];
-    this->DCurrent.SamplingTime = A26.INT;
-    this->DCurrent.ChannelList.Count = A26.NOC;
-    this->DCurrent.ChannelList.ChannelElements = A26.NOE;
+    this->DCurrent.SamplingTime = A26.Interval();
+    this->DCurrent.ChannelList.Count = A26.Channels();
+    this->DCurrent.ChannelList.ChannelElements = A26.Elements();
+
+    /*A new record: memory of the previous one is reused*/
+    this->arena.Reset();
+    this->DCurrent.ChannelList.Channels = this->arena.Allocate<DisturbanceChannelValues>(MAX_DIST_COUNT);
+    this->DCurrent.TagsList.TagsHeader = 0;
+    this->DCurrent.TagsList.TagsCount = 0;
+    this->DCurrent.TagsList.TagsCapacity = 0;
+    if (this->DCurrent.ChannelList.Channels == 0) {
+      TRACEENDL("No memory for disturbance data");
+      return false;
+    }
 
-    *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
+    PutHeader(buffer, DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
 
     buffer[6] = 2;
-    buffer[7] = A26.TOV;
-    buffer[8] = A26.FAN[0];
-    buffer[9] = A26.FAN[1];
+    buffer[7] = A26.TypeOfValues();
+    buffer[8] = A26.FaultNumber() & 0xFF;
+    buffer[9] = A26.FaultNumber() >> 8;
     buffer[10] = 0;
 
-    return this->linklayermanager->UserData(buffer, ASDUHeaderSize + 5, true);
+    *size = DisturbanceReplySize;
+    return true;
   }
-  inline bool DisturbanceTags(const void *pAsdu) {
-    SkipBytes(&pAsdu, 8);
-    const unsigned char *FAN = reinterpret_cast<const unsigned char *>(pAsdu);
+  inline bool DisturbanceTags(const ASDUView &asdu, unsigned char *buffer, size_t *size) {
+    TagsReadyView A28;
+    if (!A28.Bind(asdu)) return false;
 
-    static unsigned char buffer[ASDUHeaderSize + 5];
-    *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
+    PutHeader(buffer, DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
 
     buffer[6] = 16;  // Type of order - Request for tags
     buffer[7] = 1;
-    buffer[8] = FAN[0];
-    buffer[9] = FAN[1];
+    buffer[8] = A28.FaultNumber() & 0xFF;
+    buffer[9] = A28.FaultNumber() >> 8;
     buffer[10] = 0;
 
-    return linklayermanager->UserData(buffer, ASDUHeaderSize + 5, true);
+    *size = DisturbanceReplySize;
+    return true;
   }
-  inline bool DisturbanceTagsGet(const void *pAsdu) {
-    unsigned char *buffer = (unsigned char *)pAsdu;
-
-    SkipBytes(&pAsdu);
-    ASDU29 A29;
-    A29.FAN = *((unsigned short *)pAsdu);
-    SkipBytes(&pAsdu, 2);
-    A29.NOT = *((unsigned char *)pAsdu);
-    SkipBytes(&pAsdu, 1);
-    unsigned char *t = (unsigned char *)pAsdu;
-    A29.TAP = (((unsigned short)t[1]) << 8) | t[0];
+  inline bool DisturbanceTagsGet(const ASDUView &asdu) {
+    TagsView A29;
+    if (!A29.Bind(asdu)) {
+      TRACEENDL("Malformed tags message");
+      return false;
+    }
 
     /*
     TRACEENDL("A29 CONTENTS:")
-    TRACEENDL("FAN:"+Logger::ToString(A29.FAN));
-    TRACEENDL("NOT:"+Logger::ToString(A29.NOT));
-    TRACEENDL("TAP:"+Logger::ToString(A29.TAP));
+    TRACEENDL("FAN:"+Logger::ToString(A29.FaultNumber()));
+    TRACEENDL("NOT:"+Logger::ToString(A29.Count()));
+    TRACEENDL("TAP:"+Logger::ToString(A29.TagPosition()));
     */
-    SkipBytes(&pAsdu, 5);
 
-    this->DCurrent.TagsList.TagsHeader[this->DCurrent.TagsList.TagsCount].NOT = A29.NOT;
-    this->DCurrent.TagsList.TagsHeader[this->DCurrent.TagsList.TagsCount].TAP = A29.TAP;
+    if (this->DCurrent.ChannelList.Channels == 0) {
+      TRACEENDL("Tags without disturbance data announcement");
+      return false;
+    }
+
+    if (this->DCurrent.TagsList.TagsCount >= MAX_DIST_COUNT) {
+      TRACEENDL("Overflow with tags!");
+      return false;
+    }
+
+    if (!GrowTags()) return false;
+
+    DisturbanceTagSet &set = this->DCurrent.TagsList.TagsHeader[this->DCurrent.TagsList.TagsCount];
+    set.NOT = A29.Count();
+    set.TAP = A29.TagPosition();
+    set.TagsValue = this->arena.Allocate<TAG>(A29.Count());
+    if (set.TagsValue == 0) {
+      TRACEENDL("No memory for disturbance tags");
+      return false;
+    }
 
-    for (int i = 0; i < buffer[8]; i++) {
+    for (unsigned char i = 0; i < A29.Count(); i++) {
       /*
       TRACEENDL("Tag value");
-      TRACEENDL("FT:" + Logger::ToString((int)buffer[11+(3*i)+0]));
-      TRACEENDL("IFI:" + Logger::ToString((int)buffer[11+(3*i)+1]));
-      TRACEENDL("DPI:" + Logger::ToString((int)buffer[11+(3*i)+2]));
+      TRACEENDL("FT:" + Logger::ToString((int)A29.FunctionType(i)));
+      TRACEENDL("IFI:" + Logger::ToString((int)A29.InformationNumber(i)));
+      TRACEENDL("DPI:" + Logger::ToString((int)A29.DPI(i)));
       */
 
-      this->DCurrent.TagsList.TagsHeader[this->DCurrent.TagsList.TagsCount].TagsValue[i].FType =
-          buffer[11 + (3 * i) + 0];
-      this->DCurrent.TagsList.TagsHeader[this->DCurrent.TagsList.TagsCount].TagsValue[i].In = buffer[11 + (3 * i) + 1];
-      this->DCurrent.TagsList.TagsHeader[this->DCurrent.TagsList.TagsCount].TagsValue[i].DIP = buffer[11 + (3 * i) + 2];
+      set.TagsValue[i].FType = A29.FunctionType(i);
+      set.TagsValue[i].In = A29.InformationNumber(i);
+      set.TagsValue[i].DIP = A29.DPI(i);
     }
 
     this->DCurrent.TagsList.TagsCount++;
 
     return true;
   }
-  inline bool DisturbanceChannel(const void *pAsdu) {
-    struct {
-      unsigned char TOV;
-      unsigned char FAN[2];
-      unsigned char ACC;
-      float RPV;
-      float RSV;
-      float RFA;
-    } A27;
-
-    SkipBytes(&pAsdu, ASDUHeaderSize + 1);
-    memcpy(static_cast<void *>(&A27), pAsdu, ASDU27Size);
+  /*Room for one more set of tags: the array doubles, the old one stays in the arena until the record ends*/
+  bool GrowTags() {
+    Disturbance &d = this->DCurrent;
+    if (d.TagsList.TagsCount < d.TagsList.TagsCapacity) return true;
+
+    unsigned short capacity = d.TagsList.TagsCapacity == 0 ? 16 : d.TagsList.TagsCapacity * 2;
+    if (capacity > MAX_DIST_COUNT) capacity = MAX_DIST_COUNT;
+
+    DisturbanceTagSet *sets = this->arena.Allocate<DisturbanceTagSet>(capacity);
+    if (sets == 0) {
+      TRACEENDL("No memory for disturbance tags");
+      return false;
+    }
+
+    if (d.TagsList.TagsCount != 0)
+      memcpy(sets, d.TagsList.TagsHeader, d.TagsList.TagsCount * sizeof(DisturbanceTagSet));
+    d.TagsList.TagsHeader = sets;
+    d.TagsList.TagsCapacity = capacity;
+    return true;
+  }
+  inline bool DisturbanceChannel(const ASDUView &asdu, unsigned char *buffer, size_t *size) {
+    ChannelReadyView A27;
+    if (!A27.Bind(asdu) || A27.Channel() >= MAX_DIST_COUNT) {
+      TRACEENDL("Malformed channel announcement");
+      return false;
+    }
     /*
     TRACEENDL("A27 CONTENT:");
-    TRACEENDL("TOV:" + Logger::ToString((int)A27.TOV));
-    TRACEENDL("FAN:" + Logger::ToString(((*(ushort_t*)&A27.FAN))));
-    TRACEENDL("ACC:" + Logger::ToString((int)A27.ACC));
-    TRACEENDL("RPV:" + Logger::ToString(A27.RPV));
-    TRACEENDL("RSV:" + Logger::ToString(A27.RSV));
-    TRACEENDL("RFA:" + Logger::ToString(A27.RFA));
+    TRACEENDL("TOV:" + Logger::ToString((int)A27.TypeOfValues()));
+    TRACEENDL("FAN:" + Logger::ToString(A27.FaultNumber()));
+    TRACEENDL("ACC:" + Logger::ToString((int)A27.Channel()));
+    TRACEENDL("RPV:" + Logger::ToString(A27.PrimaryRated()));
+    TRACEENDL("RSV:" + Logger::ToString(A27.SecondaryRated()));
+    TRACEENDL("RFA:" + Logger::ToString(A27.ReferenceFactor()));
     */
-    // TRACEENDL("Trasmitting channel " + Logger::ToString((int)A27.ACC));
+    // TRACEENDL("Trasmitting channel " + Logger::ToString((int)A27.Channel()));
 
-    static unsigned char buffer[ASDUHeaderSize + 5];
-    *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
+    PutHeader(buffer, DUI(24, 129, 31, this->_address), IFI(this->fType, 0));
 
     buffer[6] = 8;  // Type of order - Request for channel
-    buffer[7] = A27.TOV;
-    buffer[8] = A27.FAN[0];
-    buffer[9] = A27.FAN[1];
-    buffer[10] = A27.ACC;
+    buffer[7] = A27.TypeOfValues();
+    buffer[8] = A27.FaultNumber() & 0xFF;
+    buffer[9] = A27.FaultNumber() >> 8;
+    buffer[10] = A27.Channel();
+
+    if (this->DCurrent.ChannelList.Channels == 0) {
+      TRACEENDL("Channel without disturbance data announcement");
+      return false;
+    }
+
+    DisturbanceChannelValues &channel = this->DCurrent.ChannelList.Channels[A27.Channel()];
+    channel.RFA = A27.ReferenceFactor();
+    channel.RSV = A27.SecondaryRated();
+    channel.RPV = A27.PrimaryRated();
+    if (!this->storeValues) {
+      *size = DisturbanceReplySize;
+      return true;
+    }
 
-    this->DCurrent.ChannelList.Channels[A27.ACC].RFA = A27.RFA;
-    this->DCurrent.ChannelList.Channels[A27.ACC].RSV = A27.RSV;
-    this->DCurrent.ChannelList.Channels[A27.ACC].RPV = A27.RPV;
+    if (channel.SDV == 0) channel.SDV = this->arena.Allocate<int>(this->DCurrent.ChannelList.ChannelElements);
+    if (channel.SDV == 0 && this->DCurrent.ChannelList.ChannelElements != 0) {
+      TRACEENDL("No memory for disturbance values");
+      return false;
+    }
 
-    return linklayermanager->UserData(buffer, sizeof(buffer), true);
+    *size = DisturbanceReplySize;
+    return true;
   }
-  inline bool DisturbanceChannelGet(const void *pAsdu) {
-    SkipBytes(&pAsdu, 7);
-    const ASDU30 *tmp;
-    tmp = static_cast<const ASDU30 *>(pAsdu);
+  inline bool DisturbanceChannelGet(const ASDUView &asdu) {
+    DisturbanceValuesView A30;
+    if (!A30.Bind(asdu) || A30.Channel() >= MAX_DIST_COUNT) {
+      TRACEENDL("Malformed disturbance values");
+      return false;
+    }
     /*
     TRACEENDL("ASDU30 CONTENT:");
-    TRACEENDL("TOV:"+Logger::ToString((int)tmp->TOV));
-    TRACEENDL("FAN:" + Logger::ToString(((*(ushort_t*)&tmp->FAN))));
-    TRACEENDL("ACC:"+Logger::ToString((int)tmp->ACC));
-    TRACEENDL("NDV:"+Logger::ToString((int)tmp->NDV));
-    TRACEENDL("NFE:"+Logger::ToString((int)tmp->NFE));
+    TRACEENDL("TOV:"+Logger::ToString((int)A30.TypeOfValues()));
+    TRACEENDL("FAN:" + Logger::ToString(A30.FaultNumber()));
+    TRACEENDL("ACC:"+Logger::ToString((int)A30.Channel()));
+    TRACEENDL("NDV:"+Logger::ToString((int)A30.Count()));
+    TRACEENDL("NFE:"+Logger::ToString((int)A30.FirstElement()));
     */
-    unsigned short *tf = (unsigned short *)(&tmp->FAN);
-    unsigned short *cf = (unsigned short *)(&this->DCurrent.ChannelList.Channels[tmp->ACC].Header.FAN);
-
-    *cf = *tf;
-
-    this->DCurrent.ChannelList.Channels[tmp->ACC].Header.ACC = tmp->ACC;
-    this->DCurrent.ChannelList.Channels[tmp->ACC].Header.NDV = tmp->NDV;
-    this->DCurrent.ChannelList.Channels[tmp->ACC].Header.NFE = tmp->NFE;
-    this->DCurrent.ChannelList.Channels[tmp->ACC].Header.TOV = tmp->TOV;
+    if (this->DCurrent.ChannelList.Channels == 0 ||
+        (this->storeValues && this->DCurrent.ChannelList.Channels[A30.Channel()].SDV == 0)) {
+      TRACEENDL("Values of a channel not announced");
+      return false;
+    }
 
-    SkipBytes(&pAsdu, 7);
+    ASDU30 &header = this->DCurrent.ChannelList.Channels[A30.Channel()].Header;
+    header.FAN[0] = A30.FaultNumber() & 0xFF;
+    header.FAN[1] = A30.FaultNumber() >> 8;
+    header.ACC = A30.Channel();
+    header.NDV = A30.Count();
+    header.NFE = A30.FirstElement();
+    header.TOV = A30.TypeOfValues();
 
-    for (int i = 0; i < tmp->NDV; i++) {
-      unsigned int val = *(static_cast<const unsigned short *>(pAsdu));
-      int sval = val;
-      if ((val & 0x8000) == 0x8000) {
-        sval = val - (2 * 32768);
-      }
+    int *SDV = this->DCurrent.ChannelList.Channels[A30.Channel()].SDV;
+    if (SDV == 0) return true;
 
-      this->DCurrent.ChannelList.Channels[tmp->ACC].SDV[i + this->DCurrent.ChannelList.Channels[tmp->ACC].Header.NFE] =
-          sval;
-      if (i + this->DCurrent.ChannelList.Channels[tmp->ACC].Header.NFE > MAX_SDV_COUNT) {
+    for (unsigned char i = 0; i < A30.Count(); i++) {
+      if (A30.FirstElement() + i >= this->DCurrent.ChannelList.ChannelElements) {
         TRACEENDL("Overflow with values!");
         break;
       }
 
-      SkipBytes(&pAsdu, 2);
+      SDV[A30.FirstElement() + i] = A30.Value(i);
     }
 
     return true;
   }
-  inline bool DisturbanceEnd(const void *pAsdu) {
+  inline bool DisturbanceEnd(const ASDUView &asdu, unsigned char *buffer, size_t *size) {
     bool ret = false;
-    struct {
-      unsigned char TOO;
-      unsigned char TOV;
-      unsigned char FAN[2];
-      unsigned char ACC;
-    } A31;
-
-    SkipBytes(&pAsdu);
-    memcpy(static_cast<void *>(&A31), pAsdu, 5);
+    TransmissionEndView A31;
+    if (!A31.Bind(asdu)) {
+      TRACEENDL("Malformed end of transmission");
+      return false;
+    }
 
-    unsigned char buffer[ASDUHeaderSize + 5];
-    *(reinterpret_cast<ASDUHeader *>(buffer)) = ASDUHeader(DUI(25, 129, 31, this->_address), IFI(this->fType, 0));
+    PutHeader(buffer, DUI(25, 129, 31, this->_address), IFI(this->fType, 0));
 
-    unsigned char respcode;
+    unsigned char respcode = 0;
 
-    switch (A31.TOO) {
+    switch (A31.TypeOfOrder()) {
       case 32:
         respcode = 64;
         break;
@@ -1030,29 +1253,116 @@ class IEC8705103Manager {
         break;
     }
     buffer[6] = respcode;
-    buffer[7] = A31.TOV;
-    buffer[8] = A31.FAN[0];
-    buffer[9] = A31.FAN[1];
+    buffer[7] = A31.TypeOfValues();
+    buffer[8] = A31.FaultNumber() & 0xFF;
+    buffer[9] = A31.FaultNumber() >> 8;
 
-    buffer[10] = A31.ACC;
+    buffer[10] = A31.Channel();
 
     if (buffer[6] == 64) {
       TRACEENDL("Disturbance data end.");
       ret = true;
     }
 
-    linklayermanager->UserData(buffer, sizeof(buffer), true);
+    *size = DisturbanceReplySize;
     return ret;
   }
 
   // I won't let you copy this object.
   IEC8705103Manager &operator=(const IEC8705103Manager &cSource) {}
 
+  /*Writes an ASDU header in its wire layout (DUI then IFI, no padding)*/
+  static void PutHeader(unsigned char *buffer, DUI Dui, IFI Ifi) {
+    memcpy(buffer, &Dui, DUISize);
+    memcpy(buffer + DUISize, &Ifi, IFISize);
+  }
+
+  static void WaitMilliseconds(unsigned int Milliseconds) {
+#ifdef _WIN32
+    Sleep(Milliseconds);
+#else
+    timespec ts = {static_cast<time_t>(Milliseconds / 1000), static_cast<long>(Milliseconds % 1000) * 1000000};
+    nanosleep(&ts, 0);
+#endif
+  }
+
   /*Advances current pointer of requested bytes*/
   static inline void SkipBytes(const void **pAsdu, unsigned short bytes = ASDUHeaderSize) {
     *pAsdu = ((unsigned char *)(*pAsdu)) + bytes;
   }
 
+  /*Offset from UTC in COMTRADE form: hours, then minutes if any (e.g. 1, -5h30, 0)*/
+  static std::string ComtradeTimeCode(int Minutes) {
+    std::ostringstream code;
+    if (Minutes < 0) code << "-";
+    int magnitude = Minutes < 0 ? -Minutes : Minutes;
+    code << magnitude / 60;
+    if (magnitude % 60 != 0) code << "h" << std::setw(2) << std::setfill('0') << magnitude % 60;
+    return code.str();
+  }
+
+  /*One .dat record: sample number, time stamp (microseconds), analog values, digital values (16 per word if binary)*/
+  static void AppendComtradeRecord(std::vector<char> *block, ComtradeFormat Format, unsigned int Number,
+                                   unsigned int Stamp, const short *values, unsigned short AChannelCount,
+                                   const DigitalChannel *dchannels, unsigned short DChannelCount) {
+    if (Format == ComtradeAscii) {
+      AppendDecimal(block, Number);
+      block->push_back(',');
+      AppendDecimal(block, Stamp);
+      for (unsigned short x = 0; x < AChannelCount; x++) {
+        block->push_back(',');
+        AppendDecimal(block, values[x]);
+      }
+      for (unsigned short z = 0; z < DChannelCount; z++) {
+        block->push_back(',');
+        AppendDecimal(block, dchannels[z].currVal);
+      }
+      block->push_back('\n');
+      return;
+    }
+
+    AppendBytes(block, &Number, 4);
+    AppendBytes(block, &Stamp, 4);
+
+    for (unsigned short x = 0; x < AChannelCount; x++) {
+      if (Format == ComtradeBinary) {
+        AppendBytes(block, &values[x], 2);
+      } else if (Format == ComtradeBinary32) {
+        int value = values[x];
+        AppendBytes(block, &value, 4);
+      } else {
+        float value = values[x];
+        AppendBytes(block, &value, 4);
+      }
+    }
+
+    for (unsigned short z = 0; z < DChannelCount; z += 16) {
+      unsigned short word = 0;
+      for (unsigned short b = 0; b < 16 && z + b < DChannelCount; b++)
+        if (dchannels[z + b].currVal == 1) word |= 1 << b;
+      AppendBytes(block, &word, 2);
+    }
+  }
+
+  static bool EarlierChange(const DigitalChange &a, const DigitalChange &b) { return a.TAP < b.TAP; }
+
+  static void AppendDecimal(std::vector<char> *block, long long Value) {
+    char text[24];
+    char *p = text + sizeof(text);
+    unsigned long long magnitude = Value < 0 ? 0ULL - Value : Value;
+    do {
+      *--p = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    if (Value < 0) *--p = '-';
+    block->insert(block->end(), p, text + sizeof(text));
+  }
+
+  /*Little endian, as the host*/
+  static void AppendBytes(std::vector<char> *block, const void *p, size_t Size) {
+    block->insert(block->end(), static_cast<const char *>(p), static_cast<const char *>(p) + Size);
+  }
+
   static unsigned short swap_uint16(unsigned short val) { return (val << 8) | (val >> 8); }
 
   static unsigned char rev_byte(unsigned char c) {
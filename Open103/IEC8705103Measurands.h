@@ -0,0 +1,123 @@
+#ifndef IEC8705103MEASURANDS_H
+#define IEC8705103MEASURANDS_H
+#pragma once
+
+#include "IEC8705103Asdu.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IEC8705103_MEASURANDS_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define IEC8705103_MEASURANDS_AVX2
+#include <immintrin.h>
+#endif
+
+/*Quality of a decoded measurand: the two low bits of the received word*/
+enum MeasurandQuality { MeasurandOverflow = 0x01, MeasurandError = 0x02 };
+
+/*One ASDU 3/9 of a batch and where its values go*/
+typedef struct MeasurandBatchItem_ {
+  const void *pAsdu;
+  size_t Size;
+  const float *Scale;     /*One factor per value, see IEC8705103MeasurandDecoder*/
+  float *Values;          /*Room for Capacity values*/
+  unsigned char *Quality; /*Room for Capacity flags (MeasurandQuality)*/
+  size_t Capacity;
+  size_t Count; /*Out: values written, 0 for malformed ASDUs*/
+} MeasurandBatchItem;
+
+/*
+Decodes measurands of ASDU 3 and 9 into engineering values.
+
+A measurand is a 13 bit signed fraction of 1.2 or 2.4 times the rated value, followed by a reserved bit and the
+ER / OV bits. Value i is (raw >> 3) / 4096 * Scale[i], where Scale[i] is 1.2 or 2.4 times the rated value of that
+point; Quality[i] gets its ER / OV bits.
+Values are decoded 16 at a time with AVX2 when the compiler targets it (/arch:AVX2, -mavx2), 8 at a time with SSE2
+(any x64 build), the rest one by one.
+*/
+typedef class IEC8705103MeasurandDecoder_ {
+ public:
+  /*Fraction of full scale of one step of the 13 bit value*/
+  static float Step() { return 1.0f / 4096; }
+
+  /*
+  Decodes one received ASDU 3/9. At most Capacity values are written.
+  Returns how many, 0 if the ASDU is not a valid ASDU 3/9.
+  */
+  static size_t Decode(const void *pAsdu, size_t Size, const float *Scale, float *Values, unsigned char *Quality,
+                       size_t Capacity) {
+    MeasurandsView measurands;
+    if (!measurands.Bind(ASDUView(pAsdu, Size))) return 0;
+
+    size_t count = measurands.Count() < Capacity ? measurands.Count() : Capacity;
+    DecodeWords(measurands.Values(), count, Scale, Values, Quality);
+    return count;
+  }
+
+  /*Decodes every item of a batch. Returns the total number of values written*/
+  static size_t DecodeBatch(MeasurandBatchItem *Items, size_t Count) {
+    size_t total = 0;
+    for (size_t i = 0; i < Count; i++) {
+      MeasurandBatchItem &item = Items[i];
+      item.Count = Decode(item.pAsdu, item.Size, item.Scale, item.Values, item.Quality, item.Capacity);
+      total += item.Count;
+    }
+    return total;
+  }
+
+  /*Decodes Count little endian measurand words (no ASDU header). Also usable on already validated views*/
+  static void DecodeWords(const unsigned char *pWords, size_t Count, const float *Scale, float *Values,
+                          unsigned char *Quality) {
+    size_t i = 0;
+#ifdef IEC8705103_MEASURANDS_AVX2
+    for (; i + 16 <= Count; i += 16) Decode16(pWords + 2 * i, Scale + i, Values + i, Quality + i);
+#endif
+#ifdef IEC8705103_MEASURANDS_SSE2
+    for (; i + 8 <= Count; i += 8) Decode8(pWords + 2 * i, Scale + i, Values + i, Quality + i);
+#endif
+    for (; i < Count; i++) {
+      unsigned short raw = static_cast<unsigned short>(pWords[2 * i] | (pWords[2 * i + 1] << 8));
+      Values[i] = (static_cast<short>(raw) >> 3) * Step() * Scale[i];
+      Quality[i] = static_cast<unsigned char>(raw & 0x3);
+    }
+  }
+
+ private:
+#ifdef IEC8705103_MEASURANDS_SSE2
+  static void Decode8(const unsigned char *pWords, const float *Scale, float *Values, unsigned char *Quality) {
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pWords));
+    __m128i value = _mm_srai_epi16(raw, 3);
+    __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16); /*Sign extension to 32 bits*/
+    __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+    __m128 step = _mm_set1_ps(Step());
+
+    _mm_storeu_ps(Values, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), step), _mm_loadu_ps(Scale)));
+    _mm_storeu_ps(Values + 4, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), step), _mm_loadu_ps(Scale + 4)));
+
+    __m128i flags = _mm_and_si128(raw, _mm_set1_epi16(0x3));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(Quality), _mm_packus_epi16(flags, flags));
+  }
+#endif
+
+#ifdef IEC8705103_MEASURANDS_AVX2
+  static void Decode16(const unsigned char *pWords, const float *Scale, float *Values, unsigned char *Quality) {
+    __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pWords));
+    __m256i value = _mm256_srai_epi16(raw, 3);
+    __m256i low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(value));
+    __m256i high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(value, 1));
+    __m256 step = _mm256_set1_ps(Step());
+
+    _mm256_storeu_ps(Values, _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(low), step), _mm256_loadu_ps(Scale)));
+    _mm256_storeu_ps(Values + 8,
+                     _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(high), step), _mm256_loadu_ps(Scale + 8)));
+
+    __m256i flags = _mm256_and_si256(raw, _mm256_set1_epi16(0x3));
+    __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(flags), _mm256_extracti128_si256(flags, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(Quality), packed);
+  }
+#endif
+
+} IEC8705103MeasurandDecoder; /*ASDU 3/9 to scaled floats and quality*/
+
+#endif
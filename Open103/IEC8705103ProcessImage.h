@@ -0,0 +1,330 @@
+#ifndef IEC8705103PROCESSIMAGE_H
+#define IEC8705103PROCESSIMAGE_H
+#pragma once
+
+#include <vector>
+#include "IEC8705103Dispatcher.h"
+#include "IEC8705103Manager.h"
+
+/*Latest state of one point of the image*/
+typedef struct ProcessPoint_ {
+  enum Kind { DoublePoint = 1, Measurand = 2, Energy = 3 };
+
+  enum Quality {
+    Overflow = 0x01, /*OV bit of a measurand*/
+    Error = 0x02,    /*ER bit of a measurand*/
+    Invalid = 0x04,  /*DPI 0 (intermediate) or 3 (indeterminate)*/
+    Timed = 0x08     /*Time comes from the equipment (ASDU 1, 2, 4). Otherwise Time is empty*/
+  };
+
+  unsigned char Address; /*Common address of ASDU*/
+  unsigned char FunctionType;
+  unsigned char InformationNumber;
+  unsigned char Element; /*Position of the value inside ASDU 3/9, 0 for the other types*/
+  unsigned char Kind;
+  unsigned char Quality;
+  unsigned short Type; /*Type identification of the last update*/
+  double Value;        /*DPI (1 OFF, 2 ON), 13 bit measurand, short-circuit location or counter value*/
+  IEC8705103Manager::cp56Time2A Time;
+  unsigned int Changes; /*Incremented on every notified change*/
+} ProcessPoint;
+
+/*Receives every point update of a process image, grouped by ASDU (see IEC8705103ProcessImage::Publish)*/
+class IEC8705103ImageWriter {
+ public:
+  virtual ~IEC8705103ImageWriter() {}
+
+  virtual void BeginWrite(unsigned char Address) = 0;
+  virtual void Write(size_t Index, const ProcessPoint &Point) = 0; /*Index: position of the point in the image*/
+  virtual void EndWrite(unsigned char Address) = 0;
+};
+
+/*
+In-memory process image: the latest value of every point, keyed by (common address, FUN, INF, element).
+
+Points are stored densely in arrival order; an open addressing hash table (linear probing, power of two size) maps the
+packed key to their index. Points are created by the first ASDU that carries them and never removed.
+A point changes when its value or quality differs from the stored one, or when a time-tagged ASDU brings a new time
+(an event repeating the same state). Only then Changes is incremented and the subscribers whose filter matches are
+called, in the updating thread: nobody has to scan the table to find what changed.
+
+The image is not synchronized: one thread updates it and runs the notifications.
+*/
+typedef class IEC8705103ProcessImage_ {
+ public:
+  static const int Any = -1; /*Subscription filter accepting every address, function type or information number*/
+
+  typedef void (*Listener)(void *Context, const ProcessPoint &Point);
+
+  IEC8705103ProcessImage_() : mask(0), writer(0) { Rehash(64); }
+
+  /*
+  Stores the points carried by a received ASDU (types 1, 2, 3, 4, 9 and 205).
+  Returns false for other types and for malformed ASDUs.
+  */
+  bool Update(const void *pAsdu, size_t Size) {
+    ASDUView asdu(pAsdu, Size);
+
+    switch (asdu.TypeIdentification()) {
+      case 1:
+      case 2: {
+        TimeTaggedMessageView message;
+        if (!message.Bind(asdu)) return false;
+        Apply(asdu, message);
+        return true;
+      }
+      case 3:
+      case 9: {
+        MeasurandsView measurands;
+        if (!measurands.Bind(asdu)) return false;
+        Apply(asdu, measurands);
+        return true;
+      }
+      case 4: {
+        TimeTaggedMeasurandView measurand;
+        if (!measurand.Bind(asdu)) return false;
+        Apply(asdu, measurand);
+        return true;
+      }
+      case 205: {
+        EnergyCounterView counter;
+        if (!counter.Bind(asdu)) return false;
+        Apply(asdu, counter);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  /*Registers the image on a dispatcher for every type it stores*/
+  void Attach(IEC8705103Dispatcher &Dispatcher) {
+    Dispatcher.Register<1>(&OnAsdu<TimeTaggedMessageView>, this);
+    Dispatcher.Register<2>(&OnAsdu<TimeTaggedMessageView>, this);
+    Dispatcher.Register<3>(&OnAsdu<MeasurandsView>, this);
+    Dispatcher.Register<4>(&OnAsdu<TimeTaggedMeasurandView>, this);
+    Dispatcher.Register<9>(&OnAsdu<MeasurandsView>, this);
+    Dispatcher.Register<205>(&OnAsdu<EnergyCounterView>, this);
+  }
+
+  /*Point with this key, 0 if never received. The pointer is valid until a new point is added*/
+  const ProcessPoint *Find(unsigned char Address, unsigned char FunctionType, unsigned char InformationNumber,
+                           unsigned char Element = 0) const {
+    unsigned int key = Key(Address, FunctionType, InformationNumber, Element);
+    for (size_t i = Hash(key);; i = (i + 1) & mask) {
+      unsigned int slot = table[i];
+      if (slot == 0) return 0;
+      if (keys[slot - 1] == key) return &points[slot - 1];
+    }
+  }
+
+  /*Points in arrival order: index i is a stable identifier of a point*/
+  size_t GetPointCount() const { return points.size(); }
+  const ProcessPoint &GetPoint(size_t Index) const { return points[Index]; }
+
+  /*Reserves room for Count points, so that Find pointers stay valid while they arrive*/
+  void Reserve(size_t Count) {
+    points.reserve(Count);
+    keys.reserve(Count);
+    if (Count * 2 > table.size()) Rehash(Capacity(Count));
+  }
+
+  /*
+  Calls listener on every change of a point matching the filter (Any matches everything).
+  Returns false if the filter is out of range.
+  */
+  bool Subscribe(Listener listener, void *Context, int Address = Any, int FunctionType = Any,
+                 int InformationNumber = Any) {
+    if (listener == 0 || !InRange(Address) || !InRange(FunctionType) || !InRange(InformationNumber)) return false;
+
+    Subscription s;
+    s.listener = listener;
+    s.context = Context;
+    s.address = static_cast<short>(Address);
+    s.functionType = static_cast<short>(FunctionType);
+    s.informationNumber = static_cast<short>(InformationNumber);
+    subscriptions.push_back(s);
+    return true;
+  }
+
+  /*
+  Mirrors every update to Writer (0 to stop), in the updating thread: points already in the image are written first.
+  Used to publish the image to reader threads through an IEC8705103SharedImage.
+  */
+  void Publish(IEC8705103ImageWriter *Writer) {
+    writer = Writer;
+    if (writer == 0) return;
+
+    for (size_t i = 0; i < points.size(); i++) {
+      writer->BeginWrite(points[i].Address);
+      writer->Write(i, points[i]);
+      writer->EndWrite(points[i].Address);
+    }
+  }
+
+  /*Removes every subscription made with Context*/
+  void Unsubscribe(void *Context) {
+    for (size_t i = subscriptions.size(); i-- > 0;)
+      if (subscriptions[i].context == Context) subscriptions.erase(subscriptions.begin() + i);
+  }
+
+ private:
+  typedef struct Subscription_ {
+    Listener listener;
+    void *context;
+    short address;
+    short functionType;
+    short informationNumber;
+
+    bool Matches(const ProcessPoint &p) const {
+      return (address == Any || address == p.Address) && (functionType == Any || functionType == p.FunctionType) &&
+             (informationNumber == Any || informationNumber == p.InformationNumber);
+    }
+  } Subscription;
+
+  template <class View>
+  static void OnAsdu(void *Context, const ASDUView &Asdu, View &Body) {
+    static_cast<IEC8705103ProcessImage_ *>(Context)->Apply(Asdu, Body);
+  }
+
+  template <class View>
+  void Apply(const ASDUView &Asdu, View &Body) {
+    if (writer != 0) writer->BeginWrite(Asdu.CommonAddress());
+    Store(Asdu, Body);
+    if (writer != 0) writer->EndWrite(Asdu.CommonAddress());
+  }
+
+  void Store(const ASDUView &Asdu, TimeTaggedMessageView &message) {
+    unsigned char dpi = message.DPI();
+    unsigned char quality = ProcessPoint::Timed;
+    if (dpi == 0 || dpi == 3) quality |= ProcessPoint::Invalid;
+
+    Set(Asdu, 0, ProcessPoint::DoublePoint, dpi, quality, IEC8705103Manager::cp56Time2A(message.Time(), 4));
+  }
+
+  void Store(const ASDUView &Asdu, MeasurandsView &measurands) {
+    for (unsigned char i = 0; i < measurands.Count(); i++) {
+      unsigned char quality = 0;
+      if (measurands.Overflow(i)) quality |= ProcessPoint::Overflow;
+      if (measurands.Error(i)) quality |= ProcessPoint::Error;
+
+      Set(Asdu, i, ProcessPoint::Measurand, measurands.Value(i), quality, NoTime());
+    }
+  }
+
+  void Store(const ASDUView &Asdu, TimeTaggedMeasurandView &measurand) {
+    Set(Asdu, 0, ProcessPoint::Measurand, measurand.ShortCircuitLocation(), ProcessPoint::Timed,
+        IEC8705103Manager::cp56Time2A(measurand.Time(), 4));
+  }
+
+  void Store(const ASDUView &Asdu, EnergyCounterView &counter) {
+    Set(Asdu, 0, ProcessPoint::Energy, counter.Value(), 0, NoTime());
+  }
+
+  void Set(const ASDUView &Asdu, unsigned char Element, unsigned char Kind, double Value, unsigned char Quality,
+           const IEC8705103Manager::cp56Time2A &Time) {
+    bool created = false;
+    ProcessPoint &p = Get(Asdu.CommonAddress(), Asdu.FunctionType(), Asdu.InformationNumber(), Element, &created);
+
+    bool changed = created || p.Value != Value || p.Quality != Quality ||
+                   ((Quality & ProcessPoint::Timed) != 0 && !SameTime(p.Time, Time));
+
+    p.Kind = Kind;
+    p.Type = Asdu.TypeIdentification();
+    p.Value = Value;
+    p.Quality = Quality;
+    p.Time = Time;
+    if (writer != 0) writer->Write(&p - &points[0], p);
+    if (!changed) return;
+
+    p.Changes++;
+    for (size_t i = 0; i < subscriptions.size(); i++)
+      if (subscriptions[i].Matches(p)) subscriptions[i].listener(subscriptions[i].context, p);
+  }
+
+  ProcessPoint &Get(unsigned char Address, unsigned char FunctionType, unsigned char InformationNumber,
+                    unsigned char Element, bool *Created) {
+    unsigned int key = Key(Address, FunctionType, InformationNumber, Element);
+    size_t i = Hash(key);
+    for (;; i = (i + 1) & mask) {
+      unsigned int slot = table[i];
+      if (slot == 0) break;
+      if (keys[slot - 1] == key) return points[slot - 1];
+    }
+
+    ProcessPoint p;
+    p.Address = Address;
+    p.FunctionType = FunctionType;
+    p.InformationNumber = InformationNumber;
+    p.Element = Element;
+    p.Kind = 0;
+    p.Quality = 0;
+    p.Type = 0;
+    p.Value = 0;
+    p.Time = NoTime();
+    p.Changes = 0;
+
+    points.push_back(p);
+    keys.push_back(key);
+    *Created = true;
+
+    if (points.size() * 2 > table.size())
+      Rehash(table.size() * 2);
+    else
+      table[i] = static_cast<unsigned int>(points.size());
+
+    return points.back();
+  }
+
+  /*Rebuilds the hash table with Size slots (power of two) from the dense arrays*/
+  void Rehash(size_t Size) {
+    table.assign(Size, 0);
+    mask = Size - 1;
+    for (size_t p = 0; p < keys.size(); p++) {
+      size_t i = Hash(keys[p]);
+      while (table[i] != 0) i = (i + 1) & mask;
+      table[i] = static_cast<unsigned int>(p + 1);
+    }
+  }
+
+  static size_t Capacity(size_t Count) {
+    size_t size = 64;
+    while (size < Count * 2) size *= 2;
+    return size;
+  }
+
+  size_t Hash(unsigned int Key) const {
+    unsigned int h = Key * 2654435761u; /*Fibonacci hashing, high bits folded down*/
+    return (h ^ (h >> 16)) & mask;
+  }
+
+  static unsigned int Key(unsigned char Address, unsigned char FunctionType, unsigned char InformationNumber,
+                          unsigned char Element) {
+    return static_cast<unsigned int>(Address) << 24 | static_cast<unsigned int>(FunctionType) << 16 |
+           static_cast<unsigned int>(InformationNumber) << 8 | Element;
+  }
+
+  static bool InRange(int Filter) { return Filter >= Any && Filter <= 255; }
+
+  static IEC8705103Manager::cp56Time2A NoTime() {
+    static const unsigned char empty[7] = {0};
+    return IEC8705103Manager::cp56Time2A(empty, sizeof(empty));
+  }
+
+  static bool SameTime(const IEC8705103Manager::cp56Time2A &a, const IEC8705103Manager::cp56Time2A &b) {
+    return a.GetMilliseconds() == b.GetMilliseconds() && a.GetMinutes() == b.GetMinutes() &&
+           a.GetHours() == b.GetHours() && a.GetDayMonth() == b.GetDayMonth() && a.GetMonth() == b.GetMonth() &&
+           a.GetYear() == b.GetYear();
+  }
+
+  std::vector<ProcessPoint> points;
+  std::vector<unsigned int> keys;  /*Packed key of points[i]*/
+  std::vector<unsigned int> table; /*Index + 1 in points, 0 for free slots*/
+  size_t mask;
+
+  std::vector<Subscription> subscriptions;
+  IEC8705103ImageWriter *writer;
+
+} IEC8705103ProcessImage; /*Latest value of every received point*/
+
+#endif
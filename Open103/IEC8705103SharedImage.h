@@ -0,0 +1,222 @@
+#ifndef IEC8705103SHAREDIMAGE_H
+#define IEC8705103SHAREDIMAGE_H
+#pragma once
+
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "IEC8705103ProcessImage.h"
+
+/*
+Copy of the process image that other threads read while the poll thread keeps updating it.
+
+Points are grouped by common address in one page per device, each protected by a sequence lock: the writer makes the
+device sequence odd, stores the points of one ASDU and makes it even again. Readers never block the writer: they copy
+the page and retry if the sequence was odd or moved meanwhile. Every point is kept as four 64 bit words read and
+written with relaxed atomics, so a torn copy is only ever discarded, never undefined behaviour.
+A page that fills up is replaced by one twice as large; the old one is kept until the image is destroyed because a
+reader may still be copying it (pages only grow, so at most as much memory again is retired).
+A whole image sequence moves with every device sequence, for readers that need all devices from the same instant.
+
+Only one thread may write: the one updating the process image it is published by (IEC8705103ProcessImage::Publish).
+*/
+typedef class IEC8705103SharedImage_ : public IEC8705103ImageWriter {
+ public:
+  IEC8705103SharedImage_() : image(0) {
+    for (int i = 0; i < 256; i++) {
+      devices[i].sequence.store(0, std::memory_order_relaxed);
+      devices[i].page.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  ~IEC8705103SharedImage_() {
+    for (int i = 0; i < 256; i++) delete devices[i].page.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < retired.size(); i++) delete retired[i];
+  }
+
+  /*Writer: opens the update of one device (one ASDU)*/
+  virtual void BeginWrite(unsigned char Address) {
+    Device &d = devices[Address];
+    image.store(image.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    d.sequence.store(d.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  /*Writer: stores point Index (its position in the process image) between BeginWrite and EndWrite*/
+  virtual void Write(size_t Index, const ProcessPoint &Point) {
+    if (Index >= slotOf.size()) slotOf.resize(Index + 1, static_cast<unsigned int>(NoSlot));
+
+    Device &d = devices[Point.Address];
+    Page *page = d.page.load(std::memory_order_relaxed);
+
+    if (slotOf[Index] == NoSlot) {
+      size_t count = page != 0 ? page->count.load(std::memory_order_relaxed) : 0;
+      if (page == 0 || count == page->capacity) page = Grow(d, page, count);
+
+      slotOf[Index] = static_cast<unsigned int>(count);
+      page->count.store(count + 1, std::memory_order_relaxed);
+    }
+
+    Pack(Point, page->slots[slotOf[Index]]);
+  }
+
+  /*Writer: publishes the points written since BeginWrite*/
+  virtual void EndWrite(unsigned char Address) {
+    Device &d = devices[Address];
+    d.sequence.store(d.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    image.store(image.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /*
+  Reader: consistent copy of every point of a device, in arrival order.
+  Returns the device generation (number of updates), 0 if nothing has been received from Address yet.
+  */
+  unsigned int ReadDevice(unsigned char Address, std::vector<ProcessPoint> *Points) const {
+    Points->clear();
+    const Device &d = devices[Address];
+
+    for (unsigned int attempt = 0;; attempt++) {
+      unsigned int before = d.sequence.load(std::memory_order_acquire);
+      if ((before & 1) == 0) {
+        Copy(d.page.load(std::memory_order_acquire), Points);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (d.sequence.load(std::memory_order_relaxed) == before) return before / 2;
+        Points->clear();
+      }
+      if (attempt >= SpinAttempts) std::this_thread::yield();
+    }
+  }
+
+  /*
+  Reader: copy of every device, each one consistent. Returns true if no update at all happened during the copy (the
+  whole image is from the same instant); after MaxAttempts busy copies returns false with the last one.
+  */
+  bool ReadImage(std::vector<ProcessPoint> *Points, unsigned int MaxAttempts = 8) const {
+    std::vector<ProcessPoint> device;
+
+    for (unsigned int attempt = 1;; attempt++) {
+      Points->clear();
+      unsigned int before = image.load(std::memory_order_acquire);
+
+      for (int a = 0; a < 256; a++) {
+        if (devices[a].page.load(std::memory_order_acquire) == 0) continue;
+        ReadDevice(static_cast<unsigned char>(a), &device);
+        Points->insert(Points->end(), device.begin(), device.end());
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((before & 1) == 0 && image.load(std::memory_order_relaxed) == before) return true;
+      if (attempt >= MaxAttempts) return false;
+    }
+  }
+
+  /*Reader: number of updates of a device so far. Cheap way to know if ReadDevice would return something new*/
+  unsigned int GetGeneration(unsigned char Address) const {
+    return devices[Address].sequence.load(std::memory_order_acquire) / 2;
+  }
+
+ private:
+  static const unsigned int NoSlot = 0xFFFFFFFF;
+  static const unsigned int SpinAttempts = 64; /*Read retries before yielding to the writer*/
+  static const size_t FirstPageSize = 16;
+
+  typedef struct Slot_ {
+    std::atomic<unsigned long long> words[4]; /*Identification and kind, value, time, changes*/
+  } Slot;
+
+  typedef struct Page_ {
+    Page_(size_t Capacity) : capacity(Capacity), slots(new Slot[Capacity]) { count.store(0); }
+    ~Page_() { delete[] slots; }
+
+    const size_t capacity;
+    std::atomic<size_t> count;
+    Slot *slots;
+
+   private:
+    Page_(const Page_ &);
+    Page_ &operator=(const Page_ &);
+  } Page;
+
+  typedef struct Device_ {
+    std::atomic<unsigned int> sequence; /*Odd while the writer updates the device*/
+    std::atomic<Page *> page;
+  } Device;
+
+  Page *Grow(Device &d, Page *old, size_t count) {
+    Page *page = new Page(old != 0 ? old->capacity * 2 : FirstPageSize);
+    for (size_t i = 0; i < count; i++)
+      for (int w = 0; w < 4; w++)
+        page->slots[i].words[w].store(old->slots[i].words[w].load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+    page->count.store(count, std::memory_order_relaxed);
+
+    d.page.store(page, std::memory_order_release);
+    if (old != 0) retired.push_back(old);
+    return page;
+  }
+
+  static void Pack(const ProcessPoint &p, Slot &s) {
+    unsigned long long id = static_cast<unsigned long long>(p.Address) |
+                            static_cast<unsigned long long>(p.FunctionType) << 8 |
+                            static_cast<unsigned long long>(p.InformationNumber) << 16 |
+                            static_cast<unsigned long long>(p.Element) << 24 |
+                            static_cast<unsigned long long>(p.Kind) << 32 |
+                            static_cast<unsigned long long>(p.Quality) << 40 |
+                            static_cast<unsigned long long>(p.Type) << 48;
+    unsigned long long value = 0;
+    memcpy(&value, &p.Value, sizeof(p.Value));
+
+    /*The seven octets of the time, not the struct: its padding is undefined*/
+    unsigned char octets[ASDUView::Cp56Size];
+    p.Time.GetOctets(octets);
+    unsigned long long time = 0;
+    for (size_t i = 0; i < ASDUView::Cp56Size; i++) time |= static_cast<unsigned long long>(octets[i]) << (8 * i);
+
+    s.words[0].store(id, std::memory_order_relaxed);
+    s.words[1].store(value, std::memory_order_relaxed);
+    s.words[2].store(time, std::memory_order_relaxed);
+    s.words[3].store(p.Changes, std::memory_order_relaxed);
+  }
+
+  static void Unpack(const Slot &s, ProcessPoint *p) {
+    unsigned long long id = s.words[0].load(std::memory_order_relaxed);
+    unsigned long long value = s.words[1].load(std::memory_order_relaxed);
+    unsigned long long time = s.words[2].load(std::memory_order_relaxed);
+
+    p->Address = static_cast<unsigned char>(id);
+    p->FunctionType = static_cast<unsigned char>(id >> 8);
+    p->InformationNumber = static_cast<unsigned char>(id >> 16);
+    p->Element = static_cast<unsigned char>(id >> 24);
+    p->Kind = static_cast<unsigned char>(id >> 32);
+    p->Quality = static_cast<unsigned char>(id >> 40);
+    p->Type = static_cast<unsigned short>(id >> 48);
+    memcpy(&p->Value, &value, sizeof(p->Value));
+
+    unsigned char octets[ASDUView::Cp56Size];
+    for (size_t i = 0; i < ASDUView::Cp56Size; i++) octets[i] = static_cast<unsigned char>(time >> (8 * i));
+    p->Time = IEC8705103Manager::cp56Time2A(octets);
+    p->Changes = static_cast<unsigned int>(s.words[3].load(std::memory_order_relaxed));
+  }
+
+  static void Copy(const Page *page, std::vector<ProcessPoint> *Points) {
+    if (page == 0) return;
+
+    size_t count = page->count.load(std::memory_order_relaxed);
+
+    Points->resize(count);
+    for (size_t i = 0; i < count; i++) Unpack(page->slots[i], &(*Points)[i]);
+  }
+
+  Device devices[256];
+  std::atomic<unsigned int> image; /*Whole image sequence, odd while any device is being updated*/
+
+  std::vector<unsigned int> slotOf; /*Writer only: slot of each process image point in its device page*/
+  std::vector<Page *> retired;      /*Writer only: replaced pages, still readable*/
+
+} IEC8705103SharedImage; /*Lock-free readable copy of the process image*/
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef IEC8705103SKEWESTIMATOR_H
+#define IEC8705103SKEWESTIMATOR_H
+#pragma once
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Time.h"
+
+/*
+Estimates offset and drift of the clock of every equipment from its time-tagged events.
+
+Each spontaneous ASDU 1, 2 or 4 (cause of transmission 1) gives a sample: device time of the event minus local time
+at which the link layer received it (IEC8705103Manager::GetLastReceiveTime). The difference is the clock offset minus
+the delay before the event was reported, so the largest sample of a window (the event reported soonest) is kept as
+the offset of that window. Answers to general interrogation are ignored: they carry the time of the last change.
+Window offsets go into a linear regression with exponential forgetting: the intercept is the current offset, the
+slope the drift. Memory is constant: five running sums per equipment.
+When the estimated offset exceeds Threshold the resync handler is called (e.g. to run IEC8705103ClockSync) and the
+equipment starts again from scratch, as its clock is about to jump.
+Local times must come from the same clock as the UTC device times (gettimeofday); both are nanoseconds.
+*/
+typedef class IEC8705103SkewEstimator_ {
+ public:
+  /*Offset: nanoseconds, positive when the equipment is ahead. Drift: parts per million*/
+  typedef void (*ResyncHandler)(void *Context, unsigned char Address, long long Offset, double Drift);
+
+  IEC8705103SkewEstimator_(const IEC8705103TimeConverter &Converter, long long Window = 60000000000LL,
+                           long long Threshold = 10000000LL, double Forgetting = 0.9)
+      : converter(Converter), window(Window), threshold(Threshold), forgetting(Forgetting), handler(0), context(0) {
+    for (int i = 0; i < 256; i++) Reset(static_cast<unsigned char>(i));
+  }
+
+  void SetResyncHandler(ResyncHandler Handler, void *Context) {
+    handler = Handler;
+    context = Context;
+  }
+
+  /*Pairs the time of a received ASDU with the local time of its reception. Returns true if it gave a sample*/
+  bool OnAsdu(unsigned char Address, const void *pAsdu, size_t Size, long long ReceivedNs) {
+    ASDUView asdu(pAsdu, Size);
+    if (asdu.CauseOfTransmission() != 1) return false;
+
+    TimeTaggedMessageView message;
+    TimeTaggedMeasurandView measurand;
+    const unsigned char *time;
+    if (message.Bind(asdu))
+      time = message.Time();
+    else if (measurand.Bind(asdu))
+      time = measurand.Time();
+    else
+      return false;
+
+    long long device;
+    converter.SetReference(ReceivedNs);
+    if (!converter.FromCp32(time, &device)) return false;
+
+    AddSample(Address, device, ReceivedNs);
+    return true;
+  }
+
+  /*Adds a pair of device time of an event and local time of its reception*/
+  void AddSample(unsigned char Address, long long DeviceNs, long long ReceivedNs) {
+    State &s = states[Address];
+    long long offset = DeviceNs - ReceivedNs;
+
+    if (s.windowStart == 0) {
+      s.windowStart = ReceivedNs;
+      s.windowMax = offset;
+      s.windowTime = ReceivedNs;
+      return;
+    }
+
+    if (ReceivedNs - s.windowStart < window) {
+      if (offset > s.windowMax) {
+        s.windowMax = offset;
+        s.windowTime = ReceivedNs;
+      }
+      return;
+    }
+
+    CloseWindow(Address);
+
+    s.windowStart = ReceivedNs;
+    s.windowMax = offset;
+    s.windowTime = ReceivedNs;
+  }
+
+  /*
+  Offset at Now (nanoseconds, positive when the equipment is ahead) and drift (ppm) of an equipment.
+  Returns false before the first window is closed; Drift is 0 until two windows are.
+  */
+  bool GetEstimate(unsigned char Address, long long Now, long long *Offset, double *Drift) const {
+    const State &s = states[Address];
+    if (s.windows == 0) return false;
+
+    double slope = 0;
+    double intercept = s.sy / s.s;
+    double denominator = s.s * s.sxx - s.sx * s.sx;
+    if (s.windows > 1 && denominator > 0) {
+      slope = (s.s * s.sxy - s.sx * s.sy) / denominator;
+      intercept = (s.sy - slope * s.sx) / s.s;
+    }
+
+    double x = static_cast<double>(Now - s.origin) / 1e9;
+    *Offset = static_cast<long long>((intercept + slope * x) * 1e6);
+    *Drift = slope * 1000; /*Milliseconds per second to ppm*/
+    return true;
+  }
+
+  /*Forgets everything about an equipment, e.g. after synchronizing it*/
+  void Reset(unsigned char Address) {
+    State &s = states[Address];
+    s.windowStart = 0;
+    s.windowMax = 0;
+    s.windowTime = 0;
+    s.origin = 0;
+    s.windows = 0;
+    s.s = s.sx = s.sy = s.sxx = s.sxy = 0;
+  }
+
+ private:
+  typedef struct State_ {
+    long long windowStart; /*Reception of the first sample of the open window, 0 if none*/
+    long long windowMax;   /*Largest offset of the open window*/
+    long long windowTime;  /*Its reception*/
+    long long origin;      /*Reception time of x = 0*/
+    unsigned int windows;  /*Windows closed*/
+    double s, sx, sy, sxx, sxy; /*Weighted sums, x in seconds from origin, y in milliseconds*/
+  } State;
+
+  void CloseWindow(unsigned char Address) {
+    State &s = states[Address];
+    if (s.windows == 0) s.origin = s.windowTime;
+
+    double x = static_cast<double>(s.windowTime - s.origin) / 1e9;
+    double y = static_cast<double>(s.windowMax) / 1e6;
+
+    s.s = s.s * forgetting + 1;
+    s.sx = s.sx * forgetting + x;
+    s.sy = s.sy * forgetting + y;
+    s.sxx = s.sxx * forgetting + x * x;
+    s.sxy = s.sxy * forgetting + x * y;
+    s.windows++;
+
+    long long offset;
+    double drift;
+    if (handler == 0 || !GetEstimate(Address, s.windowTime, &offset, &drift)) return;
+    if (offset < threshold && offset > -threshold) return;
+
+    Reset(Address);
+    handler(context, Address, offset, drift);
+  }
+
+  IEC8705103TimeConverter converter;
+  const long long window;
+  const long long threshold;
+  const double forgetting;
+
+  State states[256];
+
+  ResyncHandler handler;
+  void *context;
+
+} IEC8705103SkewEstimator; /*Clock offset and drift of every equipment*/
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef IEC8705103SOE_H
+#define IEC8705103SOE_H
+#pragma once
+
+#include <limits.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "IEC8705103Asdu.h"
+#include "IEC8705103Time.h"
+
+/*One event of the sequence of events*/
+typedef struct SoeEvent_ {
+  long long Time;     /*Device time of the event, UTC nanoseconds*/
+  long long Received; /*Local time of reception, UTC nanoseconds*/
+  unsigned int Source; /*Ring the event came from, see IEC8705103SoeMerger::AddSource*/
+  unsigned char Address;
+  unsigned char Type; /*ASDU 1 or 2*/
+  unsigned char CauseOfTransmission;
+  unsigned char FunctionType;
+  unsigned char InformationNumber;
+  unsigned char DPI;
+  unsigned char SupplementaryInformation;
+  bool Late; /*Arrived after events with a later time had been emitted: out of order*/
+  unsigned short RelativeTime; /*ASDU 2 only*/
+  unsigned short FaultNumber;  /*ASDU 2 only*/
+} SoeEvent;
+
+/*
+Events of one equipment, waiting to be merged.
+
+One ring per equipment, never shared: the merger relies on the events of a ring being in time order, and only the
+events of one equipment are (it reports its buffer oldest first). A thread polling several equipment uses one ring
+for each of them.
+Single producer, single consumer ring without locks: the thread that polls the equipment calls Post() or Push(), the
+merger reads. The capacity is a power of two fixed at construction; when the ring is full new events are dropped
+and counted.
+*/
+typedef class IEC8705103SoeRing_ {
+ public:
+  IEC8705103SoeRing_(unsigned int Source, unsigned char Address, size_t Capacity,
+                     const IEC8705103TimeConverter &Converter)
+      : source(Source), address(Address), slots(RoundUp(Capacity)), mask(RoundUp(Capacity) - 1),
+        converter(Converter) {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+  }
+
+  /*
+  Decodes an ASDU 1 or 2 received from the equipment of the ring at ReceivedNs (UTC nanoseconds) and queues it.
+  Answers to general interrogation are not events (they report the last change) and are ignored.
+  Returns false if the ASDU is not an event or the ring is full.
+  */
+  bool Post(const void *pAsdu, size_t Size, long long ReceivedNs) {
+    ASDUView asdu(pAsdu, Size);
+    TimeTaggedMessageView message;
+    if (!message.Bind(asdu) || asdu.CauseOfTransmission() == 9) return false;
+
+    SoeEvent event;
+    converter.SetReference(ReceivedNs);
+    if (!converter.FromCp32(message.Time(), &event.Time)) return false;
+
+    event.Received = ReceivedNs;
+    event.Type = asdu.TypeIdentification();
+    event.CauseOfTransmission = asdu.CauseOfTransmission();
+    event.FunctionType = asdu.FunctionType();
+    event.InformationNumber = asdu.InformationNumber();
+    event.DPI = message.DPI();
+    event.SupplementaryInformation = message.SupplementaryInformation();
+    event.RelativeTime = message.RelativeTime();
+    event.FaultNumber = message.FaultNumber();
+    return Push(event);
+  }
+
+  /*Queues an already decoded event of the equipment. Source, Address and Late are set by the ring and the merger*/
+  bool Push(const SoeEvent &Event) {
+    unsigned long long t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) > mask) {
+      dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    SoeEvent &slot = slots[static_cast<size_t>(t & mask)];
+    slot = Event;
+    slot.Source = source;
+    slot.Address = address;
+    slot.Late = false;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  unsigned char GetAddress() const { return address; }
+
+  /*Events dropped because the ring was full*/
+  unsigned long long GetDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+ private:
+  friend class IEC8705103SoeMerger_;
+
+  static size_t RoundUp(size_t Capacity) {
+    size_t size = 2;
+    while (size < Capacity) size <<= 1;
+    return size;
+  }
+
+  /*Consumer side: oldest queued event, 0 if none*/
+  const SoeEvent *Peek() const {
+    unsigned long long h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return 0;
+    return &slots[static_cast<size_t>(h & mask)];
+  }
+
+  void Pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  const unsigned int source;
+  const unsigned char address;
+  std::vector<SoeEvent> slots;
+  const unsigned long long mask;
+  IEC8705103TimeConverter converter; /*Producer side*/
+
+  /*Producer and consumer indexes on separate cache lines*/
+  char padding0[64];
+  std::atomic<unsigned long long> tail;
+  std::atomic<unsigned long long> dropped;
+  char padding1[64];
+  std::atomic<unsigned long long> head;
+  char padding2[64];
+
+} IEC8705103SoeRing;
+
+/*
+Merges the events of many rings (one per equipment) into one stream ordered by device time.
+
+Each ring holds the events of one equipment, hence in time order (an equipment reports its buffer oldest first).
+Drain() keeps the head of every non empty ring in a binary heap and emits the earliest head as long as it is older
+than Now minus the reorder window: an event still travelling (not yet polled, or sitting in a device buffer) cannot be
+earlier than that, as long as the window covers the worst reporting delay plus clock offsets between equipment. Each
+event costs one heap push and one pop, O(log sources), whatever the number of events queued. An event arriving later
+than the window is still emitted, with Late set, and counted.
+Rings are added before producers start; Drain is called by one thread only.
+*/
+typedef class IEC8705103SoeMerger_ {
+ public:
+  /*Window: reorder window, nanoseconds. RingCapacity: events per source*/
+  IEC8705103SoeMerger_(long long Window = 2000000000LL, size_t RingCapacity = 1024,
+                       const IEC8705103TimeConverter &Converter = IEC8705103TimeConverter())
+      : window(Window), ringCapacity(RingCapacity), converter(Converter), lastTime(LLONG_MIN), late(0) {}
+
+  ~IEC8705103SoeMerger_() {
+    for (size_t i = 0; i < rings.size(); i++) delete rings[i];
+  }
+
+  /*New source, the equipment at Address: its ring, to be given to the thread that polls it*/
+  IEC8705103SoeRing *AddSource(unsigned char Address) {
+    rings.push_back(
+        new IEC8705103SoeRing(static_cast<unsigned int>(rings.size()), Address, ringCapacity, converter));
+    queued.push_back(false);
+    heap.reserve(rings.size());
+    return rings.back();
+  }
+
+  /*Emits into Out (at most Capacity) the events older than Now - Window, in time order. Returns how many*/
+  size_t Drain(long long Now, SoeEvent *Out, size_t Capacity) { return Emit(Now - window, Out, Capacity); }
+
+  /*Emits every queued event whatever its time, e.g. when stopping*/
+  size_t Flush(SoeEvent *Out, size_t Capacity) { return Emit(LLONG_MAX, Out, Capacity); }
+
+  void SetWindow(long long Window) { window = Window; }
+
+  long long GetWindow() const { return window; }
+
+  /*Events emitted out of order*/
+  unsigned long long GetLateCount() const { return late; }
+
+  /*Events dropped by all rings*/
+  unsigned long long GetDroppedCount() const {
+    unsigned long long dropped = 0;
+    for (size_t i = 0; i < rings.size(); i++) dropped += rings[i]->GetDroppedCount();
+    return dropped;
+  }
+
+ private:
+  typedef struct Head_ {
+    long long Time;
+    unsigned int Source;
+  } Head;
+
+  /*Greater first, so the heap top is the earliest event; equal times go by source for a stable order*/
+  static bool Later(const Head &a, const Head &b) {
+    return a.Time != b.Time ? a.Time > b.Time : a.Source > b.Source;
+  }
+
+  size_t Emit(long long Limit, SoeEvent *Out, size_t Capacity) {
+    for (size_t i = 0; i < rings.size(); i++)
+      if (!queued[i]) Enqueue(static_cast<unsigned int>(i));
+
+    size_t count = 0;
+    while (count < Capacity && !heap.empty() && heap.front().Time <= Limit) {
+      unsigned int source = heap.front().Source;
+      std::pop_heap(heap.begin(), heap.end(), Later);
+      heap.pop_back();
+
+      IEC8705103SoeRing *ring = rings[source];
+      SoeEvent &event = Out[count++];
+      event = *ring->Peek();
+      ring->Pop();
+
+      if (event.Time < lastTime) {
+        event.Late = true;
+        late++;
+      } else {
+        lastTime = event.Time;
+      }
+
+      queued[source] = false;
+      Enqueue(source);
+    }
+    return count;
+  }
+
+  void Enqueue(unsigned int Source) {
+    const SoeEvent *event = rings[Source]->Peek();
+    if (event == 0) return;
+
+    Head head;
+    head.Time = event->Time;
+    head.Source = Source;
+    heap.push_back(head);
+    std::push_heap(heap.begin(), heap.end(), Later);
+    queued[Source] = true;
+  }
+
+  long long window;
+  const size_t ringCapacity;
+  const IEC8705103TimeConverter converter;
+
+  std::vector<IEC8705103SoeRing *> rings;
+  std::vector<bool> queued; /*Ring head is in the heap*/
+  std::vector<Head> heap;
+
+  long long lastTime; /*Latest time emitted*/
+  unsigned long long late;
+
+} IEC8705103SoeMerger; /*Time ordered sequence of events from many equipment*/
+
+#endif
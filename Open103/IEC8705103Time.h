@@ -0,0 +1,152 @@
+#ifndef IEC8705103TIME_H
+#define IEC8705103TIME_H
+#pragma once
+
+#include <string.h>
+
+/*
+Conversion between CP56Time2a / CP32Time2a and nanoseconds since 1970-01-01 UTC.
+
+Equipment clocks usually run in local time: the converter is given the offset of local time from UTC and the extra
+offset applied when the SU (summer time) bit is set. Dates are computed with integer arithmetic only (days from civil
+date), no calls to mktime/localtime and no table lookups; invalid times (IV bit, fields out of range) are detected
+with a single test at the end.
+CP32Time2a carries no date: it is placed in the day of a reference instant set with SetReference(), the one within
+12 hours of the reference. The local start of that day is computed once per SetReference and then reused, so the
+reference only needs refreshing once in a while (e.g. once per poll cycle).
+*/
+typedef class IEC8705103TimeConverter_ {
+ public:
+  static const long long NsPerMs = 1000000LL;
+  static const long long NsPerMinute = 60000LL * NsPerMs;
+  static const long long NsPerHour = 60 * NsPerMinute;
+  static const long long NsPerDay = 24 * NsPerHour;
+
+  /*UtcOffset: local time minus UTC (minutes). SummerOffset: added when the SU bit is set (minutes)*/
+  IEC8705103TimeConverter_(int UtcOffset = 0, int SummerOffset = 60)
+      : utcOffset(UtcOffset * NsPerMinute), summerOffset(SummerOffset * NsPerMinute), reference(0), dayStart(0) {
+    SetReference(0);
+  }
+
+  /*Instant CP32 times are placed around, normally the current time*/
+  void SetReference(long long Ns) {
+    reference = Ns;
+    dayStart = FloorDiv(Ns + utcOffset, NsPerDay) * NsPerDay;
+  }
+
+  /*Seven octet time to UTC nanoseconds. Returns false if the time is marked invalid or is not a valid date*/
+  bool FromCp56(const unsigned char *pTime, long long *Ns) const {
+    unsigned int ms = pTime[0] | (pTime[1] << 8);
+    unsigned int minutes = pTime[2] & 0x3F;
+    unsigned int hours = pTime[3] & 0x1F;
+    unsigned int day = pTime[4] & 0x1F;
+    unsigned int month = pTime[5] & 0x0F;
+    unsigned int year = 2000 + (pTime[6] & 0x7F);
+
+    long long local = DaysFromCivil(year, month, day) * NsPerDay + TimeOfDay(ms, minutes, hours);
+    *Ns = local - utcOffset - ((pTime[3] >> 7) * summerOffset);
+
+    return ((pTime[2] & 0x80) | (ms > 59999) | (minutes > 59) | (hours > 23) | (day == 0) | (month == 0) |
+            (month > 12)) == 0;
+  }
+
+  /*Four octet time (no date) to UTC nanoseconds, in the day of the reference. Same checks as FromCp56*/
+  bool FromCp32(const unsigned char *pTime, long long *Ns) const {
+    unsigned int ms = pTime[0] | (pTime[1] << 8);
+    unsigned int minutes = pTime[2] & 0x3F;
+    unsigned int hours = pTime[3] & 0x1F;
+
+    long long utc = dayStart + TimeOfDay(ms, minutes, hours) - utcOffset - ((pTime[3] >> 7) * summerOffset);
+    long long distance = utc - reference;
+    utc -= (distance > NsPerDay / 2) * NsPerDay;  /*Just before midnight of the day before*/
+    utc += (distance < -NsPerDay / 2) * NsPerDay; /*Just after midnight of the day after*/
+    *Ns = utc;
+
+    return ((pTime[2] & 0x80) | (ms > 59999) | (minutes > 59) | (hours > 23)) == 0;
+  }
+
+  /*
+  Converts Count times found every Stride bytes from pFirst (e.g. the entries of an ASDU 23: pFirst = entry time,
+  Stride = entry size). Valid[i] (if Valid is not 0) tells if Ns[i] is meaningful. Returns the number of valid times.
+  */
+  size_t FromCp56(const unsigned char *pFirst, size_t Stride, size_t Count, long long *Ns, bool *Valid = 0) const {
+    size_t valid = 0;
+    for (size_t i = 0; i < Count; i++) {
+      bool ok = FromCp56(pFirst + i * Stride, &Ns[i]);
+      if (Valid != 0) Valid[i] = ok;
+      valid += ok;
+    }
+    return valid;
+  }
+
+  size_t FromCp32(const unsigned char *pFirst, size_t Stride, size_t Count, long long *Ns, bool *Valid = 0) const {
+    size_t valid = 0;
+    for (size_t i = 0; i < Count; i++) {
+      bool ok = FromCp32(pFirst + i * Stride, &Ns[i]);
+      if (Valid != 0) Valid[i] = ok;
+      valid += ok;
+    }
+    return valid;
+  }
+
+  /*UTC nanoseconds to seven octets (years 2000..2099), with the day of week. SummerTime sets SU and its offset*/
+  void ToCp56(long long Ns, unsigned char *pTime, bool SummerTime = false) const {
+    long long local = Ns + utcOffset + (SummerTime ? summerOffset : 0);
+    long long days = FloorDiv(local, NsPerDay);
+    long long inDay = local - days * NsPerDay;
+
+    unsigned int ms = static_cast<unsigned int>(inDay % NsPerMinute / NsPerMs);
+    unsigned int year;
+    unsigned int month;
+    unsigned int day;
+    CivilFromDays(days, &year, &month, &day);
+    unsigned int weekday = static_cast<unsigned int>(FloorMod(days + 3, 7) + 1); /*1970-01-01 was a Thursday*/
+
+    pTime[0] = static_cast<unsigned char>(ms);
+    pTime[1] = static_cast<unsigned char>(ms >> 8);
+    pTime[2] = static_cast<unsigned char>(inDay / NsPerMinute % 60);
+    pTime[3] = static_cast<unsigned char>(inDay / NsPerHour | (SummerTime ? 0x80 : 0));
+    pTime[4] = static_cast<unsigned char>(day | weekday << 5);
+    pTime[5] = static_cast<unsigned char>(month);
+    pTime[6] = static_cast<unsigned char>((year - 2000) & 0x7F);
+  }
+
+  /*Days from 1970-01-01 of a date of the proleptic Gregorian calendar*/
+  static long long DaysFromCivil(unsigned int Year, unsigned int Month, unsigned int Day) {
+    unsigned int y = Year - (Month <= 2);
+    unsigned int era = y / 400;
+    unsigned int yoe = y - era * 400;
+    unsigned int doy = (153 * (Month + (Month > 2 ? -3 : 9)) + 2) / 5 + Day - 1;
+    unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return static_cast<long long>(era) * 146097 + doe - 719468;
+  }
+
+  static void CivilFromDays(long long Days, unsigned int *Year, unsigned int *Month, unsigned int *Day) {
+    long long z = Days + 719468;
+    long long era = FloorDiv(z, 146097);
+    unsigned int doe = static_cast<unsigned int>(z - era * 146097);
+    unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned int mp = (5 * doy + 2) / 153;
+
+    *Day = doy - (153 * mp + 2) / 5 + 1;
+    *Month = mp < 10 ? mp + 3 : mp - 9;
+    *Year = static_cast<unsigned int>(yoe + era * 400 + (*Month <= 2));
+  }
+
+ private:
+  static long long TimeOfDay(unsigned int ms, unsigned int minutes, unsigned int hours) {
+    return ms * NsPerMs + minutes * NsPerMinute + hours * NsPerHour;
+  }
+
+  static long long FloorDiv(long long a, long long b) { return a / b - (a % b < 0); }
+  static long long FloorMod(long long a, long long b) { return a - FloorDiv(a, b) * b; }
+
+  long long utcOffset;
+  long long summerOffset;
+  long long reference; /*UTC*/
+  long long dayStart;  /*Local start of the day of the reference*/
+
+} IEC8705103TimeConverter; /*CP56/CP32 time to and from epoch nanoseconds*/
+
+#endif
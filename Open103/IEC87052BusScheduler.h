@@ -0,0 +1,128 @@
+#ifndef IEC87052BUSSCHEDULER_H
+#define IEC87052BUSSCHEDULER_H
+#pragma once
+
+#include "IEC87052Manager.h"
+#include "IEC87052PollList.h"
+#include "gettimeofday.h"
+
+/*
+Polling scheduler for a multidrop (RS-485) line with many secondary stations.
+
+A single link layer manager is shared by every station on the bus: before each transaction the scheduler switches it
+to the station address and restores that station FCB, so the link state of each relay is kept independently.
+Who is polled next is decided by IEC87052PollList (round robin, class 1 bursts on ACD, backoff of silent stations).
+*/
+template <class Port = CommunicationPort>
+class IEC87052BusScheduler_ {
+ public:
+  typedef IEC87052PollList::StationState StationState;
+
+  IEC87052BusScheduler_(Port *port) : linklayermanager(port, 0) { ResetStatistics(); }
+
+  /*Adds a secondary station to the polling list*/
+  bool AddStation(unsigned char Address) { return pollList.AddStation(Address); }
+
+  /*Removes a secondary station from the polling list*/
+  bool RemoveStation(unsigned char Address) { return pollList.RemoveStation(Address); }
+
+  /*
+  Performs the next transaction on the bus.
+  Returns false when no station can be polled in this cycle or the polled station did not answer.
+  pAddress: station that has been polled
+  pAsdu, Size: user data of the response (Size is 0 if the station had nothing to send). Data is valid until next Poll.
+  */
+  bool Poll(unsigned char *pAddress, const void **pAsdu, size_t *Size) {
+    *pAsdu = 0;
+    *Size = 0;
+
+    int next = pollList.NextStation();
+    if (next < 0) return false;
+
+    unsigned char Address = static_cast<unsigned char>(next);
+    StationState &st = pollList.GetStationState(Address);
+    *pAddress = Address;
+
+    linklayermanager.SetAddress(Address);
+    linklayermanager.SetFCB(st.FCB);
+
+    unsigned char Class = pollList.NextClass(Address);
+
+    timeval start;
+    gettimeofday(&start, 0);
+
+    bool result = true;
+    if (!st.LinkReset) result = linklayermanager.ResetRemoteLink();
+    if (result) result = linklayermanager.UserDataClass(Class);
+
+    timeval end;
+    gettimeofday(&end, 0);
+    busyMicroseconds += ElapsedMicroseconds(start, end);
+
+    st.FCB = linklayermanager.GetFCB();
+    pollList.Polled(Address, Class);
+    totalPolls++;
+
+    const FT12Frame *frame = linklayermanager.GetLastReceivedFrame();
+    if (!result || frame == 0) {
+      pollList.Failed(Address);
+      return false;
+    }
+
+    pollList.Succeeded(Address, frame->Control);
+
+    frame->GetUserData(pAsdu, Size);
+    return true;
+  }
+
+  /*Timers shared by all stations of the line*/
+  void SetLinkTimings(const LinkTimings &Timings) { linklayermanager.SetTimings(Timings); }
+
+  const StationState &GetStationState(unsigned char Address) const { return pollList.GetStationState(Address); }
+
+  unsigned short GetStationCount() const { return pollList.GetStationCount(); }
+
+  /*Polling policy parameters (class 1 burst, backoff)*/
+  IEC87052PollList &GetPollList() { return pollList; }
+
+  /*Share of wall clock time spent in bus transactions since last ResetStatistics (0..1)*/
+  double GetBusUtilisation() const {
+    unsigned long long elapsed = ElapsedSinceReset();
+    return elapsed == 0 ? 0 : static_cast<double>(busyMicroseconds) / elapsed;
+  }
+
+  /*Achieved transactions per second since last ResetStatistics*/
+  double GetPollsPerSecond() const {
+    unsigned long long elapsed = ElapsedSinceReset();
+    return elapsed == 0 ? 0 : totalPolls * 1000000.0 / elapsed;
+  }
+
+  void ResetStatistics() {
+    gettimeofday(&statisticsStart, 0);
+    busyMicroseconds = 0;
+    totalPolls = 0;
+  }
+
+ private:
+  unsigned long long ElapsedSinceReset() const {
+    timeval now;
+    gettimeofday(&now, 0);
+    return ElapsedMicroseconds(statisticsStart, now);
+  }
+
+  static unsigned long long ElapsedMicroseconds(const timeval &from, const timeval &to) {
+    long long us = (static_cast<long long>(to.tv_sec) - from.tv_sec) * 1000000 + (to.tv_usec - from.tv_usec);
+    return us > 0 ? static_cast<unsigned long long>(us) : 0;
+  }
+
+  IEC87052Manager_<Port> linklayermanager;
+  IEC87052PollList pollList;
+
+  timeval statisticsStart;
+  unsigned long long busyMicroseconds;
+  unsigned long long totalPolls;
+};
+
+typedef IEC87052BusScheduler_<> IEC87052BusScheduler; /*Multi-station polling on a shared line*/
+
+#endif
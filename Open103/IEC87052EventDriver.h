@@ -0,0 +1,523 @@
+#ifndef IEC87052EVENTDRIVER_H
+#define IEC87052EVENTDRIVER_H
+#pragma once
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "FT12Codec.h"
+#include "FT12Deframer.h"
+#include "IEC87052Manager.h"
+#include "IEC87052PollList.h"
+
+/*
+Receives what happens on the lines of an IEC87052EventDriver. Callbacks run on the driver thread that owns the line:
+they must not block, and pAsdu is only valid during the call.
+*/
+class IEC87052EventSink {
+ public:
+  virtual ~IEC87052EventSink() {}
+
+  /*An ASDU has been received from a station*/
+  virtual void OnAsdu(int Line, unsigned char Address, const void *pAsdu, size_t Size) = 0;
+
+  /*A station stopped answering (Online = false) or answers again (Online = true)*/
+  virtual void OnStationState(int /*Line*/, unsigned char /*Address*/, bool /*Online*/) {}
+
+  /*A frame queued with IEC87052LineSession::Send has been confirmed, or given up after all repetitions*/
+  virtual void OnSendComplete(int /*Line*/, unsigned char /*Address*/, bool /*Confirmed*/) {}
+
+  /*Called between two transactions of the line with the driver clock (milliseconds), to expire timers of the sink*/
+  virtual void OnTick(int /*Line*/, unsigned long long /*Now*/) {}
+
+  /*
+  The descriptor of the line reported end of file or an error (e.g. the gateway closed the connection): the driver no
+  longer uses it, so it can be closed. Its stations have been reported offline and its queued frames given up
+  */
+  virtual void OnLineDown(int /*Line*/) {}
+};
+
+/*
+Link layer of one line (serial port or gateway socket) as a non-blocking state machine.
+
+It performs the same transactions as IEC87052Manager (reset of remote link, user data, request of class 1/2 data),
+with the same timers and repetitions, but never waits: the driver calls OnReadable when the descriptor has data and
+OnTimer when Deadline() expires. Polling follows IEC87052PollList; frames queued with Send go first.
+End of file or an error on the descriptor puts the line down for good (see IEC87052EventSink::OnLineDown).
+*/
+typedef class IEC87052LineSession_ {
+ public:
+  IEC87052LineSession_(int fd, int id, IEC87052EventSink *sink, const LinkTimings &timings)
+      : Transactions(0), Retransmissions(0), fd(fd), id(id), sink(sink), Timings(timings), phase(Idle), kind(PollData),
+        forQueue(false), current(0), pollClass(2), attempts(0), sentSize(0), deadline(0), answerDeadline(0),
+        down(false) {
+    for (int i = 0; i < 256; i++) online[i] = false;
+  }
+
+  /*Stations to poll on this line. Must be configured before the driver starts*/
+  IEC87052PollList &GetPollList() { return pollList; }
+
+  /*
+  Queues user data for a station (Confirm = false for send/no reply, e.g. broadcast). Can be called by any thread.
+  Returns false if the line is down or the data does not fit in a frame.
+  */
+  bool Send(unsigned char Address, const void *pData, size_t Size, bool Confirm = true) {
+    if (Size > FT12Frame::MaxUserDataSize) return false;
+
+    PendingData item;
+    item.Address = Address;
+    item.Confirm = Confirm;
+    item.Data.assign(static_cast<const unsigned char *>(pData), static_cast<const unsigned char *>(pData) + Size);
+
+    std::lock_guard<std::mutex> lock(queueLock);
+    if (down) return false;
+    queue.push_back(item);
+    return true;
+  }
+
+  int GetFd() const { return fd; }
+
+  int GetId() const { return id; }
+
+  /*Monotonic milliseconds at which OnTimer must be called, NoDeadline once the line is down*/
+  unsigned long long Deadline() const { return deadline; }
+
+  /*The descriptor reported end of file or an error*/
+  bool IsDown() const { return phase == Down; }
+
+  /*Starts the first transaction. Returns next deadline*/
+  unsigned long long OnStart(unsigned long long now) {
+    StartNext(now);
+    return deadline;
+  }
+
+  /*Drains the descriptor and handles complete frames. Returns next deadline*/
+  unsigned long long OnReadable(unsigned long long now) {
+    if (phase == Down) return deadline;
+
+    for (;;) {
+      /* Frames are taken out after each read, so there is always room for more. */
+      size_t free = 0;
+      unsigned char *p = deframer.WritePointer(&free);
+      ssize_t n = read(fd, p, free);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (n <= 0) return OnHangup();
+
+      deframer.Commit(static_cast<size_t>(n));
+      HandleFrames(now);
+    }
+
+    /* Part of an answer is there: the rest must follow without gaps, and all of it before answerDeadline. */
+    if (phase == Waiting && deframer.Pending() > 0) {
+      deadline = now + Timings.InterCharacterTimeout();
+      if (deadline > answerDeadline) deadline = answerDeadline;
+    }
+
+    return deadline;
+  }
+
+  /*
+  The descriptor reported end of file, an error or a hang up: the transaction in progress fails, online stations are
+  reported offline, queued frames are given up and the line stops. Returns NoDeadline
+  */
+  unsigned long long OnHangup() {
+    if (phase == Down) return deadline;
+    TRACEENDL("Line closed");
+
+    if (phase == Waiting) Fail();
+    if (phase == NoReply) Finish(true);
+
+    for (int a = 0; a < 256; a++) {
+      if (!online[a]) continue;
+      online[a] = false;
+      sink->OnStationState(id, static_cast<unsigned char>(a), false);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(queueLock);
+      down = true;
+    }
+    while (Finish(false)) {
+    }
+
+    phase = Down;
+    deadline = NoDeadline;
+    sink->OnLineDown(id);
+    return deadline;
+  }
+
+  /*Handles expired timers. Returns next deadline*/
+  unsigned long long OnTimer(unsigned long long now) {
+    if (now < deadline) return deadline;
+
+    switch (phase) {
+      case Idle:
+        StartNext(now);
+        break;
+
+      case NoReply:
+        Finish(true);
+        StartNext(now);
+        break;
+
+      case Waiting:
+        if (attempts < Timings.Repeats) {
+          attempts++;
+          Retransmissions++;
+          deframer.Reset();
+          Transmit(now);
+        } else {
+          Fail();
+          StartNext(now);
+        }
+        break;
+
+      case Down:
+        break;
+    }
+
+    return deadline;
+  }
+
+  static const unsigned long long NoDeadline = ~0ULL;
+
+  /*Statistics*/
+  unsigned long long Transactions;
+  unsigned long long Retransmissions;
+
+ private:
+  typedef enum Phase_ { Idle, Waiting, NoReply, Down } Phase;
+  typedef enum Kind_ { ResetLink, PollData, QueuedData } Kind;
+
+  struct PendingData {
+    unsigned char Address;
+    bool Confirm;
+    std::vector<unsigned char> Data;
+  };
+
+  void HandleFrames(unsigned long long now) {
+    FT12Frame answer;
+    FT12Deframer::FrameKind frameKind;
+    while ((frameKind = deframer.Next(&answer)) != FT12Deframer::NoFrame) {
+      if (phase != Waiting) continue; /* Nobody asked: late answer of a given up transaction */
+
+      /* E5 is a short positive ack (PRM = 0, function 0) from the addressed station. */
+      if (frameKind == FT12Deframer::SingleCharFrame) answer = FT12Frame(0, request.Address);
+
+      if (IEC87052Manager::CheckControlReturnFrame(request, answer)) Complete(answer, now);
+    }
+  }
+
+  /* Chooses the next transaction: queued data first, then polling. */
+  void StartNext(unsigned long long now) {
+    sink->OnTick(id, now);
+
+    attempts = 0;
+    forQueue = false;
+    deframer.Reset();
+
+    {
+      std::lock_guard<std::mutex> lock(queueLock);
+      if (!queue.empty()) {
+        PendingData &item = queue.front();
+        IEC87052PollList::StationState &st = pollList.GetStationState(item.Address);
+        current = item.Address;
+        forQueue = true;
+
+        if (item.Confirm && !st.LinkReset) {
+          kind = ResetLink;
+          request = FT12Frame(IFT12::CreateControlByte(1, 0, 0, 0, 0, 0, 0), current);
+          st.FCB = 1;
+        } else {
+          kind = QueuedData;
+          unsigned char CByte = item.Confirm ? IFT12::CreateControlByte(1, st.FCB, 1, 0, 0, 1, 1)
+                                             : IFT12::CreateControlByte(1, 0, 0, 0, 1, 0, 0);
+          if (item.Confirm) st.FCB = !st.FCB;
+          request = FT12Frame(CByte, current, item.Data.empty() ? 0 : &item.Data[0], item.Data.size());
+        }
+
+        sentSize = request.Encode(buffer);
+        Transmit(now);
+        return;
+      }
+    }
+
+    int next = pollList.NextStation();
+    if (next < 0) {
+      /* Every station is in backoff (or there are none): check again later. */
+      phase = Idle;
+      deadline = now + Timings.ResponseTimeout;
+      return;
+    }
+
+    current = static_cast<unsigned char>(next);
+    IEC87052PollList::StationState &st = pollList.GetStationState(current);
+
+    if (!st.LinkReset) {
+      kind = ResetLink;
+      request = FT12Frame(IFT12::CreateControlByte(1, 0, 0, 0, 0, 0, 0), current);
+      st.FCB = 1;
+    } else {
+      kind = PollData;
+      pollClass = pollList.NextClass(current);
+      request = FT12Frame(IFT12::CreateControlByte(1, st.FCB, 1, 1, 0, 1, pollClass - 1), current);
+      st.FCB = !st.FCB;
+      pollList.Polled(current, pollClass);
+    }
+
+    sentSize = request.Encode(buffer);
+    Transmit(now);
+  }
+
+  /* Writes the encoded request and arms the response timer. */
+  void Transmit(unsigned long long now) {
+    Transactions++;
+    ssize_t n = write(fd, buffer, sentSize);
+    unsigned long long lineTime = (Timings.FrameTime(sentSize) + 999) / 1000;
+
+    if ((request.Control & 0xF) == 4 && n == static_cast<ssize_t>(sentSize)) {
+      /* Send/no reply: just leave the line idle before next frame. */
+      phase = NoReply;
+      deadline = now + lineTime + Timings.InterCharacterTimeout();
+      return;
+    }
+
+    /* A failed write is handled as a missing answer, so it is repeated on timeout. */
+    phase = Waiting;
+    deadline = now + lineTime + Timings.ResponseTimeout;
+    answerDeadline = deadline + (Timings.FrameTime(FT12Deframer::MaxFrameSize) + 999) / 1000 +
+                     Timings.InterCharacterTimeout();
+  }
+
+  void Complete(const FT12Frame &answer, unsigned long long now) {
+    pollList.Succeeded(current, answer.Control);
+    if (!online[current]) {
+      online[current] = true;
+      sink->OnStationState(id, current, true);
+    }
+
+    if (kind == PollData && answer.UserDataSize > 0) sink->OnAsdu(id, current, answer.UserData, answer.UserDataSize);
+    if (forQueue && kind == QueuedData) Finish(true);
+
+    StartNext(now);
+  }
+
+  void Fail() {
+    pollList.Failed(current);
+    if (online[current]) {
+      online[current] = false;
+      sink->OnStationState(id, current, false);
+    }
+
+    /* Queued data is given up together with the link reset made on its behalf. */
+    if (forQueue) Finish(false);
+  }
+
+  /* Removes the queued item in transmission and reports its outcome. Returns false if the queue was empty. */
+  bool Finish(bool Confirmed) {
+    unsigned char Address;
+    {
+      std::lock_guard<std::mutex> lock(queueLock);
+      if (queue.empty()) return false;
+      Address = queue.front().Address;
+      queue.pop_front();
+    }
+    sink->OnSendComplete(id, Address, Confirmed);
+    return true;
+  }
+
+  int fd;
+  int id;
+  IEC87052EventSink *sink;
+  LinkTimings Timings;
+  IEC87052PollList pollList;
+  bool online[256];
+
+  Phase phase;
+  Kind kind;
+  bool forQueue; /* Transaction made for the queue front item */
+  unsigned char current;
+  unsigned char pollClass;
+  unsigned int attempts;
+  FT12Frame request;
+  unsigned char buffer[FT12Deframer::MaxFrameSize];
+  size_t sentSize;
+  unsigned long long deadline;
+  unsigned long long answerDeadline; /* A line sending without pause (noise) cannot keep a transaction alive */
+  FT12Deframer deframer;
+
+  std::mutex queueLock;
+  std::deque<PendingData> queue;
+  bool down; /* Under queueLock: Send is refused */
+
+} IEC87052LineSession; /*Non-blocking link layer of one line*/
+
+/*
+Runs many IEC87052LineSession on a few threads with epoll.
+
+Lines are spread across Threads workers; each worker owns its lines, its epoll instance and a timer heap, so workers
+never share state. Descriptors must be non-blocking and stay open while the driver runs, unless their line went down
+(IEC87052EventSink::OnLineDown). Lines must be added and configured before Start().
+*/
+class IEC87052EventDriver {
+ public:
+  IEC87052EventDriver(unsigned int Threads = 1) : workers(Threads == 0 ? 1 : Threads), running(false) {}
+
+  ~IEC87052EventDriver() {
+    Stop();
+    for (size_t i = 0; i < lines.size(); i++) delete lines[i];
+  }
+
+  /*Adds a line. Returns its session, whose id is passed to sink callbacks*/
+  IEC87052LineSession *AddLine(int fd, IEC87052EventSink *sink, const LinkTimings &Timings = LinkTimings()) {
+    if (running) return 0;
+
+    IEC87052LineSession *line = DBG_NEW IEC87052LineSession(fd, static_cast<int>(lines.size()), sink, Timings);
+    lines.push_back(line);
+    workers[lines.size() % workers.size()].lines.push_back(line);
+    return line;
+  }
+
+  IEC87052LineSession *GetLine(int id) const { return lines[id]; }
+
+  bool Start() {
+    if (running) return false;
+
+    for (size_t i = 0; i < workers.size(); i++) {
+      Worker &w = workers[i];
+      w.epfd = epoll_create1(EPOLL_CLOEXEC);
+      w.stopfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (w.epfd < 0 || w.stopfd < 0) {
+        TRACEENDL("Unable to create event loop");
+        Stop();
+        return false;
+      }
+
+      epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u32 = StopToken;
+      epoll_ctl(w.epfd, EPOLL_CTL_ADD, w.stopfd, &ev);
+
+      for (size_t k = 0; k < w.lines.size(); k++) {
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u32 = static_cast<unsigned int>(k);
+        epoll_ctl(w.epfd, EPOLL_CTL_ADD, w.lines[k]->GetFd(), &ev);
+      }
+    }
+
+    running = true;
+    for (size_t i = 0; i < workers.size(); i++) workers[i].thread = std::thread(Run, &workers[i]);
+    return true;
+  }
+
+  void Stop() {
+    for (size_t i = 0; i < workers.size(); i++) {
+      Worker &w = workers[i];
+      if (w.stopfd >= 0) {
+        unsigned long long one = 1;
+        ssize_t n = write(w.stopfd, &one, sizeof(one));
+        (void)n;
+      }
+      if (w.thread.joinable()) w.thread.join();
+      if (w.epfd >= 0) close(w.epfd);
+      if (w.stopfd >= 0) close(w.stopfd);
+      w.epfd = w.stopfd = -1;
+    }
+    running = false;
+  }
+
+  /*Monotonic clock used for line deadlines, milliseconds*/
+  static unsigned long long Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+  }
+
+ private:
+  static const unsigned int StopToken = 0xFFFFFFFF;
+  typedef std::pair<unsigned long long, unsigned int> Timer; /* Deadline, line index in worker */
+  typedef std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> > TimerHeap;
+
+  struct Worker {
+    Worker() : epfd(-1), stopfd(-1) {}
+    int epfd;
+    int stopfd;
+    std::thread thread;
+    std::vector<IEC87052LineSession *> lines;
+  };
+
+  static void Run(Worker *w) {
+    TimerHeap timers;
+    unsigned long long now = Now();
+
+    for (unsigned int k = 0; k < w->lines.size(); k++) Schedule(&timers, w->lines[k]->OnStart(now), k);
+
+    epoll_event events[256];
+    for (;;) {
+      int timeout = -1;
+      if (!timers.empty()) {
+        now = Now();
+        timeout = timers.top().first > now ? static_cast<int>(timers.top().first - now) : 0;
+      }
+
+      int n = epoll_wait(w->epfd, events, 256, timeout);
+      if (n < 0 && errno != EINTR) return;
+
+      now = Now();
+      for (int i = 0; i < n; i++) {
+        if (events[i].data.u32 == StopToken) return;
+
+        unsigned int index = events[i].data.u32;
+        IEC87052LineSession *line = w->lines[index];
+        unsigned long long before = line->Deadline();
+        unsigned long long after = line->OnReadable(now);
+
+        /* Hang up and errors are reported with the remaining data, which has just been read. */
+        if (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) after = line->OnHangup();
+
+        if (line->IsDown()) {
+          epoll_ctl(w->epfd, EPOLL_CTL_DEL, line->GetFd(), 0);
+          continue;
+        }
+        if (after != before) Schedule(&timers, after, index);
+      }
+
+      /* Entries whose deadline changed in the meantime are stale and simply dropped. */
+      while (!timers.empty() && timers.top().first <= now) {
+        Timer t = timers.top();
+        timers.pop();
+
+        IEC87052LineSession *line = w->lines[t.second];
+        if (line->Deadline() != t.first) continue;
+        Schedule(&timers, line->OnTimer(now), t.second);
+      }
+    }
+  }
+
+  /* Lines that are down have no deadline. */
+  static void Schedule(TimerHeap *timers, unsigned long long Deadline, unsigned int Index) {
+    if (Deadline != IEC87052LineSession::NoDeadline) timers->push(Timer(Deadline, Index));
+  }
+
+  std::vector<IEC87052LineSession *> lines;
+  std::vector<Worker> workers;
+  bool running;
+};
+
+#endif  // __linux__
+
+#endif  // IEC87052EVENTDRIVER_H
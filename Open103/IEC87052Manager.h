@@ -3,134 +3,250 @@
 #pragma once
 
 #include "CommunicationPort.h"
+#include "FT12Codec.h"
+#include "FT12Deframer.h"
 #include "FT12Fixed.h"
 #include "FT12Variable.h"
+#include "gettimeofday.h"
 
 class IEC8705103Manager;
 
-typedef class IEC87052Manager_ {
+/*
+Link layer timers. Every transaction is bounded by:
+(Repeats + 1) * (request time on line + ResponseTimeout + longest answer time on line + InterCharacterTimeout)
+*/
+typedef struct LinkTimings_ {
+  LinkTimings_() : BaudRate(9600), ResponseTimeout(100), Repeats(3), IdleBits(33), TimerMargin(2) {}
+
+  unsigned int BaudRate;        /* Line speed, used to compute character times */
+  unsigned int ResponseTimeout; /* Milliseconds to wait for the first character of an answer */
+  unsigned char Repeats;        /* Retransmissions of the same frame before giving up */
+  unsigned short IdleBits;      /* Line idle interval that ends a frame (33 bits from 870-5-1) */
+  unsigned int TimerMargin;     /* Milliseconds added to computed timers for OS scheduling jitter */
+
+  /*Microseconds needed to transmit Size bytes: 11 bits per character (start, 8 data, even parity, stop)*/
+  unsigned int FrameTime(size_t Size) const {
+    return static_cast<unsigned int>((Size * 11 * 1000000ULL + BaudRate - 1) / BaudRate);
+  }
+
+  /*Milliseconds of silence after which a partial frame is considered broken*/
+  unsigned int InterCharacterTimeout() const { return (IdleBits * 1000 + BaudRate - 1) / BaudRate + TimerMargin; }
+
+  /*Worst case duration in milliseconds of a transaction started with a RequestSize bytes frame*/
+  unsigned int WorstCaseTransactionTime(size_t RequestSize) const {
+    unsigned int once = (FrameTime(RequestSize) + FrameTime(FT12Deframer::MaxFrameSize) + 999) / 1000 +
+                        ResponseTimeout + InterCharacterTimeout();
+    return once * (Repeats + 1);
+  }
+} LinkTimings;
+
+/*
+IEC 870-5-2 link layer, unbalanced transmission, primary station side.
+
+Port is the type of the communication port. It only needs Read, Write and SetReadTimeout with the CommunicationPort
+signatures: when a concrete (possibly final) port class is used instead of CommunicationPort, every port call can be
+resolved at compile time. Frames are value types encoded into a member buffer, so a transaction performs no heap
+allocation and no virtual call apart from the ones the port itself makes.
+*/
+template <class Port = CommunicationPort>
+class IEC87052Manager_ {
   friend class IEC8705103Manager;
 
  public:
-  IEC87052Manager_(CommunicationPort *port, unsigned char address)
-      : port(port), address(address), FLastSentFrame(DBG_NEW FT12Fixed()), FLastReceivedFrame(DBG_NEW FT12Fixed()),
-        VLastReceivedFrame(DBG_NEW FT12Variable()), VLastSentFrame(DBG_NEW FT12Variable()), CurrentFCB(0) {}
+  typedef ::LinkTimings LinkTimings;
+
+  IEC87052Manager_(Port *port, unsigned char address)
+      : port(port), address(address), received(false), CurrentFCB(0), readTimeout(0), sentSize(0), answerSize(0),
+        Retransmissions(0), roundTrip(0), roundTripRequestSize(0), roundTripAnswerSize(0), receiveTime(0) {}
 
   /* Function 0 */
   bool ResetRemoteLink() {
-    PLACEMENT_NEW(FLastSentFrame) FT12Fixed(IFT12::CreateControlByte(1, 0, 0, 0, 0, 0, 0), address);
-
-    LPIFT12 fout = 0;
     CurrentFCB = 1;
-    return this->SendReceiveAndCheck(FLastSentFrame, &fout);
+    return this->SendReceiveAndCheck(FT12Frame(IFT12::CreateControlByte(1, 0, 0, 0, 0, 0, 0), address));
   }
 
   /*Function 3 - 4*/
   bool UserData(const void *pData, const size_t Size, bool Confirm = true) {
+    if (Size > FT12Frame::MaxUserDataSize) {
+      TRACEENDL("User data does not fit in a frame.");
+      return false;
+    }
+
     unsigned char CByte = (Confirm == true ? IFT12::CreateControlByte(1, CurrentFCB, 1, 0, 0, 1, 1)
                                            : IFT12::CreateControlByte(1, 0, 0, 0, 1, 0, 0));
     if (Confirm) CurrentFCB = !CurrentFCB;
-    PLACEMENT_NEW(VLastSentFrame) FT12Variable(CByte, address);
-    VLastSentFrame->SetUserData(pData, Size);
-
-    LPIFT12 fout = 0;
-    return this->SendReceiveAndCheck(VLastSentFrame, &fout);
+    return this->SendReceiveAndCheck(FT12Frame(CByte, address, pData, Size));
   }
 
-  /*Function 9*/
+  /*Function 9. FCV = 0: the FCB is not used and does not toggle, or the next FCV = 1 frame would look repeated*/
   bool StatusLink() {
-    PLACEMENT_NEW(FLastSentFrame) FT12Fixed(IFT12::CreateControlByte(1, CurrentFCB, 0, 1, 0, 0, 1), address);
-    CurrentFCB = !CurrentFCB;
-    LPIFT12 fout = 0;
-    return this->SendReceiveAndCheck(FLastSentFrame, &fout);
+    return this->SendReceiveAndCheck(FT12Frame(IFT12::CreateControlByte(1, 0, 0, 1, 0, 0, 1), address));
   }
 
   /*Function 10-11*/
   bool UserDataClass(unsigned char Class) {
-    PLACEMENT_NEW(FLastSentFrame) FT12Fixed(IFT12::CreateControlByte(1, CurrentFCB, 1, 1, 0, 1, Class - 1), address);
+    FT12Frame frame(IFT12::CreateControlByte(1, CurrentFCB, 1, 1, 0, 1, Class - 1), address);
     CurrentFCB = !CurrentFCB;
-    LPIFT12 fout = 0;
-    return this->SendReceiveAndCheck(FLastSentFrame, &fout);
+    return this->SendReceiveAndCheck(frame);
   }
 
   void SetAddress(unsigned char NewAddress) { this->address = NewAddress; }
 
   void SetFCB(unsigned char FCB) { CurrentFCB = FCB; }
 
-  ~IEC87052Manager_() {
-    if (VLastSentFrame != 0) {
-      delete VLastSentFrame;
-      VLastSentFrame = 0;
-    }
+  unsigned char GetAddress() const { return address; }
 
-    if (VLastReceivedFrame != 0) {
-      delete VLastReceivedFrame;
-      VLastReceivedFrame = 0;
-    }
+  unsigned char GetFCB() const { return CurrentFCB; }
 
-    if (FLastSentFrame != 0) {
-      delete FLastSentFrame;
-      FLastSentFrame = 0;
-    }
+  /*Frames sent again because of a missing or wrong answer*/
+  unsigned int GetRetransmissions() const { return Retransmissions; }
 
-    if (FLastReceivedFrame != 0) {
-      delete FLastReceivedFrame;
-      FLastReceivedFrame = 0;
-    }
-  }
+  /*
+  Microseconds from the write of the last answered frame to its complete answer (0 if none yet), and the sizes on
+  line of both frames: what is not transmission time is port latency and secondary station turnaround.
+  */
+  unsigned int GetLastRoundTrip() const { return roundTrip; }
+  size_t GetLastRoundTripRequestSize() const { return roundTripRequestSize; }
+  size_t GetLastRoundTripAnswerSize() const { return roundTripAnswerSize; }
+
+  /*Clock (gettimeofday, microseconds since 1970) when the last answer was complete*/
+  long long GetLastReceiveTime() const { return receiveTime; }
+
+  void SetTimings(const LinkTimings &NewTimings) { Timings = NewTimings; }
+
+  const LinkTimings &GetTimings() const { return Timings; }
+
+  /*Last frame received from secondary station (0 if the last transaction failed).
+  User data points inside the receive buffer and is valid until next transaction.*/
+  const FT12Frame *GetLastReceivedFrame() const { return received ? &LastReceivedFrame : 0; }
 
  private:
-  /* Utility function. Write frame on CommunicationPort */
-  bool SendFrame(const IFT12 *frame) {
-    size_t size = frame->FrameSize();
-    unsigned char *ptr = static_cast<unsigned char *>(frame->CreateRawBuffer(buffer, 0));
-    return port->Write(ptr, size) > 0;
+  /* Utility function. Encodes frame and writes it on CommunicationPort */
+  bool SendFrame(const FT12Frame &frame) {
+    sentSize = frame.Encode(buffer);
+    return sentSize > 0 && RepeatFrame();
   }
 
-  /* Utility function. Reads frame on CommunicationPort */
-  bool ReceiveFrame(LPIFT12 *frame) {
-    tbytes = port->Read(buffer, sizeof(buffer));
-    (*frame) = FromRawData(buffer, tbytes);
-    return tbytes > 0;
+  /* Utility function. Writes again last encoded frame */
+  inline bool RepeatFrame() { return port->Write(buffer, static_cast<int>(sentSize)) > 0; }
+
+  /* Utility function. Reads frame on CommunicationPort. Partial reads are accumulated until a whole frame is there.
+  The whole answer must be there within ResponseTimeout + longest frame time + InterCharacterTimeout, so a line that
+  never stops sending (noise, a babbling station) cannot keep the transaction alive. */
+  bool ReceiveFrame() {
+    FT12Deframer::FrameKind kind;
+
+    received = false;
+
+    long long deadline = Microseconds() + (Timings.ResponseTimeout + Timings.InterCharacterTimeout()) * 1000LL +
+                         Timings.FrameTime(FT12Deframer::MaxFrameSize);
+
+    while ((kind = deframer.Next(&LastReceivedFrame)) == FT12Deframer::NoFrame) {
+      size_t free = 0;
+      unsigned char *p = deframer.WritePointer(&free);
+
+      long long left = (deadline - Microseconds() + 999) / 1000;
+      if (left <= 0) {
+        TRACEENDL("No complete answer before the deadline.");
+        return false;
+      }
+
+      /* First character may take a whole turnaround, the following ones must come without gaps. */
+      unsigned int timeout = deframer.Pending() == 0 ? Timings.ResponseTimeout : Timings.InterCharacterTimeout();
+      SetReadTimeout(left < timeout ? static_cast<unsigned int>(left) : timeout);
+
+      tbytes = port->Read(p, static_cast<int>(free));
+      if (tbytes <= 0) return false;
+
+      deframer.Commit(tbytes);
+    }
+
+    /* E5 is a short positive ack (PRM = 0, function 0) from the addressed station. */
+    if (kind == FT12Deframer::SingleCharFrame)
+      LastReceivedFrame = FT12Frame(IFT12::CreateControlByte(0, 0, 0, 0, 0, 0, 0), address);
+
+    answerSize = kind == FT12Deframer::SingleCharFrame ? 1 : LastReceivedFrame.FrameSize();
+
+    received = true;
+    return true;
   }
 
-  /* Utility function. Write and reads a frame on CommunicationPort. Will return CheckReturnFrame result only */
-  inline bool SendAndReceiveFrame(const IFT12 *frameIn, LPIFT12 *frameOut) {
-    if (!SendFrame(frameIn)) return false;
-    return ReceiveFrame(frameOut);
+  /* Utility function. Write, reads and checks a frame on CommunicationPort.
+  The very same frame (same FCB) is repeated up to Timings.Repeats times on timeout or bad answer. */
+  inline bool SendReceiveAndCheck(const FT12Frame &frameIn) {
+    /* Send/no reply: nothing will come back. */
+    if ((frameIn.Control & 0xF) == 4) {
+      received = false;
+      return SendFrame(frameIn);
+    }
+
+    for (unsigned int attempt = 0; attempt <= Timings.Repeats; attempt++) {
+      timeval start;
+      gettimeofday(&start, 0);
+
+      /* Leftovers of a broken answer, or of an earlier transaction, must not be taken as the answer to this one. */
+      deframer.Reset();
+
+      bool sent;
+      if (attempt > 0) {
+        Retransmissions++;
+        sent = RepeatFrame();
+      } else
+        sent = SendFrame(frameIn);
+
+      if (sent && ReceiveFrame() && CheckControlReturnFrame(frameIn, LastReceivedFrame)) {
+        timeval end;
+        gettimeofday(&end, 0);
+        long long us = (static_cast<long long>(end.tv_sec) - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+        roundTrip = us > 0 ? static_cast<unsigned int>(us) : 0;
+        roundTripRequestSize = sentSize;
+        roundTripAnswerSize = answerSize;
+        receiveTime = static_cast<long long>(end.tv_sec) * 1000000 + end.tv_usec;
+        return true;
+      }
+    }
+
+    received = false;
+    TRACEENDL("No valid answer after all repetitions.");
+    return false;
   }
 
-  /* Utility function. Write, reads and checks a frame on CommunicationPort. */
-  inline bool SendReceiveAndCheck(const IFT12 *frameIn, LPIFT12 *frameOut) {
-    do {
-      if (!SendAndReceiveFrame(frameIn, frameOut)) return false;
-    } while (CheckControlReturnFrame(frameIn, *frameOut) == false);
+  /* Clock used for the deadlines (gettimeofday), microseconds */
+  static long long Microseconds() {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return static_cast<long long>(tv.tv_sec) * 1000000 + tv.tv_usec;
+  }
 
-    return true;
+  /* Forwards read timeout to the port only when it changes. */
+  inline void SetReadTimeout(unsigned int Milliseconds) {
+    if (Milliseconds == readTimeout) return;
+    if (port->SetReadTimeout(Milliseconds)) readTimeout = Milliseconds;
   }
 
+ public:
   /* Scans entire frame for its */
-  inline bool CheckControlReturnFrame(const IFT12 *src, const IFT12 *dest) {
-    if (src->Address != dest->Address) {
+  static bool CheckControlReturnFrame(const FT12Frame &src, const FT12Frame &dest) {
+    if (src.Address != dest.Address) {
       TRACEENDL("Received frame is not related to sent one.");
 
       return false;
     }
     /*0, 1, 8, 9, 11 (responses)*/
-    if ((dest->Control & 0x40) == 1)  // bit 2
+    if ((dest.Control & 0x40) == 1)  // bit 2
     {
       TRACEENDL("PRM is not valid.");
       return false;
     }
 
-    if ((dest->Control & 0x20) == 1)  // bit 4
+    if ((dest.Control & 0x20) == 1)  // bit 4
     {
       TRACEENDL("DFC indicates an overflow condition.");
       return false;
     }
 
-    unsigned char RetFunc = (dest->Control & 0xF);
-    unsigned char StartFunc = (src->Control & 0xF);
+    unsigned char RetFunc = (dest.Control & 0xF);
+    unsigned char StartFunc = (src.Control & 0xF);
 
     if (StartFunc == 0 || StartFunc == 3) {
       if (RetFunc == 1) {
@@ -145,26 +261,28 @@ typedef class IEC87052Manager_ {
     return true;
   }
 
+ private:
   unsigned char address;
   unsigned char CurrentFCB;
 
-  IFT12 *FromRawData(const void *pData, const size_t Size) {
-    if (tbytes == 0) return 0;
-    if (static_cast<const unsigned char *>(pData)[0] == 0x10)
-      return PLACEMENT_NEW(FLastReceivedFrame) FT12Fixed(pData, Size);
-
-    return PLACEMENT_NEW(VLastReceivedFrame) FT12Variable(pData, Size);
-  }
-
-  FT12Fixed *FLastSentFrame;
-  FT12Fixed *FLastReceivedFrame;
-  FT12Variable *VLastSentFrame;
-  FT12Variable *VLastReceivedFrame;
+  FT12Frame LastReceivedFrame;
+  bool received;
 
-  CommunicationPort *port;
-  unsigned char buffer[250];
+  Port *port;
+  LinkTimings Timings;
+  unsigned int readTimeout;
+  FT12Deframer deframer;
+  unsigned char buffer[FT12Deframer::MaxFrameSize];
+  size_t sentSize;
+  size_t answerSize; /*On line size of the last received frame*/
   int tbytes;
-
-} IEC87052Manager;
+  unsigned int Retransmissions;
+  unsigned int roundTrip;
+  size_t roundTripRequestSize;
+  size_t roundTripAnswerSize;
+  long long receiveTime;
+};
+
+typedef IEC87052Manager_<> IEC87052Manager;
 
 #endif
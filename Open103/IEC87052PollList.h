@@ -0,0 +1,143 @@
+#ifndef IEC87052POLLLIST_H
+#define IEC87052POLLLIST_H
+#pragma once
+
+/*
+Polling policy for the secondary stations of one line.
+
+1) Stations are visited round robin with a class 2 request.
+2) When a response carries ACD (class 1 data available) the same station is immediately polled with class 1 requests
+   until ACD is cleared or Class1Burst requests have been made.
+3) A station that does not answer is skipped for an exponentially increasing number of cycles (up to MaxBackoffCycles)
+   so a dead relay cannot stall the line. When it answers again its link must be reset first.
+
+It only decides who is next: transactions are made by the caller, that reports the outcome with Succeeded/Failed.
+*/
+typedef class IEC87052PollList_ {
+ public:
+  typedef struct StationState_ {
+    StationState_()
+        : Registered(false), LinkReset(false), Class1Pending(false), FCB(0), Failures(0), SkipCycles(0), Polls(0),
+          Class1Polls(0), Timeouts(0) {}
+
+    bool Registered;
+    bool LinkReset;     /* Link has been reset since last failure */
+    bool Class1Pending; /* Last response had ACD set */
+    unsigned char FCB;
+    unsigned short Failures;   /* Consecutive failed transactions */
+    unsigned short SkipCycles; /* Cycles left before next poll */
+
+    unsigned int Polls;
+    unsigned int Class1Polls;
+    unsigned int Timeouts;
+  } StationState;
+
+  static const unsigned char BroadcastAddress = 255;
+  static const unsigned char ACD = 0x20; /*Access demand bit, secondary to primary*/
+
+  IEC87052PollList_() : Class1Burst(8), MaxBackoffCycles(64), stationCount(0), cursor(0), current(-1), burst(0) {}
+
+  /*Adds a secondary station to the polling list*/
+  bool AddStation(unsigned char Address) {
+    if (Address == BroadcastAddress || stations[Address].Registered) return false;
+
+    stations[Address] = StationState();
+    stations[Address].Registered = true;
+    addresses[stationCount++] = Address;
+    return true;
+  }
+
+  /*Removes a secondary station from the polling list*/
+  bool RemoveStation(unsigned char Address) {
+    if (!stations[Address].Registered) return false;
+
+    stations[Address].Registered = false;
+    unsigned short i = 0;
+    while (addresses[i] != Address) i++;
+    for (; i + 1 < stationCount; i++) addresses[i] = addresses[i + 1];
+    stationCount--;
+
+    if (cursor >= stationCount) cursor = 0;
+    if (current == Address) current = -1;
+    return true;
+  }
+
+  /* Selects the station to poll: the current one while it has class 1 data, otherwise next in round robin.
+  Returns -1 when every station is waiting for its backoff to expire. */
+  int NextStation() {
+    if (current >= 0 && stations[current].Class1Pending && burst < Class1Burst) {
+      burst++;
+      return current;
+    }
+
+    burst = 0;
+    for (unsigned short n = 0; n < stationCount; n++) {
+      unsigned char Address = addresses[cursor];
+      cursor = (cursor + 1) % stationCount;
+
+      StationState &st = stations[Address];
+      if (st.SkipCycles > 0) {
+        st.SkipCycles--;
+        continue;
+      }
+
+      current = Address;
+      return current;
+    }
+
+    current = -1;
+    return -1;
+  }
+
+  /*Class to request to a station: 1 if it signalled ACD, 2 otherwise*/
+  unsigned char NextClass(unsigned char Address) const { return stations[Address].Class1Pending ? 1 : 2; }
+
+  /*Records a poll made to a station*/
+  void Polled(unsigned char Address, unsigned char Class) {
+    stations[Address].Polls++;
+    if (Class == 1) stations[Address].Class1Polls++;
+  }
+
+  /*Records a valid answer. Control is the control field of the answer*/
+  void Succeeded(unsigned char Address, unsigned char Control) {
+    StationState &st = stations[Address];
+    st.LinkReset = true;
+    st.Failures = 0;
+    st.SkipCycles = 0;
+    st.Class1Pending = (Control & ACD) != 0;
+  }
+
+  /*Records a transaction without a valid answer and schedules the backoff*/
+  void Failed(unsigned char Address) {
+    StationState &st = stations[Address];
+    st.Timeouts++;
+    st.LinkReset = false;
+    st.Class1Pending = false;
+    if (st.Failures < 16) st.Failures++;
+
+    unsigned int backoff = 1u << (st.Failures - 1);
+    st.SkipCycles = static_cast<unsigned short>(backoff < MaxBackoffCycles ? backoff : MaxBackoffCycles);
+  }
+
+  StationState &GetStationState(unsigned char Address) { return stations[Address]; }
+
+  const StationState &GetStationState(unsigned char Address) const { return stations[Address]; }
+
+  unsigned short GetStationCount() const { return stationCount; }
+
+  /*Maximum number of consecutive class 1 requests to the same station*/
+  unsigned short Class1Burst;
+  /*Upper bound of cycles a silent station is skipped*/
+  unsigned short MaxBackoffCycles;
+
+ private:
+  StationState stations[256];
+  unsigned char addresses[255];
+  unsigned short stationCount;
+  unsigned short cursor;
+  int current;
+  unsigned short burst;
+
+} IEC87052PollList; /*Round robin polling with class 1 priority and backoff*/
+
+#endif
@@ -9,7 +9,13 @@
 #define PLACEMENT_NEW new
 #endif
 
+#ifdef _WIN32
 #define TRACEENDL(x) OutputDebugStringA(x)
+#else
+#include <stdio.h>
+#include <string.h>
+#define TRACEENDL(x) fprintf(stderr, "%s\n", x)
+#endif
 
 typedef class IFT12_ {
  public:
@@ -0,0 +1,184 @@
+#ifndef LINUXSERIALCOMMPORT_H
+#define LINUXSERIALCOMMPORT_H
+#pragma once
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "CommunicationPort.h"
+#include "IFT12.h"
+
+/*
+Serial CommunicationPort for Linux, based on termios.
+
+103 requires 8 data bits, even parity, 1 stop bit: this is the default. The port is opened in raw mode and put in
+exclusive use (TIOCEXCL + flock), so a second process cannot interleave frames on the same line.
+
+Reads never rely on the tty VMIN/VTIME buffering: poll() waits for the timeout set through SetReadTimeout, then whatever
+is available is returned. The link layer sets the response timeout for the first character and the inter-character
+timeout for the rest of the frame. ASYNC_LOW_LATENCY is requested so the driver hands bytes over without waiting for its
+flip buffer timer; devices that do not support it (e.g. pseudo terminals) are silently left as they are.
+*/
+class LinuxSerialCommPort : public CommunicationPort {
+ public:
+  typedef enum Parity_ { NoParity = 0, EvenParity, OddParity } Parity;
+
+  LinuxSerialCommPort(string name, unsigned int BaudRate = 9600, Parity parity = EvenParity, bool LowLatency = true)
+      : CommunicationPort(name), fd(-1), timeout(-1) {
+    fd = open(name.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      TRACEENDL("Unable to open serial port");
+      return;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || ioctl(fd, TIOCEXCL) != 0) {
+      TRACEENDL("Serial port is already in use");
+      Close();
+      return;
+    }
+
+    if (!Configure(BaudRate, parity)) {
+      TRACEENDL("Unable to configure serial port");
+      Close();
+      return;
+    }
+
+    if (LowLatency) SetLowLatency();
+  }
+
+  virtual ~LinuxSerialCommPort() { Close(); }
+
+  bool IsOpen() const { return fd >= 0; }
+
+  /*Waits up to current read timeout for data, then returns what is available (0 on timeout, -1 on error or hang up)*/
+  virtual int Read(unsigned char *thePacket, int maxlen) {
+    if (fd < 0) return -1;
+
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int r;
+    do {
+      r = poll(&pfd, 1, timeout);
+    } while (r < 0 && errno == EINTR);
+
+    if (r <= 0) return r;
+
+    ssize_t n = read(fd, thePacket, maxlen);
+    if (n < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+
+    /* Readable but nothing read: the line has hung up (adapter unplugged, other end of a pty closed), not a timeout. */
+    if (n == 0 && (pfd.revents & (POLLHUP | POLLERR)) != 0) return -1;
+    return static_cast<int>(n);
+  }
+
+  /*Writes the whole frame and waits until it has left the UART, so the response timer starts at the right moment*/
+  virtual int Write(unsigned char *thePacket, int len) {
+    if (fd < 0) return -1;
+
+    int written = 0;
+    while (written < len) {
+      ssize_t n = write(fd, thePacket + written, len - written);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN) return -1;
+
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        poll(&pfd, 1, -1);
+        continue;
+      }
+      written += static_cast<int>(n);
+    }
+
+    tcdrain(fd);
+    return written;
+  }
+
+  virtual bool SetReadTimeout(unsigned int Milliseconds) {
+    timeout = static_cast<int>(Milliseconds);
+    return true;
+  }
+
+ private:
+  bool Configure(unsigned int BaudRate, Parity parity) {
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) return false;
+
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD | CRTSCTS);
+    tio.c_cflag |= CS8 | CREAD | CLOCAL;
+    if (parity != NoParity) tio.c_cflag |= PARENB;
+    if (parity == OddParity) tio.c_cflag |= PARODD;
+
+    /* Parity errors are reported as 0 bytes that will fail frame checksum, never silently dropped. */
+    tio.c_iflag &= ~(IGNPAR | PARMRK | IXON | IXOFF | IXANY);
+    tio.c_iflag |= (parity != NoParity ? INPCK : 0);
+
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    speed_t speed = ToSpeed(BaudRate);
+    if (speed == B0) return false;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) return false;
+    tcflush(fd, TCIOFLUSH);
+    return true;
+  }
+
+  void SetLowLatency() {
+    serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) != 0) return;
+    ss.flags |= ASYNC_LOW_LATENCY;
+    ioctl(fd, TIOCSSERIAL, &ss);
+  }
+
+  void Close() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+
+  static speed_t ToSpeed(unsigned int BaudRate) {
+    switch (BaudRate) {
+      case 1200:
+        return B1200;
+      case 2400:
+        return B2400;
+      case 4800:
+        return B4800;
+      case 9600:
+        return B9600;
+      case 19200:
+        return B19200;
+      case 38400:
+        return B38400;
+      case 57600:
+        return B57600;
+      case 115200:
+        return B115200;
+      default:
+        return B0;
+    }
+  }
+
+  int fd;
+  int timeout; /* Milliseconds, -1 blocks forever */
+};
+
+#endif  // __linux__
+
+#endif  // LINUXSERIALCOMMPORT_H
@@ -0,0 +1,228 @@
+#ifndef TCPGATEWAYPORT_H
+#define TCPGATEWAYPORT_H
+#pragma once
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "CommunicationPort.h"
+#include "IFT12.h"
+
+/*
+Connection to a serial-to-TCP converter.
+
+The socket is non-blocking with TCP_NODELAY, so a frame is never held back by Nagle. A broken or refused connection is
+retried on the next use, but not before a backoff interval that doubles at each failure (MinBackoff..MaxBackoff).
+
+Every frame is sent at once, with one send(). Received bytes are the serial line byte stream, which tells nothing of
+the link an answer belongs to: links sharing a connection must be driven from the same thread, one transaction at a
+time, as on a real bus.
+*/
+typedef class TcpGatewayConnection_ {
+ public:
+  TcpGatewayConnection_(string host, unsigned short port)
+      : ConnectTimeout(2000), MinBackoff(500), MaxBackoff(30000), Connections(0), SendCalls(0), host(host), port(port),
+        fd(-1), backoff(0), nextAttempt(0) {}
+
+  ~TcpGatewayConnection_() { Disconnect(); }
+
+  bool IsConnected() const { return fd >= 0; }
+
+  /*Connects if needed. Returns false when connection fails or backoff interval has not expired yet*/
+  bool Connect() {
+    if (fd >= 0) return true;
+    if (Now() < nextAttempt) return false;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", static_cast<unsigned int>(port));
+
+    addrinfo *res = 0;
+    if (getaddrinfo(host.c_str(), service, &hints, &res) != 0) {
+      TRACEENDL("Unable to resolve gateway address");
+      return Failed();
+    }
+
+    for (addrinfo *ai = res; ai != 0 && fd < 0; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd < 0) continue;
+
+      if (!WaitConnect(connect(fd, ai->ai_addr, ai->ai_addrlen))) Disconnect();
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+      TRACEENDL("Unable to connect to gateway");
+      return Failed();
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    backoff = 0;
+    Connections++;
+    return true;
+  }
+
+  void Disconnect() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+
+  /*Sends a frame, connecting if needed. Returns its size or -1 if the gateway is not reachable*/
+  int Send(const unsigned char *pData, int Size) {
+    if (!Connect()) return -1;
+    return SendAll(pData, static_cast<size_t>(Size)) ? Size : -1;
+  }
+
+  /*Waits up to Timeout milliseconds (-1 forever) for data. 0 on timeout, -1 on error*/
+  int Receive(unsigned char *pData, int Size, int Timeout) {
+    if (fd < 0) return -1;
+
+    if (!WaitFor(POLLIN, Timeout)) return fd < 0 ? -1 : 0;
+
+    ssize_t n = recv(fd, pData, Size, 0);
+    if (n > 0) return static_cast<int>(n);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+
+    TRACEENDL("Gateway closed the connection");
+    Disconnect();
+    Failed();
+    return -1;
+  }
+
+  /*Milliseconds allowed for a connection attempt*/
+  unsigned int ConnectTimeout;
+  /*Reconnection backoff bounds, milliseconds*/
+  unsigned int MinBackoff;
+  unsigned int MaxBackoff;
+
+  /*Statistics: successful connections and frames sent*/
+  unsigned int Connections;
+  unsigned long long SendCalls;
+
+ private:
+  bool SendAll(const unsigned char *pData, size_t Size) {
+    SendCalls++;
+    while (Size > 0) {
+      ssize_t n = send(fd, pData, Size, MSG_NOSIGNAL);
+      if (n > 0) {
+        pData += n;
+        Size -= n;
+        continue;
+      }
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && errno == EAGAIN && WaitFor(POLLOUT, ConnectTimeout)) continue;
+
+      TRACEENDL("Unable to send to gateway");
+      Disconnect();
+      Failed();
+      return false;
+    }
+    return true;
+  }
+
+  bool WaitConnect(int result) {
+    if (result == 0) return true;
+    if (errno != EINPROGRESS || !WaitFor(POLLOUT, ConnectTimeout)) return false;
+
+    int error = 0;
+    socklen_t len = sizeof(error);
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+  }
+
+  bool WaitFor(short events, int Timeout) {
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    int r;
+    do {
+      r = poll(&pfd, 1, Timeout);
+    } while (r < 0 && errno == EINTR);
+
+    if (r > 0 && (pfd.revents & (POLLERR | POLLNVAL)) != 0 && (pfd.revents & POLLIN) == 0) {
+      if (events == POLLOUT) return true; /* SO_ERROR tells what happened */
+      Disconnect();
+      Failed();
+      return false;
+    }
+
+    return r > 0;
+  }
+
+  bool Failed() {
+    backoff = backoff == 0 ? MinBackoff : (backoff * 2 > MaxBackoff ? MaxBackoff : backoff * 2);
+    nextAttempt = Now() + backoff;
+    return false;
+  }
+
+  static unsigned long long Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+  }
+
+  string host;
+  unsigned short port;
+  int fd;
+  unsigned int backoff;
+  unsigned long long nextAttempt;
+
+} TcpGatewayConnection; /*Shared TCP connection to a serial gateway*/
+
+/*
+CommunicationPort talking through a serial-to-TCP gateway.
+Several ports (logical links, e.g. the relays behind one converter) may share one TcpGatewayConnection.
+*/
+class TcpGatewayPort : public CommunicationPort {
+ public:
+  /*Port with its own connection*/
+  TcpGatewayPort(string host, unsigned short port)
+      : CommunicationPort(host), connection(DBG_NEW TcpGatewayConnection(host, port)), owned(true), timeout(-1) {}
+
+  /*Port sharing an existing connection*/
+  TcpGatewayPort(TcpGatewayConnection *connection, string name)
+      : CommunicationPort(name), connection(connection), owned(false), timeout(-1) {}
+
+  virtual ~TcpGatewayPort() {
+    if (owned && connection != 0) delete connection;
+    connection = 0;
+  }
+
+  virtual int Read(unsigned char *thePacket, int maxlen) { return connection->Receive(thePacket, maxlen, timeout); }
+
+  virtual int Write(unsigned char *thePacket, int len) { return connection->Send(thePacket, len); }
+
+  virtual bool SetReadTimeout(unsigned int Milliseconds) {
+    timeout = static_cast<int>(Milliseconds);
+    return true;
+  }
+
+  TcpGatewayConnection *GetConnection() const { return connection; }
+
+ private:
+  TcpGatewayConnection *connection;
+  bool owned;
+  int timeout; /* Milliseconds, -1 blocks forever */
+};
+
+#endif  // _WIN32
+
+#endif  // TCPGATEWAYPORT_H
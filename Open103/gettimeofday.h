@@ -3,6 +3,10 @@
 #pragma once
 
 #include <time.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#else
 #if defined(_MSC_VER) || defined(_MSC_EXTENSIONS)
 #define DELTA_EPOCH_IN_MICROSECS 11644473600000000Ui64
 #else
@@ -55,4 +59,5 @@ __forceinline int gettimeofday(struct timeval *tv, struct timezone *tz) {
 
   return 0;
 }
+#endif  // _WIN32
 #endif
\ No newline at end of file
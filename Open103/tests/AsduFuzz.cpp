@@ -0,0 +1,222 @@
+/*
+Fuzz target of the ASDU views: every view is bound to the input and, when it accepts it, every field is read.
+
+Built with -DOPEN103_LIBFUZZER=ON (clang) it is a libFuzzer target. Otherwise main() mutates valid ASDUs of every
+supported type (truncation, random octets, random counts) and gives each input in a heap block of exactly its size,
+so that the address sanitizer the target is built with catches any read past the end.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "IEC8705103Manager.h"
+#include "IEC8705103Measurands.h"
+
+static volatile unsigned int sink;
+
+static void Use(unsigned int Value) { sink = sink + Value; }
+
+static void UseBytes(const unsigned char *p, size_t Size) {
+  for (size_t i = 0; i < Size; i++) Use(p[i]);
+}
+
+static void Decode(const unsigned char *Data, size_t Size) {
+  ASDUView asdu(Data, Size);
+  Use(asdu.TypeIdentification() + asdu.Count() + asdu.CauseOfTransmission() + asdu.CommonAddress() +
+      asdu.FunctionType() + asdu.InformationNumber());
+
+  TimeTaggedMessageView message;
+  if (message.Bind(asdu)) {
+    Use(message.DPI() + message.RelativeTime() + message.FaultNumber() + message.SupplementaryInformation());
+    UseBytes(message.Time(), ASDUView::Cp32Size);
+  }
+
+  MeasurandsView measurands;
+  if (measurands.Bind(asdu))
+    for (unsigned char i = 0; i < measurands.Count(); i++) Use(measurands.Raw(i) + measurands.Error(i));
+
+  TimeTaggedMeasurandView measurand;
+  if (measurand.Bind(asdu)) {
+    Use(static_cast<unsigned int>(measurand.ShortCircuitLocation()) + measurand.RelativeTime() +
+        measurand.FaultNumber());
+    UseBytes(measurand.Time(), ASDUView::Cp32Size);
+  }
+
+  IdentificationView identification;
+  if (identification.Bind(asdu)) {
+    Use(identification.CompatibilityLevel() + identification.Manufacturer());
+    UseBytes(reinterpret_cast<const unsigned char *>(identification.Text()), 8);
+  }
+
+  TimeSyncView sync;
+  if (sync.Bind(asdu)) UseBytes(sync.Time(), ASDUView::Cp56Size);
+
+  ScanView scan;
+  if (scan.Bind(asdu)) Use(scan.ScanNumber());
+
+  GenericDataView generic;
+  if (generic.Bind(asdu)) {
+    Use(generic.ReturnInformationIdentifier() + generic.Group() + generic.Entry() + generic.More());
+    GenericElement element;
+    while (generic.Next(&element)) UseBytes(element.Data, element.Size);
+  }
+
+  DisturbanceListView list;
+  if (list.Bind(asdu))
+    for (unsigned char i = 0; i < list.Count(); i++) {
+      Use(list.FaultNumber(i) + list.FaultStatus(i));
+      UseBytes(list.Time(i), ASDUView::Cp56Size);
+    }
+
+  DisturbanceReadyView ready;
+  if (ready.Bind(asdu)) {
+    Use(ready.TypeOfValues() + ready.FaultNumber() + ready.NetworkFault() + ready.Channels() + ready.Elements() +
+        ready.Interval());
+    UseBytes(ready.Time(), ASDUView::Cp32Size);
+  }
+
+  ChannelReadyView channel;
+  if (channel.Bind(asdu))
+    Use(channel.TypeOfValues() + channel.FaultNumber() + channel.Channel() +
+        static_cast<unsigned int>(channel.PrimaryRated() + channel.SecondaryRated() + channel.ReferenceFactor()));
+
+  TagsReadyView tagsReady;
+  if (tagsReady.Bind(asdu)) Use(tagsReady.FaultNumber());
+
+  TagsView tags;
+  if (tags.Bind(asdu)) {
+    Use(tags.FaultNumber() + tags.TagPosition());
+    for (unsigned char i = 0; i < tags.Count(); i++)
+      Use(tags.FunctionType(i) + tags.InformationNumber(i) + tags.DPI(i));
+  }
+
+  DisturbanceValuesView values;
+  if (values.Bind(asdu)) {
+    Use(values.TypeOfValues() + values.FaultNumber() + values.Channel() + values.FirstElement());
+    for (unsigned char i = 0; i < values.Count(); i++) Use(static_cast<unsigned short>(values.Value(i)));
+  }
+
+  TransmissionEndView end;
+  if (end.Bind(asdu)) Use(end.TypeOfOrder() + end.TypeOfValues() + end.FaultNumber() + end.Channel());
+
+  EnergyCounterView energy;
+  if (energy.Bind(asdu)) Use(energy.Value());
+
+  /*Decoders built on the views*/
+  unsigned short raw[128];
+  Use(IEC8705103Manager::GetDPI(Data, Size) + IEC8705103Manager::GetMeasurandsII(Data, raw, Size));
+
+  IEC8705103Manager::Energy meter;
+  if (IEC8705103Manager::GetEnergy(Data, &meter, Size)) Use(meter.value);
+
+  IEC8705103Manager::cp56Time2A time;
+  unsigned short relative;
+  if (IEC8705103Manager::GetTimeFromTaggedMessage(Data, &time, &relative, Size)) Use(time.GetMilliseconds());
+
+  float scale[128];
+  float scaled[128];
+  unsigned char quality[128];
+  for (int i = 0; i < 128; i++) scale[i] = 1.0f;
+  Use(static_cast<unsigned int>(IEC8705103MeasurandDecoder::Decode(Data, Size, scale, scaled, quality, 128)));
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char *Data, size_t Size) {
+  Decode(Data, Size);
+  return 0;
+}
+
+#ifndef OPEN103_LIBFUZZER
+/*A valid ASDU of Type, with Count elements where the type has a count*/
+static std::vector<unsigned char> Seed(unsigned char Type, unsigned char Count) {
+  std::vector<unsigned char> a(6, 0);
+  a[0] = Type;
+  a[1] = Type == 3 || Type == 9 || Type == 23 ? Count : 0x81;
+  a[2] = 1;
+  a[3] = 1;
+  a[4] = 160;
+  a[5] = 1;
+
+  size_t body = 0;
+  switch (Type) {
+    case 1: body = 6; break;
+    case 2: body = 10; break;
+    case 3:
+    case 9: body = 2 * Count; break;
+    case 4: body = 12; break;
+    case 5: body = 13; break;
+    case 6: body = ASDUView::Cp56Size; break;
+    case 8: body = 1; break;
+    case 23: body = DisturbanceListView::EntrySize * Count; break;
+    case 26: body = 11 + ASDUView::Cp32Size; break;
+    case 27: body = 17; break;
+    case 28: body = 4; break;
+    case 29: body = 5 + 3 * Count; break;
+    case 30: body = 8 + 2 * Count; break;
+    case 31: body = 5; break;
+    case 205: body = 4; break;
+    default: break;
+  }
+  a.resize(6 + body, static_cast<unsigned char>(rand()));
+  for (size_t i = 6; i < a.size(); i++) a[i] = static_cast<unsigned char>(rand());
+
+  if (Type == 29) a[8] = Count; /*NOT*/
+  if (Type == 30) a[11] = Count; /*NDV*/
+
+  if (Type == 10 || Type == 11) {
+    /*RII, [GIN,] NGD/NDE, then Count elements of one octet*/
+    a.push_back(1);
+    if (Type == 11) {
+      a.push_back(1);
+      a.push_back(2);
+    }
+    a.push_back(Count & 0x3F);
+    for (unsigned char i = 0; i < (Count & 0x3F); i++) {
+      if (Type == 10) {
+        a.push_back(1);
+        a.push_back(i);
+      }
+      a.push_back(1);    /*KOD*/
+      a.push_back(3);    /*GDD: unsigned integer*/
+      a.push_back(1);    /*Size*/
+      a.push_back(1);    /*Number*/
+      a.push_back(i);
+    }
+  }
+  return a;
+}
+
+int main(int argc, char **argv) {
+  const int Iterations = argc > 1 ? atoi(argv[1]) : 200000;
+  static const unsigned char Types[] = {1, 2, 3, 4, 5, 6, 8, 9, 10, 11, 23, 26, 27, 28, 29, 30, 31, 205};
+
+  srand(103);
+  for (int n = 0; n < Iterations; n++) {
+    std::vector<unsigned char> input =
+        Seed(Types[rand() % sizeof Types], static_cast<unsigned char>(rand() % 40));
+
+    switch (rand() % 4) {
+      case 0: /*Truncated*/
+        input.resize(rand() % (input.size() + 1));
+        break;
+      case 1: /*Random octets, the count among them*/
+        for (int k = rand() % 4; k >= 0; k--) input[rand() % input.size()] = static_cast<unsigned char>(rand());
+        break;
+      case 2: /*Random count, same length*/
+        input[1] = static_cast<unsigned char>(rand());
+        break;
+      default: /*Valid*/
+        break;
+    }
+
+    unsigned char *block = new unsigned char[input.size()];
+    if (!input.empty()) memcpy(block, &input[0], input.size());
+    Decode(block, input.size());
+    delete[] block;
+  }
+
+  printf("%d inputs decoded\n", Iterations);
+  return 0;
+}
+#endif
@@ -0,0 +1,70 @@
+/*
+Cost of the bounds checks of the ASDU views: the fields of ASDU 2 (time-tagged message with relative time) read
+through TimeTaggedMessageView against the same reads with unchecked pointer arithmetic, as the decoders did before the
+views. Prints the time per ASDU of both.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "IEC8705103Asdu.h"
+
+static const size_t Asdus = 4096;
+static const size_t AsduSize = 16;
+static const int Rounds = 500;
+
+static double Seconds(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+/*What the old getters did: the header is trusted, offsets are computed from the start*/
+static unsigned int Unchecked(const unsigned char *p) {
+  unsigned int dpi = p[6] & 0x3;
+  unsigned int relative = p[7] | (p[8] << 8);
+  unsigned int fault = p[9] | (p[10] << 8);
+  unsigned int ms = p[11] | (p[12] << 8);
+  return dpi + relative + fault + ms + p[15];
+}
+
+static unsigned int Checked(const unsigned char *p, size_t Size) {
+  TimeTaggedMessageView message;
+  if (!message.Bind(ASDUView(p, Size))) return 0;
+
+  const unsigned char *time = message.Time();
+  return message.DPI() + message.RelativeTime() + message.FaultNumber() + (time[0] | (time[1] << 8)) +
+         message.SupplementaryInformation();
+}
+
+int main() {
+  std::vector<unsigned char> asdus(Asdus * AsduSize);
+  srand(103);
+  for (size_t i = 0; i < Asdus; i++) {
+    unsigned char *p = &asdus[i * AsduSize];
+    for (size_t k = 0; k < AsduSize; k++) p[k] = static_cast<unsigned char>(rand());
+    p[0] = 2;
+    p[1] = 0x81;
+  }
+
+  for (size_t i = 0; i < Asdus; i++)
+    if (Checked(&asdus[i * AsduSize], AsduSize) != Unchecked(&asdus[i * AsduSize])) {
+      printf("FAIL: ASDU %zu decoded differently\n", i);
+      return 1;
+    }
+
+  unsigned long long sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++)
+    for (size_t i = 0; i < Asdus; i++) sum += Unchecked(&asdus[i * AsduSize]);
+  double unchecked = Seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++)
+    for (size_t i = 0; i < Asdus; i++) sum += Checked(&asdus[i * AsduSize], AsduSize);
+  double checked = Seconds(start);
+
+  double perAsdu = 1e9 / (static_cast<double>(Rounds) * Asdus);
+  printf("ASDU 2 fields: unchecked %.2f ns, view %.2f ns [%llu]\n", unchecked * perAsdu, checked * perAsdu, sum);
+  return 0;
+}
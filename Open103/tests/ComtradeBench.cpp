@@ -0,0 +1,96 @@
+/*
+SaveToComtrade of a 5000 samples x 8 analog channels record (2 digital channels toggled by tags) in every format:
+prints the time to write each one and the size of its .dat, and checks the binary .dat sizes against the record
+layout (sample number, time stamp, the analog values, one 16 bit word for the digital channels).
+The files are written in the current directory.
+*/
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <vector>
+
+#include "IEC8705103Manager.h"
+
+static const unsigned short Samples = 5000;
+static const unsigned short Analogs = 8;
+static const unsigned short Digitals = 2;
+static const unsigned short TagSets = 20;
+static const int Rounds = 3;
+
+static long long FileSize(const std::string &Name) {
+  struct stat st;
+  return stat(Name.c_str(), &st) == 0 ? static_cast<long long>(st.st_size) : -1;
+}
+
+int main() {
+  std::vector<IEC8705103Manager::DisturbanceChannelValues> channels(MAX_DIST_COUNT);
+  std::vector<std::vector<int> > values(Analogs, std::vector<int>(Samples));
+  for (unsigned short c = 0; c < Analogs; c++) {
+    IEC8705103Manager::DisturbanceChannelValues &channel = channels[c + 1];
+    for (unsigned short i = 0; i < Samples; i++) values[c][i] = (i * 37 + c * 1000) % 20000 - 10000;
+    channel.SDV = &values[c][0];
+    channel.RPV = 1000;
+    channel.RSV = 1;
+    channel.RFA = 32768;
+  }
+
+  std::vector<IEC8705103Manager::TAG> tags(TagSets);
+  std::vector<IEC8705103Manager::DisturbanceTagSet> sets(TagSets);
+  for (unsigned short t = 0; t < TagSets; t++) {
+    tags[t].FType = 160;
+    tags[t].In = static_cast<unsigned char>(1 + t % Digitals);
+    tags[t].DIP = static_cast<unsigned char>(t / Digitals % 2 ? 1 : 2);
+    sets[t].NOT = 1;
+    sets[t].TAP = static_cast<unsigned short>(t * (Samples / TagSets));
+    sets[t].TagsValue = &tags[t];
+  }
+
+  IEC8705103Manager::Disturbance record;
+  memset(&record, 0, sizeof record);
+  record.TagsList.TagsHeader = &sets[0];
+  record.TagsList.TagsCount = TagSets;
+  record.TagsList.TagsCapacity = TagSets;
+  record.ChannelList.Channels = &channels[0];
+  record.ChannelList.Count = Analogs;
+  record.ChannelList.ChannelElements = Samples;
+  record.SamplingTime = 1000;
+
+  IEC8705103Manager::AnalogChannel analog[Analogs];
+  for (unsigned short c = 0; c < Analogs; c++) analog[c] = IEC8705103Manager::AnalogChannel("I", "L1", "", "A", c + 1);
+  IEC8705103Manager::DigitalChannel digital[Digitals] = {IEC8705103Manager::DigitalChannel("Trip", "", "", "0", 160, 1),
+                                                         IEC8705103Manager::DigitalChannel("Start", "", "", "0", 160, 2)};
+
+  static const IEC8705103Manager::ComtradeFormat Formats[] = {
+      IEC8705103Manager::ComtradeAscii, IEC8705103Manager::ComtradeBinary, IEC8705103Manager::ComtradeBinary32,
+      IEC8705103Manager::ComtradeFloat32};
+  static const char *const Names[] = {"ASCII", "BINARY", "BINARY32", "FLOAT32"};
+  static const long long RecordSizes[] = {0, 8 + 2 * Analogs + 2, 8 + 4 * Analogs + 2, 8 + 4 * Analogs + 2};
+
+  double ascii = 0;
+  for (int f = 0; f < 4; f++) {
+    std::string name = std::string("ComtradeBench_") + Names[f];
+    double best = 0;
+    for (int r = 0; r < Rounds; r++) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      if (!IEC8705103Manager::SaveToComtrade(name, "Bench", 1, &record, analog, Analogs, digital, Digitals, "50", "1",
+                                             Formats[f])) {
+        printf("FAIL: %s not written\n", Names[f]);
+        return 1;
+      }
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (r == 0 || seconds < best) best = seconds;
+    }
+    if (f == 0) ascii = best;
+
+    long long size = FileSize(name + ".dat");
+    printf("%-8s %7.2f ms (x%4.1f) %8lld bytes (%3.0f%% of ASCII)\n", Names[f], best * 1000, ascii / best, size,
+           100.0 * size / FileSize(std::string("ComtradeBench_ASCII.dat")));
+
+    if (RecordSizes[f] != 0 && size != RecordSizes[f] * Samples) {
+      printf("FAIL: %s .dat has %lld bytes, expected %lld\n", Names[f], size, RecordSizes[f] * Samples);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*
+Sessions per core of IEC87052EventDriver: 16 to 1024 lines on one driver thread, each line a socketpair with a
+simulated station on the other end. The stations (one thread, its own epoll) answer a reset of link with E5 and every
+request of data with an ASDU 9 at once, so the driver runs as fast as it can. Prints the answered polls per second of
+the driver thread and per session, and how many sessions one core keeps at 10 polls per second each. On a single CPU
+the stations share that core, so the figures are a lower bound.
+Then the stations hang up: every line must go down and the sink be told so.
+*/
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "IEC87052EventDriver.h"
+
+static const unsigned int Rate = 10; /*Polls per second a session needs*/
+static const double Seconds = 0.5;  /*Measured per configuration*/
+
+class CountingSink : public IEC87052EventSink {
+ public:
+  CountingSink(size_t Lines) : Asdus(new std::atomic<unsigned long long>[Lines]()), Downs(0) {}
+  ~CountingSink() { delete[] Asdus; }
+
+  virtual void OnAsdu(int Line, unsigned char /*Address*/, const void * /*pAsdu*/, size_t /*Size*/) {
+    Asdus[Line].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  virtual void OnLineDown(int /*Line*/) { Downs.fetch_add(1); }
+
+  std::atomic<unsigned long long> *Asdus; /*Answered polls of each line*/
+  std::atomic<unsigned int> Downs;
+};
+
+/*Secondary stations of every line. Requests are fixed frames: 10 C A CS 16*/
+class Stations {
+ public:
+  Stations(const std::vector<int> &Fds) : fds(Fds), pending(Fds.size()), stop(false) {
+    static const unsigned char asdu[] = {9, 4, 2, 1, 160, 148, 0x08, 0x10, 0x10, 0x20, 0x18, 0x30, 0x20, 0x40};
+    FT12Frame frame(0x08, 1, asdu, sizeof asdu);
+    dataSize = frame.Encode(data);
+    thread = std::thread(&Stations::Run, this);
+  }
+
+  void Stop() {
+    stop.store(true);
+    thread.join();
+  }
+
+ private:
+  void Run() {
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i = 0; i < fds.size(); i++) {
+      epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.u32 = static_cast<unsigned int>(i);
+      epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev);
+    }
+
+    epoll_event events[256];
+    while (!stop.load(std::memory_order_relaxed)) {
+      int n = epoll_wait(epfd, events, 256, 10);
+      for (int e = 0; e < n; e++) Answer(events[e].data.u32);
+    }
+    close(epfd);
+  }
+
+  void Answer(unsigned int i) {
+    unsigned char in[256];
+    ssize_t n = read(fds[i], in, sizeof in);
+    if (n <= 0) return;
+
+    std::vector<unsigned char> &p = pending[i];
+    p.insert(p.end(), in, in + n);
+    size_t k = 0;
+    while (p.size() - k >= FT12Frame::FixedFrameSize) {
+      if (p[k] != 0x10) {
+        k++;
+        continue;
+      }
+      unsigned char function = p[k + 1] & 0xF;
+      k += FT12Frame::FixedFrameSize;
+
+      static const unsigned char ack = 0xE5;
+      ssize_t w = function == 10 || function == 11 ? write(fds[i], data, dataSize) : write(fds[i], &ack, 1);
+      (void)w;
+    }
+    p.erase(p.begin(), p.begin() + k);
+  }
+
+  std::vector<int> fds;
+  std::vector<std::vector<unsigned char> > pending;
+  unsigned char data[FT12Deframer::MaxFrameSize];
+  size_t dataSize;
+  std::atomic<bool> stop;
+  std::thread thread;
+};
+
+static bool Run(size_t Lines) {
+  std::vector<int> driverFds;
+  std::vector<int> stationFds;
+  for (size_t i = 0; i < Lines; i++) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) != 0) {
+      printf("FAIL: socketpair\n");
+      return false;
+    }
+    driverFds.push_back(sv[0]);
+    stationFds.push_back(sv[1]);
+  }
+
+  LinkTimings timings;
+  timings.BaudRate = 115200;
+  timings.ResponseTimeout = 50;
+
+  CountingSink sink(Lines);
+  IEC87052EventDriver driver(1);
+  for (size_t i = 0; i < Lines; i++) driver.AddLine(driverFds[i], &sink, timings)->GetPollList().AddStation(1);
+
+  Stations stations(stationFds);
+  driver.Start();
+  std::this_thread::sleep_for(std::chrono::duration<double>(Seconds));
+
+  unsigned long long polls = 0;
+  unsigned long long least = ~0ULL;
+  for (size_t i = 0; i < Lines; i++) {
+    unsigned long long answered = sink.Asdus[i].load();
+    polls += answered;
+    if (answered < least) least = answered;
+  }
+  stations.Stop();
+
+  /*The stations hang up: each line must go down on its own*/
+  for (size_t i = 0; i < Lines; i++) close(stationFds[i]);
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (sink.Downs.load() < Lines && std::chrono::steady_clock::now() < end)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  driver.Stop();
+  for (size_t i = 0; i < Lines; i++) close(driverFds[i]);
+
+  double rate = polls / Seconds;
+  printf("%5zu sessions: %8.0f polls/s on one driver thread, %7.1f per session, %6.0f sessions per core at %u/s\n",
+         Lines, rate, rate / Lines, rate / Rate, Rate);
+
+  if (least == 0) {
+    printf("FAIL: a session never got an answer\n");
+    return false;
+  }
+  if (sink.Downs.load() != Lines) {
+    printf("FAIL: %u of %zu lines went down after the hang up\n", sink.Downs.load(), Lines);
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  /*The driver writes with write(): a request sent after the station hung up must fail with EPIPE, not kill us*/
+  signal(SIGPIPE, SIG_IGN);
+
+  /*Two descriptors per line, plus the driver and station event loops*/
+  rlimit limit;
+  size_t maxLines = 1024;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 2 * maxLines + 64)
+    maxLines = limit.rlim_cur > 64 ? (limit.rlim_cur - 64) / 2 : 0;
+
+  static const size_t Counts[] = {16, 64, 256, 1024};
+  for (size_t c = 0; c < sizeof Counts / sizeof Counts[0]; c++) {
+    if (Counts[c] > maxLines) break;
+    if (!Run(Counts[c])) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+/*
+Contention on the shared process image: one writer thread per bus, each updating its own IEC8705103ProcessImage
+published to an IEC8705103SharedImage, while reader threads copy devices (and now and then the whole image) of every
+bus. Prints the update rate of the writers with 0, 1, 4 and 16 readers, and the copies done by the readers.
+Every ASDU 9 written gives the same value to all its points, so a reader seeing two values in one copy of a device
+has got a torn snapshot: the test then fails.
+*/
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "IEC8705103SharedImage.h"
+
+static const int Buses = 2;
+static const int Devices = 16; /*Per bus*/
+static const int Points = 16;  /*Measurands per ASDU 9*/
+static const int Updates = 100000;
+
+typedef struct Bus_ {
+  IEC8705103ProcessImage image;
+  IEC8705103SharedImage shared;
+} Bus;
+
+static void Writer(Bus *bus) {
+  unsigned char asdu[6 + 2 * Points] = {9, Points, 2, 0, 128, 148};
+  for (int k = 0; k < Updates; k++) {
+    asdu[3] = static_cast<unsigned char>(1 + k % Devices);
+    unsigned short value = static_cast<unsigned short>((k % 4000) << 3);
+    for (int i = 0; i < Points; i++) {
+      asdu[6 + 2 * i] = static_cast<unsigned char>(value);
+      asdu[7 + 2 * i] = static_cast<unsigned char>(value >> 8);
+    }
+    bus->image.Update(asdu, sizeof asdu);
+  }
+}
+
+static void Reader(Bus *buses, const std::atomic<bool> *stop, std::atomic<long> *copies, std::atomic<long> *torn) {
+  std::vector<ProcessPoint> points;
+  for (unsigned int n = 0; !stop->load(std::memory_order_relaxed); n++) {
+    Bus &bus = buses[n % Buses];
+    if (n % 64 == 63) {
+      bus.shared.ReadImage(&points);
+    } else {
+      bus.shared.ReadDevice(static_cast<unsigned char>(1 + n % Devices), &points);
+      for (size_t i = 1; i < points.size(); i++)
+        if (points[i].Value != points[0].Value) {
+          torn->fetch_add(1);
+          break;
+        }
+    }
+    copies->fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+int main() {
+  static const int ReaderCounts[] = {0, 1, 4, 16};
+  double alone = 0;
+
+  for (size_t c = 0; c < sizeof ReaderCounts / sizeof ReaderCounts[0]; c++) {
+    Bus *buses = new Bus[Buses];
+    for (int b = 0; b < Buses; b++) buses[b].image.Publish(&buses[b].shared);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> copies(0);
+    std::atomic<long> torn(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < ReaderCounts[c]; r++) readers.push_back(std::thread(Reader, buses, &stop, &copies, &torn));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (int b = 0; b < Buses; b++) writers.push_back(std::thread(Writer, &buses[b]));
+    for (size_t w = 0; w < writers.size(); w++) writers[w].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    stop.store(true);
+    for (size_t r = 0; r < readers.size(); r++) readers[r].join();
+    delete[] buses;
+
+    double rate = Buses * Updates / seconds;
+    if (c == 0) alone = rate;
+    printf("%2d readers: %9.0f ASDU/s written (%3.0f%% of no readers), %8.0f copies/s read\n", ReaderCounts[c], rate,
+           100 * rate / alone, copies.load() / seconds);
+
+    if (torn.load() != 0) {
+      printf("FAIL: %ld torn device copies\n", torn.load());
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+/*
+IEC8705103Journal in a temporary directory. Query() by time range and equipment against a scan of what was written,
+over several segments and index blocks, before and after reopening. Then a process that appends and dies without
+Close(): the records on disk are recovered, after the spare segment it had created in advance, also when the crash
+left that spare file empty; a record torn by the crash is discarded and its sequence number reused.
+*/
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IEC8705103Journal.h"
+
+static int failures = 0;
+
+static void Check(bool Condition, const char *What) {
+  printf("%s: %s\n", Condition ? "ok" : "FAIL", What);
+  if (!Condition) failures++;
+}
+
+static const size_t SegmentSize = 4096;
+static const size_t RecordSize = 56; /*Header and event payload, aligned*/
+
+static SoeEvent Event(long long Time, unsigned char Address, unsigned char InformationNumber) {
+  SoeEvent event = SoeEvent();
+  event.Time = Time;
+  event.Received = Time + 5;
+  event.Address = Address;
+  event.Type = 1;
+  event.CauseOfTransmission = 1;
+  event.FunctionType = 160;
+  event.InformationNumber = InformationNumber;
+  event.DPI = 2;
+  return event;
+}
+
+static void Collect(void *Context, const JournalRecord &Record) {
+  std::vector<JournalRecord> *records = static_cast<std::vector<JournalRecord> *>(Context);
+  records->push_back(Record);
+  records->back().Payload = 0; /*Only valid during the call*/
+}
+
+static std::vector<JournalRecord> Query(IEC8705103Journal &Journal, long long From, long long To, int Address) {
+  std::vector<JournalRecord> records;
+  size_t count = Journal.Query(From, To, Address, Collect, &records);
+  if (count != records.size()) records.clear();
+  return records;
+}
+
+/*Sequence numbers of the records written, as Query must return them*/
+static std::vector<unsigned long long> Expected(const std::vector<JournalRecord> &Written, long long From, long long To,
+                                                int Address) {
+  std::vector<unsigned long long> sequences;
+  for (size_t i = 0; i < Written.size(); i++)
+    if (Written[i].Time >= From && Written[i].Time <= To && (Address < 0 || Written[i].Address == Address))
+      sequences.push_back(Written[i].Sequence);
+  return sequences;
+}
+
+static bool Matches(const std::vector<JournalRecord> &Records, const std::vector<unsigned long long> &Sequences) {
+  if (Records.size() != Sequences.size()) return false;
+  for (size_t i = 0; i < Records.size(); i++)
+    if (Records[i].Sequence != Sequences[i]) return false;
+  return true;
+}
+
+static std::vector<std::string> Segments(const std::string &Directory) {
+  std::vector<std::string> names;
+  DIR *dir = opendir(Directory.c_str());
+  if (dir == 0) return names;
+  while (dirent *entry = readdir(dir))
+    if (strncmp(entry->d_name, "journal-", 8) == 0) names.push_back(Directory + "/" + entry->d_name);
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+static void Remove(const std::string &Directory) {
+  std::vector<std::string> names = Segments(Directory);
+  for (size_t i = 0; i < names.size(); i++) unlink(names[i].c_str());
+  rmdir(Directory.c_str());
+}
+
+/*Appends Count events in a child process that dies without Close() once they are durable and the spare exists*/
+static bool Crash(const std::string &Directory, int Count) {
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    IEC8705103Journal journal(Directory, SegmentSize);
+    if (!journal.Open()) _exit(1);
+    unsigned long long last = 0;
+    for (int i = 0; i < Count; i++) last = journal.AppendEvent(Event(1000 * (i + 1), 1, static_cast<unsigned char>(i)));
+    if (last != static_cast<unsigned long long>(Count) || !journal.WaitDurable(last, 2000)) _exit(1);
+    for (int i = 0; i < 2000 && Segments(Directory).size() < 2; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    _exit(Segments(Directory).size() == 2 ? 0 : 1);
+  }
+
+  int status = 0;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool Sequences(IEC8705103Journal &Journal, unsigned long long Count) {
+  std::vector<JournalRecord> records = Query(Journal, LLONG_MIN, LLONG_MAX, -1);
+  if (records.size() != Count) return false;
+  for (size_t i = 0; i < records.size(); i++)
+    if (records[i].Sequence != i + 1) return false;
+  return true;
+}
+
+int main() {
+  char base[] = "/tmp/open103-journal-XXXXXX";
+  if (mkdtemp(base) == 0) {
+    printf("FAIL: temporary directory\n");
+    return 1;
+  }
+  const std::string root = base;
+
+  /*Equipment 1 to 5 report in turn; times go back every 100 records, as after a clock step of one of them*/
+  {
+    const std::string directory = root + "/query";
+    IEC8705103Journal journal(directory, SegmentSize, 10, 1 << 20, 16);
+    Check(journal.Open(), "journal opened");
+
+    std::vector<JournalRecord> written;
+    bool appended = true;
+    for (int i = 0; i < 500; i++) {
+      JournalRecord r = JournalRecord();
+      r.Time = 1000LL * (i % 100) + 10 * (i / 100);
+      r.Address = static_cast<unsigned char>(1 + i % 5);
+      if (i % 7 == 0) {
+        unsigned char asdu[] = {9, 4, 2, r.Address, 160, 148, 0x08, 0x10, 0x10, 0x20, 0x18, 0x30, 0x20, 0x40};
+        r.Sequence = journal.AppendAsdu(r.Address, asdu, sizeof asdu, r.Time);
+      } else {
+        r.Sequence = journal.AppendEvent(Event(r.Time, r.Address, static_cast<unsigned char>(i)));
+      }
+      appended = appended && r.Sequence == static_cast<unsigned long long>(i + 1);
+      written.push_back(r);
+    }
+    Check(appended && journal.WaitDurable(500, 2000), "500 records appended and durable");
+    Check(Segments(directory).size() > 5, "records span several segments");
+
+    static const struct {
+      long long From;
+      long long To;
+      int Address;
+    } Queries[] = {{LLONG_MIN, LLONG_MAX, -1}, {20000, 45000, -1}, {20000, 45000, 3}, {0, 99999, 5},
+                   {7010, 7010, 3},            {7010, 7010, 2},    {200000, 300000, -1}, {0, 99999, 6}};
+    bool matched = true;
+    bool reopened = true;
+    for (size_t q = 0; q < sizeof Queries / sizeof Queries[0]; q++)
+      matched = matched && Matches(Query(journal, Queries[q].From, Queries[q].To, Queries[q].Address),
+                                   Expected(written, Queries[q].From, Queries[q].To, Queries[q].Address));
+    Check(matched, "query by time and equipment returns what was written, in order");
+
+    std::vector<JournalRecord> one = Query(journal, 7010, 7010, 3);
+    Check(one.size() == 1 && one[0].Kind == JournalEvent && one[0].Received == 7015, "record of an event");
+    std::vector<JournalRecord> asdu = Query(journal, 7000, 7000, 3);
+    Check(asdu.size() == 1 && asdu[0].Kind == JournalAsdu && asdu[0].Size == 14 && asdu[0].Received == 7000,
+          "record of an ASDU");
+
+    journal.Close();
+    Check(journal.Open(), "journal reopened");
+    for (size_t q = 0; q < sizeof Queries / sizeof Queries[0]; q++)
+      reopened = reopened && Matches(Query(journal, Queries[q].From, Queries[q].To, Queries[q].Address),
+                                     Expected(written, Queries[q].From, Queries[q].To, Queries[q].Address));
+    Check(reopened, "the same after reopening, from the rebuilt index");
+    Check(journal.AppendEvent(Event(0, 1, 0)) == 501, "sequence numbers resume after reopening");
+
+    struct DecodeContext {
+      bool Decoded;
+    } context = {false};
+    journal.Query(7010, 7010, 3, [](void *Context, const JournalRecord &Record) {
+      SoeEvent e;
+      static_cast<DecodeContext *>(Context)->Decoded = IEC8705103Journal::DecodeEvent(Record, &e) &&
+                                                        e.InformationNumber == 107 && e.Address == 3 &&
+                                                        e.Time == 7010 && e.DPI == 2;
+    }, &context);
+    Check(context.Decoded, "event decoded from its record");
+    journal.Close();
+    Remove(directory);
+  }
+
+  /*Crash after the spare segment was created: the records are in the segment before it*/
+  {
+    const std::string directory = root + "/spare";
+    Check(Crash(directory, 5), "crashed with records durable and a spare segment");
+    IEC8705103Journal journal(directory, SegmentSize);
+    Check(journal.Open() && Sequences(journal, 5), "records recovered past the spare segment");
+    Check(journal.AppendEvent(Event(9000, 1, 9)) == 6 && Sequences(journal, 6), "appending resumes in the spare");
+    journal.Close();
+
+    /*A crash while the next spare was being created can leave its file empty*/
+    std::vector<std::string> names = Segments(directory);
+    unsigned long long number = 0;
+    sscanf(names.back().c_str() + directory.size(), "/journal-%llu", &number);
+    char name[64];
+    snprintf(name, sizeof name, "/journal-%010llu.log", number + 1);
+    int fd = open((directory + name).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd >= 0) close(fd);
+    Check(fd >= 0 && journal.Open() && Sequences(journal, 6), "empty spare segment left by a crash skipped");
+    Check(journal.AppendEvent(Event(9500, 1, 10)) == 7 && Sequences(journal, 7), "appending resumes after it");
+    journal.Close();
+    Remove(directory);
+  }
+
+  /*Crash in the middle of a record: the last one is torn, the spare was not created yet*/
+  {
+    const std::string directory = root + "/torn";
+    Check(Crash(directory, 10), "crashed with 10 records durable");
+    std::vector<std::string> names = Segments(directory);
+    if (names.size() == 2) unlink(names.back().c_str());
+
+    int fd = open(names.front().c_str(), O_RDWR);
+    unsigned char garbage = 0xAA;
+    bool torn = fd >= 0 && pwrite(fd, &garbage, 1, 16 + 9 * RecordSize + 45) == 1;
+    if (fd >= 0) close(fd);
+
+    IEC8705103Journal journal(directory, SegmentSize);
+    Check(torn && journal.Open() && Sequences(journal, 9), "torn record discarded, the ones before it kept");
+    Check(journal.AppendEvent(Event(20000, 2, 20)) == 10 && Sequences(journal, 10),
+          "its sequence number is reused by the next record");
+    std::vector<JournalRecord> last = Query(journal, 20000, 20000, 2);
+    Check(last.size() == 1 && last[0].Sequence == 10, "the new record is read back");
+    journal.Close();
+
+    Check(journal.Open() && Sequences(journal, 10), "and recovered after reopening");
+    journal.Close();
+    Remove(directory);
+  }
+
+  rmdir(root.c_str());
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/*
+The steady-state poll loop of the link layer (request of class 2 data, answer with measurands, decode of the ASDU)
+must perform no heap allocation. Global operator new is replaced by a counting one; the port is a class without
+virtual functions, so with IEC87052Manager_<StationPort> every port call is resolved at compile time as well.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <type_traits>
+
+#include "IEC8705103Manager.h"
+
+static unsigned long long allocations = 0;
+
+void *operator new(size_t Size) {
+  allocations++;
+  void *p = malloc(Size != 0 ? Size : 1);
+  if (p == 0) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+/*Secondary station in memory: answers a reset of link with E5 and every class 2 request with an ASDU 9*/
+class StationPort {
+ public:
+  StationPort() : answerSize(0) {}
+
+  int Write(unsigned char *thePacket, int len) {
+    if (len == FT12Frame::FixedFrameSize && (thePacket[1] & 0xF) == 0) {
+      answer[0] = 0xE5;
+      answerSize = 1;
+      return len;
+    }
+
+    static const unsigned char asdu[] = {9, 4, 2, 1, 160, 148, 0x08, 0x10, 0x10, 0x20, 0x18, 0x30, 0x20, 0x40};
+    FT12Frame frame(0x08, thePacket[2], asdu, sizeof asdu);
+    answerSize = frame.Encode(answer);
+    return len;
+  }
+
+  int Read(unsigned char *thePacket, int maxlen) {
+    int n = static_cast<int>(answerSize) < maxlen ? static_cast<int>(answerSize) : maxlen;
+    memcpy(thePacket, answer, n);
+    answerSize = 0;
+    return n;
+  }
+
+  bool SetReadTimeout(unsigned int /*Milliseconds*/) { return true; }
+
+ private:
+  unsigned char answer[FT12Deframer::MaxFrameSize];
+  size_t answerSize;
+};
+
+static_assert(!std::is_polymorphic<StationPort>::value, "the port must not need virtual calls");
+
+int main() {
+  StationPort port;
+  IEC87052Manager_<StationPort> link(&port, 1);
+  if (!link.ResetRemoteLink()) {
+    printf("FAIL: reset of remote link\n");
+    return 1;
+  }
+
+  const int Polls = 100000;
+  unsigned long long before = allocations;
+  unsigned long long sum = 0;
+  for (int i = 0; i < Polls; i++) {
+    if (!link.UserDataClass(2)) {
+      printf("FAIL: poll %d not answered\n", i);
+      return 1;
+    }
+
+    const FT12Frame *answer = link.GetLastReceivedFrame();
+    unsigned short measures[4];
+    unsigned char n = IEC8705103Manager::GetMeasurandsII(answer->UserData, measures, answer->UserDataSize);
+    if (n != 4) {
+      printf("FAIL: %u measurands decoded\n", n);
+      return 1;
+    }
+    sum += measures[0];
+  }
+  unsigned long long used = allocations - before;
+
+  printf("%d polls, %llu heap allocations (checksum %llu)\n", Polls, used, sum);
+  if (used != 0) {
+    printf("FAIL: the poll loop allocates\n");
+    return 1;
+  }
+  return 0;
+}
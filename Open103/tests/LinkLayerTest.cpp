@@ -0,0 +1,144 @@
+/*
+Link layer transactions against a secondary station in memory that records every frame it receives: frame count bit
+of the requests of link status (FCV = 0) and of the frames around them. Then a line that sends noise without pause:
+the transaction must still fail within LinkTimings::WorstCaseTransactionTime, with IEC87052Manager_ and with a line
+of IEC87052EventDriver.
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "IEC87052EventDriver.h"
+#include "IEC87052Manager.h"
+
+static int failures = 0;
+
+static void Check(bool Condition, const char *What) {
+  printf("%s: %s\n", Condition ? "ok" : "FAIL", What);
+  if (!Condition) failures++;
+}
+
+/*Answers every request with E5 and keeps the control field of each one*/
+class StationPort {
+ public:
+  StationPort() : answerSize(0) {}
+
+  int Write(unsigned char *thePacket, int len) {
+    Controls.push_back(thePacket[0] == 0x10 ? thePacket[1] : thePacket[4]);
+    answerSize = 1;
+    return len;
+  }
+
+  int Read(unsigned char *thePacket, int maxlen) {
+    if (answerSize == 0 || maxlen < 1) return 0;
+    thePacket[0] = 0xE5;
+    answerSize = 0;
+    return 1;
+  }
+
+  bool SetReadTimeout(unsigned int /*Milliseconds*/) { return true; }
+
+  std::vector<unsigned char> Controls;
+
+ private:
+  size_t answerSize;
+};
+
+/*Never stops sending: a character every millisecond, none of them starts a frame*/
+class NoisePort {
+ public:
+  int Write(unsigned char * /*thePacket*/, int len) { return len; }
+
+  int Read(unsigned char *thePacket, int maxlen) {
+    if (maxlen < 1) return 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    thePacket[0] = 0x55;
+    return 1;
+  }
+
+  bool SetReadTimeout(unsigned int /*Milliseconds*/) { return true; }
+};
+
+class QuietSink : public IEC87052EventSink {
+ public:
+  virtual void OnAsdu(int /*Line*/, unsigned char /*Address*/, const void * /*pAsdu*/, size_t /*Size*/) {}
+};
+
+static long long Elapsed(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - Start).count();
+}
+
+static bool Fcb(unsigned char Control) { return (Control & 0x20) != 0; }
+static bool Fcv(unsigned char Control) { return (Control & 0x10) != 0; }
+
+int main() {
+  StationPort port;
+  IEC87052Manager_<StationPort> link(&port, 1);
+  static const unsigned char asdu[] = {6, 0x81, 8, 1, 255, 0, 0, 0, 0, 0, 1, 1, 20};
+
+  /*Reset, confirmed data, link status, confirmed data, link status, link status, poll*/
+  bool ok = link.ResetRemoteLink() && link.UserData(asdu, sizeof asdu) && link.StatusLink() &&
+            link.UserData(asdu, sizeof asdu) && link.StatusLink() && link.StatusLink() && link.UserDataClass(2);
+  Check(ok && port.Controls.size() == 7, "all transactions answered");
+  if (port.Controls.size() != 7) return 1;
+
+  const std::vector<unsigned char> &c = port.Controls;
+  Check(!Fcv(c[2]) && !Fcb(c[2]) && !Fcv(c[4]) && !Fcb(c[4]), "link status sent with FCV = 0 and FCB = 0");
+  Check(Fcv(c[1]) && Fcv(c[3]) && Fcb(c[1]) != Fcb(c[3]), "FCB toggles across a link status");
+  Check(Fcv(c[6]) && Fcb(c[3]) != Fcb(c[6]), "FCB toggles across two link status");
+
+  NoisePort noise;
+  IEC87052Manager_<NoisePort> noisy(&noise, 1);
+  LinkTimings timings;
+  timings.BaudRate = 115200;
+  timings.ResponseTimeout = 20;
+  timings.Repeats = 1;
+  noisy.SetTimings(timings);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool answered = noisy.UserDataClass(2);
+  long long ms = Elapsed(start);
+  unsigned int bound = timings.WorstCaseTransactionTime(FT12Frame::FixedFrameSize);
+  printf("noise: failed after %lld ms, bound %u ms\n", ms, bound);
+  Check(!answered && ms <= bound + 50, "transaction on a noisy line ends within its worst case time");
+
+  /*The same on a line of the event driver: the other end of a socketpair sends start characters without pause*/
+  signal(SIGPIPE, SIG_IGN);
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) != 0) return 1;
+  std::atomic<bool> stop(false);
+  std::thread babbler([&sv, &stop] {
+    unsigned char in[64];
+    unsigned char start[16];
+    memset(start, 0x68, sizeof start);
+    while (!stop.load()) {
+      ssize_t n = read(sv[1], in, sizeof in); /*Requests are ignored*/
+      (void)n;
+      if (write(sv[1], start, sizeof start) < 0) std::this_thread::yield();
+    }
+  });
+
+  QuietSink sink;
+  IEC87052EventDriver driver(1);
+  IEC87052LineSession *line = driver.AddLine(sv[0], &sink, timings);
+  line->GetPollList().AddStation(1);
+  driver.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(3 * bound));
+  driver.Stop();
+  stop.store(true);
+  babbler.join();
+  close(sv[0]);
+  close(sv[1]);
+
+  printf("noise: %llu transactions of the driver line in %u ms\n", line->Transactions, 3 * bound);
+  Check(line->Transactions >= 2, "driver transaction on a noisy line ends");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/*
+Decoding of ASDU 9 measurands: IEC8705103MeasurandDecoder::DecodeBatch against GetMeasurandsII followed by the
+scaling the caller has to do. Checks that the batch decoder gives the signed values and the quality bits, then prints
+the time per ASDU of both.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "IEC8705103Manager.h"
+#include "IEC8705103Measurands.h"
+
+static const size_t Asdus = 1024;
+static const size_t Points = 16;
+static const size_t AsduSize = 6 + 2 * Points;
+static const int Rounds = 200;
+
+static double Seconds(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+int main() {
+  std::vector<unsigned char> asdus(Asdus * AsduSize);
+  srand(103);
+  for (size_t i = 0; i < Asdus; i++) {
+    unsigned char *p = &asdus[i * AsduSize];
+    p[0] = 9;
+    p[1] = Points;
+    p[2] = 2; /*Cyclic*/
+    p[3] = 1;
+    p[4] = 160;
+    p[5] = 148;
+    for (size_t k = 0; k < 2 * Points; k++) p[6 + k] = static_cast<unsigned char>(rand());
+  }
+
+  float scale[Points];
+  for (size_t k = 0; k < Points; k++) scale[k] = k % 2 ? 2.4f * 400 : 1.2f * 5;
+
+  std::vector<float> values(Asdus * Points);
+  std::vector<unsigned char> quality(Asdus * Points);
+  std::vector<MeasurandBatchItem> items(Asdus);
+  for (size_t i = 0; i < Asdus; i++) {
+    items[i].pAsdu = &asdus[i * AsduSize];
+    items[i].Size = AsduSize;
+    items[i].Scale = scale;
+    items[i].Values = &values[i * Points];
+    items[i].Quality = &quality[i * Points];
+    items[i].Capacity = Points;
+  }
+
+  if (IEC8705103MeasurandDecoder::DecodeBatch(&items[0], Asdus) != Asdus * Points) {
+    printf("FAIL: not every value decoded\n");
+    return 1;
+  }
+  for (size_t i = 0; i < Asdus * Points; i++) {
+    const unsigned char *w = &asdus[(i / Points) * AsduSize + 6 + 2 * (i % Points)];
+    short raw = static_cast<short>(w[0] | (w[1] << 8));
+    float expected = (raw >> 3) * IEC8705103MeasurandDecoder::Step() * scale[i % Points];
+    if (values[i] != expected || quality[i] != (raw & 0x3)) {
+      printf("FAIL: value %zu is %f (quality %u), expected %f (quality %u)\n", i, values[i], quality[i], expected,
+             raw & 0x3);
+      return 1;
+    }
+  }
+
+  float sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++) {
+    for (size_t i = 0; i < Asdus; i++) {
+      unsigned short raw[Points];
+      unsigned char n = IEC8705103Manager::GetMeasurandsII(&asdus[i * AsduSize], raw, AsduSize);
+      for (unsigned char k = 0; k < n; k++) values[i * Points + k] = raw[k] * IEC8705103MeasurandDecoder::Step() * scale[k];
+    }
+    sum += values[r % values.size()];
+  }
+  double old = Seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++) {
+    IEC8705103MeasurandDecoder::DecodeBatch(&items[0], Asdus);
+    sum += values[r % values.size()];
+  }
+  double batch = Seconds(start);
+
+  double perAsdu = 1e9 / (static_cast<double>(Rounds) * Asdus);
+  printf("ASDU 9 with %zu values: GetMeasurandsII + scaling %.1f ns, DecodeBatch %.1f ns (x%.1f) [%g]\n", Points,
+         old * perAsdu, batch * perAsdu, old / batch, sum);
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*
+LinuxSerialCommPort on a pseudo terminal pair: the port opens the slave side, the test plays the equipment on the
+master side. Checks raw mode (control characters pass unchanged), exclusive use, read timeouts, a link layer
+transaction through IEC87052Manager_<LinuxSerialCommPort> and the error once the other side hangs up.
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "IEC87052Manager.h"
+#include "LinuxSerialCommPort.h"
+
+static int failures = 0;
+
+static void Check(bool Condition, const char *What) {
+  printf("%s: %s\n", Condition ? "ok" : "FAIL", What);
+  if (!Condition) failures++;
+}
+
+/*Reads exactly Size bytes from the master side, false after a second without them*/
+static bool ReadMaster(int Master, unsigned char *p, size_t Size) {
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  size_t got = 0;
+  while (got < Size && std::chrono::steady_clock::now() < end) {
+    ssize_t n = read(Master, p + got, Size - got);
+    if (n > 0)
+      got += static_cast<size_t>(n);
+    else
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return got == Size;
+}
+
+int main() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    printf("No pseudo terminals here: skipped\n");
+    return 0;
+  }
+  fcntl(master, F_SETFL, O_NONBLOCK);
+  std::string slave = ptsname(master);
+
+  LinuxSerialCommPort port(slave, 9600);
+  Check(port.IsOpen(), "port opened on the slave side");
+  if (!port.IsOpen()) return 1;
+
+  {
+    LinuxSerialCommPort second(slave, 9600);
+    Check(!second.IsOpen(), "second open of the same line refused");
+  }
+
+  /*Raw mode: CR, XON/XOFF, ^C, ^D and 0xFF must arrive as they are*/
+  unsigned char special[] = {0x0D, 0x11, 0x13, 0x03, 0x04, 0x0A, 0x7F, 0xFF, 0x00, 0x16};
+  Check(write(master, special, sizeof special) == static_cast<ssize_t>(sizeof special), "master write");
+  port.SetReadTimeout(200);
+  unsigned char in[64];
+  int got = 0;
+  while (got < static_cast<int>(sizeof special)) {
+    int n = port.Read(in + got, static_cast<int>(sizeof in) - got);
+    if (n <= 0) break;
+    got += n;
+  }
+  Check(got == static_cast<int>(sizeof special) && memcmp(in, special, sizeof special) == 0,
+        "control characters read unchanged");
+
+  unsigned char out[] = {0x10, 0x49, 0x01, 0x4A, 0x16};
+  Check(port.Write(out, sizeof out) == static_cast<int>(sizeof out), "port write");
+  Check(ReadMaster(master, in, sizeof out) && memcmp(in, out, sizeof out) == 0, "frame received unchanged");
+
+  /*Nothing to read: 0 after the timeout*/
+  port.SetReadTimeout(50);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int r = port.Read(in, sizeof in);
+  long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  Check(r == 0 && ms >= 45 && ms < 1000, "read timeout");
+
+  /*Link layer: the equipment answers the reset of its link with E5*/
+  std::thread equipment([master] {
+    unsigned char request[5];
+    if (ReadMaster(master, request, sizeof request) && request[0] == 0x10 && (request[1] & 0xF) == 0) {
+      unsigned char ack = 0xE5;
+      if (write(master, &ack, 1) != 1) return;
+    }
+  });
+  IEC87052Manager_<LinuxSerialCommPort> link(&port, 1);
+  Check(link.ResetRemoteLink(), "reset of remote link answered");
+  equipment.join();
+
+  /*The other side hangs up: reads fail instead of timing out forever*/
+  close(master);
+  port.SetReadTimeout(200);
+  Check(port.Read(in, sizeof in) < 0, "read error after hang up");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/*
+IEC8705103SoeMerger on rings filled by hand: events of several equipment come out in device time order, equal times
+by source, only once older than the reorder window; an event older than one already emitted comes out with Late set
+and is counted; a full ring drops and counts. Then one producer thread per ring against a draining thread: every
+event comes out once, in order, none late.
+*/
+#include <limits.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "IEC8705103Soe.h"
+
+static int failures = 0;
+
+static void Check(bool Condition, const char *What) {
+  printf("%s: %s\n", Condition ? "ok" : "FAIL", What);
+  if (!Condition) failures++;
+}
+
+static SoeEvent Event(long long Time, unsigned char InformationNumber) {
+  SoeEvent event = SoeEvent();
+  event.Time = Time;
+  event.Received = Time;
+  event.Type = 1;
+  event.CauseOfTransmission = 1;
+  event.FunctionType = 160;
+  event.InformationNumber = InformationNumber;
+  event.DPI = 2;
+  return event;
+}
+
+static bool Ordered(const SoeEvent *Events, size_t Count) {
+  for (size_t i = 1; i < Count; i++) {
+    if (Events[i].Time < Events[i - 1].Time) return false;
+    if (Events[i].Time == Events[i - 1].Time && Events[i].Source < Events[i - 1].Source) return false;
+  }
+  return true;
+}
+
+static const long long Window = 1000;
+static const unsigned int Producers = 4;
+static const long long PerProducer = 200000;
+
+int main() {
+  IEC8705103SoeMerger merger(Window, 4);
+  IEC8705103SoeRing *a = merger.AddSource(1);
+  IEC8705103SoeRing *b = merger.AddSource(2);
+  IEC8705103SoeRing *c = merger.AddSource(3);
+
+  a->Push(Event(100, 1));
+  a->Push(Event(300, 2));
+  a->Push(Event(2500, 3));
+  b->Push(Event(200, 4));
+  b->Push(Event(300, 5));
+  c->Push(Event(50, 6));
+  c->Push(Event(1800, 7));
+
+  SoeEvent out[16];
+  size_t n = merger.Drain(2000, out, 16);
+  Check(n == 5 && Ordered(out, n) && out[0].InformationNumber == 6 && out[4].InformationNumber == 5,
+        "events older than the window in time order, equal times by source");
+  Check(n == 5 && out[0].Address == 3 && out[3].Address == 1 && !out[4].Late, "source and address of each event");
+
+  n = merger.Drain(2800, out, 16);
+  Check(n == 1 && out[0].InformationNumber == 7, "an event comes out once the window has passed it");
+
+  b->Push(Event(1500, 8));
+  n = merger.Drain(2800, out, 16);
+  Check(n == 1 && out[0].InformationNumber == 8 && out[0].Late && merger.GetLateCount() == 1,
+        "an event older than one already emitted is late");
+
+  n = merger.Flush(out, 16);
+  Check(n == 1 && out[0].InformationNumber == 3 && !out[0].Late, "flush emits what the window holds back");
+
+  for (int i = 0; i < 5; i++) c->Push(Event(3000 + i, static_cast<unsigned char>(10 + i)));
+  Check(c->GetDroppedCount() == 1 && merger.GetDroppedCount() == 1, "a full ring drops and counts");
+  n = merger.Drain(3003 + Window, out, 2);
+  Check(n == 2 && out[0].InformationNumber == 10 && out[1].InformationNumber == 11, "drain stops at its capacity");
+  n = merger.Flush(out, 16);
+  Check(n == 2 && out[1].InformationNumber == 13, "the rest after it");
+
+  /*Event ASDU: a decoded event, answers to general interrogation ignored*/
+  unsigned char asdu[] = {1, 0x81, 1, 1, 160, 20, 2, 0xDC, 0x05, 2, 0, 7};
+  const long long ms = 1000000LL;
+  Check(a->Post(asdu, sizeof asdu, 121600 * ms), "ASDU 1 posted");
+  asdu[2] = 9;
+  Check(!a->Post(asdu, sizeof asdu, 121600 * ms), "answer to general interrogation ignored");
+  n = merger.Flush(out, 16);
+  Check(n == 1 && out[0].Time == 121500 * ms && out[0].InformationNumber == 20 && out[0].DPI == 2 &&
+            out[0].SupplementaryInformation == 7 && out[0].Received == 121600 * ms,
+        "ASDU 1 decoded with its device time");
+
+  /*Each producer polls its own equipment: times rise within a ring, interleave across rings*/
+  IEC8705103SoeMerger concurrent(0, 256);
+  std::vector<IEC8705103SoeRing *> rings;
+  std::atomic<long long> progress[Producers]; /*Latest time queued by each producer*/
+  std::atomic<unsigned long long> retries(0);  /*Pushes refused by a full ring, counted as dropped*/
+  for (unsigned int p = 0; p < Producers; p++) {
+    rings.push_back(concurrent.AddSource(static_cast<unsigned char>(p + 1)));
+    progress[p].store(-1);
+  }
+
+  std::vector<std::thread> threads;
+  for (unsigned int p = 0; p < Producers; p++)
+    threads.push_back(std::thread([&, p] {
+      for (long long i = 0; i < PerProducer; i++) {
+        long long time = i * Producers + (p * 7) % Producers;
+        while (!rings[p]->Push(Event(time, 0))) {
+          retries.fetch_add(1);
+          std::this_thread::yield();
+        }
+        progress[p].store(time, std::memory_order_release);
+      }
+    }));
+
+  /*Nothing later than what every producer has queued is still to come*/
+  std::vector<SoeEvent> drained(4096);
+  unsigned long long total = 0;
+  bool ordered = true;
+  long long last = -1;
+  while (total < Producers * PerProducer) {
+    long long now = progress[0].load(std::memory_order_acquire);
+    for (unsigned int p = 1; p < Producers; p++) now = std::min(now, progress[p].load(std::memory_order_acquire));
+    if (now == (PerProducer - 1) * Producers) now = LLONG_MAX;
+
+    n = concurrent.Drain(now, &drained[0], drained.size());
+    for (size_t i = 0; i < n; i++) {
+      ordered = ordered && drained[i].Time > last && !drained[i].Late;
+      last = drained[i].Time;
+    }
+    total += n;
+    if (n == 0) std::this_thread::yield();
+  }
+  for (unsigned int p = 0; p < Producers; p++) threads[p].join();
+
+  Check(ordered && total == Producers * PerProducer && concurrent.GetLateCount() == 0 &&
+            concurrent.GetDroppedCount() == retries.load(),
+        "concurrent producers: every event once, in order, none late");
+
+  return failures == 0 ? 0 : 1;
+}
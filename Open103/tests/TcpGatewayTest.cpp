@@ -0,0 +1,186 @@
+/*
+TcpGatewayPort against a loopback stand-in of a serial-to-TCP converter: a listening socket whose thread answers as
+the relays behind it would (E5 to a reset of link, an ASDU 9 to every request of data, from the address asked).
+Checks link layer transactions through the port, one send() per frame, two links sharing one connection, the read
+timeout, reconnection after the gateway drops the connection and the refusal once it is gone.
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "IEC87052Manager.h"
+#include "TcpGatewayPort.h"
+
+static int failures = 0;
+
+static void Check(bool Condition, const char *What) {
+  printf("%s: %s\n", Condition ? "ok" : "FAIL", What);
+  if (!Condition) failures++;
+}
+
+/*Gateway with the relays behind it. Requests are fixed frames: 10 C A CS 16*/
+class Gateway {
+ public:
+  Gateway() : Silent(false), Hangup(false), listener(-1), port(0), stop(false) {
+    listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof addr;
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 ||
+        listen(listener, 4) != 0 || getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+      return;
+    port = ntohs(addr.sin_port);
+    thread = std::thread(&Gateway::Run, this);
+  }
+
+  /*Closes the listening socket: later connections are refused*/
+  void Stop() {
+    stop.store(true);
+    if (thread.joinable()) thread.join();
+    if (listener >= 0) close(listener);
+    listener = -1;
+  }
+
+  ~Gateway() { Stop(); }
+
+  unsigned short GetPort() const { return port; }
+
+  std::atomic<bool> Silent; /*Requests get no answer*/
+  std::atomic<bool> Hangup; /*Drop the connection, then accept the next one*/
+
+ private:
+  void Run() {
+    while (!stop.load()) {
+      if (!Wait(listener)) continue;
+      int client = accept4(listener, 0, 0, SOCK_CLOEXEC);
+      if (client < 0) continue;
+
+      std::vector<unsigned char> pending;
+      while (!stop.load() && !Hangup.load()) {
+        if (!Wait(client)) continue;
+        unsigned char in[256];
+        ssize_t n = recv(client, in, sizeof in, 0);
+        if (n <= 0) break;
+        pending.insert(pending.end(), in, in + n);
+        Answer(client, &pending);
+      }
+      close(client);
+      Hangup.store(false);
+    }
+  }
+
+  void Answer(int client, std::vector<unsigned char> *pending) {
+    std::vector<unsigned char> &p = *pending;
+    size_t k = 0;
+    while (p.size() - k >= FT12Frame::FixedFrameSize) {
+      if (p[k] != 0x10) {
+        k++;
+        continue;
+      }
+      unsigned char function = p[k + 1] & 0xF;
+      unsigned char address = p[k + 2];
+      k += FT12Frame::FixedFrameSize;
+      if (Silent.load()) continue;
+
+      unsigned char out[FT12Deframer::MaxFrameSize];
+      size_t size = 1;
+      out[0] = 0xE5;
+      if (function == 10 || function == 11) {
+        static const unsigned char asdu[] = {9, 4, 2, 0, 160, 148, 0x08, 0x10, 0x10, 0x20, 0x18, 0x30, 0x20, 0x40};
+        unsigned char data[sizeof asdu];
+        memcpy(data, asdu, sizeof asdu);
+        data[3] = address;
+        size = FT12Frame(0x08, address, data, sizeof data).Encode(out);
+      }
+      if (send(client, out, size, MSG_NOSIGNAL) != static_cast<ssize_t>(size)) return;
+    }
+    p.erase(p.begin(), p.begin() + k);
+  }
+
+  static bool Wait(int fd) {
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 10) > 0;
+  }
+
+  int listener;
+  unsigned short port;
+  std::atomic<bool> stop;
+  std::thread thread;
+};
+
+/*Polls a link and checks the answer comes from its own relay*/
+static bool Poll(IEC87052Manager_<TcpGatewayPort> &Link) {
+  if (!Link.UserDataClass(2)) return false;
+  const FT12Frame *answer = Link.GetLastReceivedFrame();
+  const unsigned char *asdu = static_cast<const unsigned char *>(answer->UserData);
+  return answer->Address == Link.GetAddress() && answer->UserDataSize > 3 && asdu[3] == Link.GetAddress();
+}
+
+int main() {
+  signal(SIGPIPE, SIG_IGN);
+
+  Gateway gateway;
+  if (gateway.GetPort() == 0) {
+    printf("No loopback socket here: skipped\n");
+    return 0;
+  }
+
+  TcpGatewayPort port("127.0.0.1", gateway.GetPort());
+  TcpGatewayConnection *connection = port.GetConnection();
+  connection->MinBackoff = 50;
+  connection->MaxBackoff = 200;
+
+  IEC87052Manager_<TcpGatewayPort> link(&port, 1);
+  Check(link.ResetRemoteLink() && Poll(link), "reset of link and poll through the gateway");
+  Check(connection->Connections == 1 && connection->SendCalls == 2, "one connection, one send() per frame");
+
+  /*Two relays behind the same converter, polled in turn*/
+  TcpGatewayPort shared(connection, "relay 2");
+  IEC87052Manager_<TcpGatewayPort> link2(&shared, 2);
+  bool ok = link2.ResetRemoteLink();
+  for (int i = 0; i < 20 && ok; i++) ok = Poll(link) && Poll(link2);
+  Check(ok && connection->Connections == 1, "two links on one connection get their own answers");
+
+  /*Nothing comes back: 0 after the read timeout*/
+  gateway.Silent.store(true);
+  unsigned char request[] = {0x10, 0x5B, 0x01, 0x5C, 0x16};
+  unsigned char in[64];
+  port.SetReadTimeout(50);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int r = port.Write(request, sizeof request) == static_cast<int>(sizeof request) ? port.Read(in, sizeof in) : -1;
+  std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+  long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+  Check(r == 0 && ms >= 45 && ms < 1000, "read timeout");
+  gateway.Silent.store(false);
+
+  /*The gateway drops the connection: the transaction fails, the next one after the backoff reconnects*/
+  gateway.Hangup.store(true);
+  while (gateway.Hangup.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  Check(!Poll(link) && !connection->IsConnected(), "transaction fails when the gateway drops the connection");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  Check(link.ResetRemoteLink() && Poll(link) && connection->Connections == 2, "reconnected after the backoff");
+
+  /*The gateway is gone: connections are refused*/
+  gateway.Stop();
+  gateway.Hangup.store(false);
+  connection->Disconnect();
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  Check(port.Write(request, sizeof request) < 0 && !connection->IsConnected(), "refused once the gateway is gone");
+
+  return failures == 0 ? 0 : 1;
+}
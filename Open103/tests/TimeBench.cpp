@@ -0,0 +1,106 @@
+/*
+CP56Time2a / CP32Time2a conversions of IEC8705103TimeConverter against the C library (timegm, gmtime_r). Checks
+both give the same instant for random valid times of 2000..2099, then prints the time per conversion of the batch
+decoders, of ToCp56 and of the C library path.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <chrono>
+#include <vector>
+
+#include "IEC8705103Time.h"
+
+static const size_t Cp56Size = 7;
+static const size_t Times = 4096;
+static const int Rounds = 200;
+
+static double Seconds(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+/*What decoding through the C library costs: broken down time to time_t, then milliseconds*/
+static long long LibcFromCp56(const unsigned char *p) {
+  tm t = tm();
+  unsigned int ms = p[0] | (p[1] << 8);
+  t.tm_sec = ms / 1000;
+  t.tm_min = p[2] & 0x3F;
+  t.tm_hour = p[3] & 0x1F;
+  t.tm_mday = p[4] & 0x1F;
+  t.tm_mon = (p[5] & 0x0F) - 1;
+  t.tm_year = 100 + (p[6] & 0x7F);
+  return static_cast<long long>(timegm(&t)) * 1000000000LL + (ms % 1000) * IEC8705103TimeConverter::NsPerMs;
+}
+
+int main() {
+  IEC8705103TimeConverter converter;
+  std::vector<unsigned char> cp56(Times * Cp56Size);
+  std::vector<long long> instants(Times);
+  std::vector<long long> ns(Times);
+
+  srand(103);
+  for (size_t i = 0; i < Times; i++) {
+    /*Random millisecond between 2000-01-01 and 2099-12-31*/
+    long long ms = (static_cast<long long>(rand()) << 20 ^ rand()) % (36524LL * 86400000LL);
+    instants[i] = (946684800000LL + ms) * IEC8705103TimeConverter::NsPerMs;
+    converter.ToCp56(instants[i], &cp56[i * Cp56Size]);
+  }
+
+  if (converter.FromCp56(&cp56[0], Cp56Size, Times, &ns[0]) != Times) {
+    printf("FAIL: valid times rejected\n");
+    return 1;
+  }
+  for (size_t i = 0; i < Times; i++)
+    if (ns[i] != instants[i] || LibcFromCp56(&cp56[i * Cp56Size]) != instants[i]) {
+      printf("FAIL: time %zu is %lld, libc %lld, expected %lld\n", i, ns[i], LibcFromCp56(&cp56[i * Cp56Size]),
+             instants[i]);
+      return 1;
+    }
+
+  unsigned long long sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++)
+    for (size_t i = 0; i < Times; i++) sum += LibcFromCp56(&cp56[i * Cp56Size]);
+  double libc = Seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++) {
+    converter.FromCp56(&cp56[0], Cp56Size, Times, &ns[0]);
+    sum += ns[r % Times];
+  }
+  double from56 = Seconds(start);
+
+  /*The same octets read as CP32 (first four), placed around the reference*/
+  converter.SetReference(instants[0]);
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++) {
+    converter.FromCp32(&cp56[0], Cp56Size, Times, &ns[0]);
+    sum += ns[r % Times];
+  }
+  double from32 = Seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++) {
+    time_t seconds = static_cast<time_t>(instants[r % Times] / 1000000000LL);
+    for (size_t i = 0; i < Times; i++) {
+      tm t;
+      seconds += 1;
+      gmtime_r(&seconds, &t);
+      sum += t.tm_mday;
+    }
+  }
+  double libcTo = Seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < Rounds; r++)
+    for (size_t i = 0; i < Times; i++) converter.ToCp56(instants[i] + r, &cp56[i * Cp56Size]);
+  double to56 = Seconds(start);
+  sum += cp56[Rounds % cp56.size()];
+
+  double per = 1e9 / (static_cast<double>(Rounds) * Times);
+  printf("CP56 to ns: timegm %.1f ns, FromCp56 %.1f ns; CP32 to ns: FromCp32 %.1f ns\n", libc * per, from56 * per,
+         from32 * per);
+  printf("ns to CP56: gmtime_r %.1f ns, ToCp56 %.1f ns [%llu]\n", libcTo * per, to56 * per, sum);
+  return 0;
+}